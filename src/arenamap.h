@@ -0,0 +1,310 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ARENAMAP_H
+#define BITCOIN_ARENAMAP_H
+
+#include "memusage.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Hash map with a subset of the boost::unordered_map interface, for maps
+ * with many small entries that are filled up and then emptied all at once
+ * (like the coins cache, which is cleared after every flush).
+ *
+ * Entries are constructed in large chunks of memory owned by the map, so
+ * inserting does not allocate per entry, and clear() hands the chunks back
+ * in one go. Entries never move once inserted: pointers and references to
+ * them stay valid until they are erased, just like with a node-based map.
+ * Erased entries are reused by later inserts.
+ *
+ * Lookups go through an open-addressing table of entry pointers with linear
+ * probing. Inserting may rebuild that table, which invalidates iterators
+ * that are in the middle of a traversal, but not the entries themselves.
+ */
+template <typename K, typename T, typename Hash>
+class arenamap
+{
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+
+    class const_iterator;
+
+    class iterator
+    {
+        friend class arenamap;
+        friend class const_iterator;
+        const arenamap* map;
+        size_t pos;
+        value_type* ptr;
+        iterator(const arenamap* mapIn, size_t posIn, value_type* ptrIn) : map(mapIn), pos(posIn), ptr(ptrIn) {}
+
+    public:
+        iterator() : map(NULL), pos(0), ptr(NULL) {}
+        value_type& operator*() const { return *ptr; }
+        value_type* operator->() const { return ptr; }
+        iterator& operator++() { ptr = map->Next(pos); return *this; }
+        iterator operator++(int) { iterator copy(*this); ++(*this); return copy; }
+        bool operator==(const iterator& x) const { return ptr == x.ptr; }
+        bool operator!=(const iterator& x) const { return ptr != x.ptr; }
+    };
+
+    class const_iterator
+    {
+        friend class arenamap;
+        const arenamap* map;
+        size_t pos;
+        const value_type* ptr;
+        const_iterator(const arenamap* mapIn, size_t posIn, const value_type* ptrIn) : map(mapIn), pos(posIn), ptr(ptrIn) {}
+
+    public:
+        const_iterator() : map(NULL), pos(0), ptr(NULL) {}
+        const_iterator(const iterator& x) : map(x.map), pos(x.pos), ptr(x.ptr) {}
+        const value_type& operator*() const { return *ptr; }
+        const value_type* operator->() const { return ptr; }
+        const_iterator& operator++() { ptr = map->Next(pos); return *this; }
+        const_iterator operator++(int) { const_iterator copy(*this); ++(*this); return copy; }
+        bool operator==(const const_iterator& x) const { return ptr == x.ptr; }
+        bool operator!=(const const_iterator& x) const { return ptr != x.ptr; }
+    };
+
+private:
+    /** Entries allocated at a time: chunks start small and double up to this */
+    static const size_t MAX_CHUNK_ENTRIES = 1024;
+    static const size_t MIN_CHUNK_ENTRIES = 16;
+    /** Smallest lookup table (must be a power of two) */
+    static const size_t MIN_SLOTS = 16;
+
+    Hash hasher;
+    //! Lookup table: NULL for a free slot, Tombstone() for an erased one
+    std::vector<value_type*> vSlots;
+    //! Memory chunks entries are constructed in
+    std::vector<char*> vChunks;
+    //! Entries in, and entries handed out from, the last chunk
+    size_t nChunkEntries;
+    size_t nChunkUsed;
+    //! Malloc usage of all chunks
+    size_t nChunkUsage;
+    //! Erased entries, linked through their (destroyed) storage
+    value_type* pFree;
+    size_t nSize;
+    size_t nTombstones;
+
+    value_type* Tombstone() const
+    {
+        // Never the address of an entry
+        return reinterpret_cast<value_type*>(const_cast<arenamap*>(this));
+    }
+
+    bool IsEntry(const value_type* p) const { return p != NULL && p != Tombstone(); }
+
+    //! First slot with a live entry at or after pos (updated), or NULL
+    value_type* Seek(size_t& pos) const
+    {
+        for (; pos < vSlots.size(); pos++) {
+            if (IsEntry(vSlots[pos]))
+                return vSlots[pos];
+        }
+        return NULL;
+    }
+
+    value_type* Next(size_t& pos) const
+    {
+        pos++;
+        return Seek(pos);
+    }
+
+    //! Slot holding key, or the end of the table if there is none
+    size_t FindSlot(const K& key) const
+    {
+        if (nSize == 0)
+            return vSlots.size();
+        size_t mask = vSlots.size() - 1;
+        for (size_t pos = hasher(key) & mask; ; pos = (pos + 1) & mask) {
+            value_type* p = vSlots[pos];
+            if (p == NULL)
+                return vSlots.size();
+            if (p != Tombstone() && p->first == key)
+                return pos;
+        }
+    }
+
+    //! Place an entry known not to be in the table yet; returns its slot
+    size_t PlaceEntry(value_type* entry)
+    {
+        size_t mask = vSlots.size() - 1;
+        size_t pos = hasher(entry->first) & mask;
+        while (IsEntry(vSlots[pos]))
+            pos = (pos + 1) & mask;
+        if (vSlots[pos] == Tombstone())
+            nTombstones--;
+        vSlots[pos] = entry;
+        return pos;
+    }
+
+    //! Make room for one more entry, keeping the table at most 3/4 full
+    void Reserve()
+    {
+        if ((nSize + nTombstones + 1) * 4 <= vSlots.size() * 3)
+            return;
+        size_t nSlots = vSlots.empty() ? MIN_SLOTS : vSlots.size();
+        // Grow unless it is mostly tombstones that fill the table
+        if ((nSize + 1) * 2 > nSlots)
+            nSlots *= 2;
+        std::vector<value_type*> vOld(nSlots, (value_type*)NULL);
+        vOld.swap(vSlots);
+        nTombstones = 0;
+        for (size_t i = 0; i < vOld.size(); i++) {
+            if (IsEntry(vOld[i]))
+                PlaceEntry(vOld[i]);
+        }
+    }
+
+    value_type* Allocate()
+    {
+        if (pFree) {
+            value_type* p = pFree;
+            pFree = *reinterpret_cast<value_type**>(p);
+            return p;
+        }
+        if (vChunks.empty() || nChunkUsed == nChunkEntries) {
+            nChunkEntries = vChunks.empty() ? MIN_CHUNK_ENTRIES : std::min(nChunkEntries * 2, MAX_CHUNK_ENTRIES);
+            vChunks.push_back(static_cast<char*>(::operator new(sizeof(value_type) * nChunkEntries)));
+            nChunkUsage += memusage::MallocUsage(sizeof(value_type) * nChunkEntries);
+            nChunkUsed = 0;
+        }
+        return reinterpret_cast<value_type*>(vChunks.back() + sizeof(value_type) * nChunkUsed++);
+    }
+
+    void Deallocate(value_type* p)
+    {
+        *reinterpret_cast<value_type**>(p) = pFree;
+        pFree = p;
+    }
+
+    arenamap(const arenamap&);
+    arenamap& operator=(const arenamap&);
+
+public:
+    arenamap() : nChunkEntries(0), nChunkUsed(0), nChunkUsage(0), pFree(NULL), nSize(0), nTombstones(0) {}
+
+    ~arenamap()
+    {
+        clear();
+    }
+
+    iterator begin()
+    {
+        size_t pos = 0;
+        value_type* p = Seek(pos);
+        return iterator(this, pos, p);
+    }
+    const_iterator begin() const
+    {
+        size_t pos = 0;
+        const value_type* p = Seek(pos);
+        return const_iterator(this, pos, p);
+    }
+    iterator end() { return iterator(this, vSlots.size(), NULL); }
+    const_iterator end() const { return const_iterator(this, vSlots.size(), NULL); }
+
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    iterator find(const K& key)
+    {
+        size_t pos = FindSlot(key);
+        return pos == vSlots.size() ? end() : iterator(this, pos, vSlots[pos]);
+    }
+    const_iterator find(const K& key) const
+    {
+        size_t pos = FindSlot(key);
+        return pos == vSlots.size() ? end() : const_iterator(this, pos, vSlots[pos]);
+    }
+    size_t count(const K& key) const { return FindSlot(key) != vSlots.size(); }
+
+    std::pair<iterator, bool> insert(const value_type& value)
+    {
+        iterator it = find(value.first);
+        if (it != end())
+            return std::make_pair(it, false);
+        Reserve();
+        value_type* p = Allocate();
+        try {
+            new (p) value_type(value);
+        } catch (...) {
+            Deallocate(p);
+            throw;
+        }
+        nSize++;
+        size_t pos = PlaceEntry(p);
+        return std::make_pair(iterator(this, pos, p), true);
+    }
+
+    T& operator[](const K& key)
+    {
+        return insert(value_type(key, T())).first->second;
+    }
+
+    void erase(iterator it)
+    {
+        size_t pos = it.pos;
+        if (pos >= vSlots.size() || vSlots[pos] != it.ptr) {
+            // The table was rebuilt since the iterator was obtained
+            pos = FindSlot(it.ptr->first);
+            assert(pos != vSlots.size());
+        }
+        vSlots[pos] = Tombstone();
+        nTombstones++;
+        nSize--;
+        it.ptr->~value_type();
+        Deallocate(it.ptr);
+    }
+
+    size_t erase(const K& key)
+    {
+        iterator it = find(key);
+        if (it == end())
+            return 0;
+        erase(it);
+        return 1;
+    }
+
+    /** Destroy all entries and release all memory */
+    void clear()
+    {
+        for (size_t i = 0; i < vSlots.size(); i++) {
+            if (IsEntry(vSlots[i]))
+                vSlots[i]->~value_type();
+        }
+        for (size_t i = 0; i < vChunks.size(); i++)
+            ::operator delete(vChunks[i]);
+        std::vector<value_type*>().swap(vSlots);
+        std::vector<char*>().swap(vChunks);
+        nChunkEntries = 0;
+        nChunkUsed = 0;
+        nChunkUsage = 0;
+        pFree = NULL;
+        nSize = 0;
+        nTombstones = 0;
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        return nChunkUsage + memusage::DynamicUsage(vSlots) + memusage::DynamicUsage(vChunks);
+    }
+};
+
+#endif // BITCOIN_ARENAMAP_H
@@ -0,0 +1,67 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "coins.h"
+#include "random.h"
+
+#include <vector>
+
+/* Transactions whose coins are added per benchmark iteration */
+static const int COINS_BENCH_TXS = 20000;
+
+static std::vector<uint256> BenchTxids()
+{
+    std::vector<uint256> txids(COINS_BENCH_TXS);
+    for (size_t i = 0; i < txids.size(); i++)
+        txids[i] = GetRandHash();
+    return txids;
+}
+
+static void AddBenchCoins(CCoinsViewCache& cache, const std::vector<uint256>& txids)
+{
+    for (size_t i = 0; i < txids.size(); i++) {
+        CCoinsModifier coins = cache.ModifyNewCoins(txids[i]);
+        coins->nVersion = 1;
+        coins->nHeight = i;
+        coins->vout.resize(2);
+        coins->vout[0].nValue = 1;
+        coins->vout[0].scriptPubKey = CScript() << OP_TRUE;
+        coins->vout[1].nValue = 2;
+        coins->vout[1].scriptPubKey = CScript() << OP_TRUE;
+    }
+}
+
+// Add coins to a cache and flush them into its parent cache, as connecting
+// blocks does.
+static void CoinsCacheBatchWrite(benchmark::State& state)
+{
+    CCoinsView viewEmpty;
+    std::vector<uint256> txids = BenchTxids();
+    while (state.KeepRunning()) {
+        CCoinsViewCache parent(&viewEmpty);
+        CCoinsViewCache child(&parent);
+        AddBenchCoins(child, txids);
+        child.Flush();
+    }
+}
+
+// Look up coins that are already in the cache, hits and misses alike.
+static void CoinsCacheAccess(benchmark::State& state)
+{
+    CCoinsView viewEmpty;
+    CCoinsViewCache cache(&viewEmpty);
+    std::vector<uint256> txids = BenchTxids();
+    AddBenchCoins(cache, txids);
+    std::vector<uint256> missing = BenchTxids();
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < txids.size(); i++) {
+            cache.AccessCoins(txids[i]);
+            cache.HaveCoinsInCache(missing[i]);
+        }
+    }
+}
+
+BENCHMARK(CoinsCacheBatchWrite);
+BENCHMARK(CoinsCacheAccess);
@@ -0,0 +1,127 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "checkqueue.h"
+#include "coins.h"
+#include "main.h"
+#include "primitives/block.h"
+
+#include <map>
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+/* Number of transactions in the benchmark block, each spending two earlier ones */
+static const int PREFETCH_BENCH_TXS = 200;
+/* Simulated latency of reading an entry from a cold database */
+static const int PREFETCH_BENCH_READ_US = 100;
+
+/**
+ * A coins view that, like the coins database on a cold cache, is slow the first
+ * time each entry is read and fast afterwards. Safe to read from several threads.
+ */
+class CCoinsViewColdDB : public CCoinsView
+{
+private:
+    std::map<uint256, CCoins> mapCoins;
+    mutable std::set<uint256> setWarm;
+    mutable boost::mutex cs;
+
+public:
+    void Add(const uint256& txid, const CCoins& coins) { mapCoins[txid] = coins; }
+    void Cool() { boost::lock_guard<boost::mutex> lock(cs); setWarm.clear(); }
+
+    bool GetCoins(const uint256& txid, CCoins& coins) const
+    {
+        bool fCold;
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            fCold = setWarm.insert(txid).second;
+        }
+        if (fCold)
+            boost::this_thread::sleep(boost::posix_time::microseconds(PREFETCH_BENCH_READ_US));
+        std::map<uint256, CCoins>::const_iterator it = mapCoins.find(txid);
+        if (it == mapCoins.end())
+            return false;
+        coins = it->second;
+        return true;
+    }
+
+    bool HaveCoins(const uint256& txid) const
+    {
+        CCoins coins;
+        return GetCoins(txid, coins);
+    }
+};
+
+static void SetupBlock(CCoinsViewColdDB& db, CBlock& block)
+{
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    block.vtx.push_back(coinbase);
+    for (int i = 0; i < PREFETCH_BENCH_TXS; i++) {
+        CMutableTransaction tx;
+        for (int j = 0; j < 2; j++) {
+            CMutableTransaction funding;
+            funding.vout.resize(1);
+            funding.vout[0].nValue = 1000;
+            funding.nLockTime = 2 * i + j;
+            db.Add(funding.GetHash(), CCoins(funding, 1));
+            tx.vin.push_back(CTxIn(COutPoint(funding.GetHash(), 0)));
+        }
+        tx.vout.resize(1);
+        block.vtx.push_back(tx);
+    }
+}
+
+// Look up the inputs of every transaction in a block in order, as ConnectBlock does.
+static void ConnectInputs(CCoinsViewCache& view, const CBlock& block)
+{
+    for (size_t i = 1; i < block.vtx.size(); i++)
+        assert(view.HaveInputs(block.vtx[i]));
+}
+
+static void CoinsFetchBlockInputs(benchmark::State& state)
+{
+    CCoinsViewColdDB db;
+    CBlock block;
+    SetupBlock(db, block);
+
+    while (state.KeepRunning()) {
+        db.Cool();
+        CCoinsViewCache view(&db);
+        ConnectInputs(view, block);
+    }
+}
+
+static void CoinsPrefetchBlockInputs(benchmark::State& state)
+{
+    CCoinsViewColdDB db;
+    CBlock block;
+    SetupBlock(db, block);
+
+    CCheckQueue<CCoinsPrefetch> queue(128);
+    boost::thread_group threads;
+    for (int i = 0; i < 3; i++)
+        threads.create_thread(boost::bind(&CCheckQueue<CCoinsPrefetch>::Thread, &queue));
+
+    while (state.KeepRunning()) {
+        db.Cool();
+        CCoinsViewCache view(&db);
+        CCheckQueueControl<CCoinsPrefetch> control(&queue);
+        std::vector<CCoinsPrefetch> vPrefetch;
+        GetBlockInputPrefetches(block, view, &db, vPrefetch);
+        control.Add(vPrefetch);
+        ConnectInputs(view, block);
+    }
+
+    queue.Quit();
+    threads.join_all();
+}
+
+BENCHMARK(CoinsFetchBlockInputs);
+BENCHMARK(CoinsPrefetchBlockInputs);
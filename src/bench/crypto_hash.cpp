@@ -0,0 +1,45 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "primitives/block.h"
+
+#include <vector>
+
+/* Number of headers hashed per benchmark iteration */
+static const size_t BENCH_HEADERS = 2000;
+
+static std::vector<CBlockHeader> BenchHeaders()
+{
+    std::vector<CBlockHeader> headers(BENCH_HEADERS);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = 4;
+        headers[i].nTime = 1500000000 + i;
+        headers[i].nBits = 0x1b0404cb;
+        headers[i].nNonce = i;
+    }
+    return headers;
+}
+
+static void X11_HeaderGetHash(benchmark::State& state)
+{
+    std::vector<CBlockHeader> headers = BenchHeaders();
+    std::vector<uint256> hashes(headers.size());
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < headers.size(); i++)
+            hashes[i] = headers[i].GetHash();
+    }
+}
+
+static void X11_HeaderBatch(benchmark::State& state)
+{
+    std::vector<CBlockHeader> headers = BenchHeaders();
+    std::vector<uint256> hashes(headers.size());
+    while (state.KeepRunning()) {
+        HashX11Batch(&headers[0], headers.size(), &hashes[0]);
+    }
+}
+
+BENCHMARK(X11_HeaderGetHash);
+BENCHMARK(X11_HeaderBatch);
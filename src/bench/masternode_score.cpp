@@ -0,0 +1,58 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "arith_uint256.h"
+#include "hash.h"
+#include "masternode.h"
+#include "random.h"
+
+#include <vector>
+
+/* Masternodes scored per benchmark iteration, about the size of the network */
+static const int MASTERNODE_BENCH_COUNT = 5000;
+
+static std::vector<COutPoint> BenchOutpoints()
+{
+    std::vector<COutPoint> vOutpoints(MASTERNODE_BENCH_COUNT);
+    for (size_t i = 0; i < vOutpoints.size(); i++)
+        vOutpoints[i] = COutPoint(GetRandHash(), i % 4);
+    return vOutpoints;
+}
+
+// Score the list against a block the way it was done before the block hash
+// was shared: two hashers per masternode, one of them over the block hash
+// alone.
+static void MasternodeScoreLegacy(benchmark::State& state)
+{
+    std::vector<COutPoint> vOutpoints = BenchOutpoints();
+    uint256 blockHash = GetRandHash();
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < vOutpoints.size(); i++) {
+            CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+            ss << blockHash;
+            arith_uint256 hash2 = UintToArith256(ss.GetHash());
+            CHashWriter ss2(SER_GETHASH, PROTOCOL_VERSION);
+            ss2 << blockHash;
+            ss2 << ArithToUint256(UintToArith256(vOutpoints[i].hash) + vOutpoints[i].n);
+            arith_uint256 hash3 = UintToArith256(ss2.GetHash());
+            (void)(hash3 > hash2 ? hash3 - hash2 : hash2 - hash3);
+        }
+    }
+}
+
+// Score the list against a block as ranking and payment selection do.
+static void MasternodeScore(benchmark::State& state)
+{
+    std::vector<COutPoint> vOutpoints = BenchOutpoints();
+    uint256 blockHash = GetRandHash();
+    while (state.KeepRunning()) {
+        CMasternodeScorer scorer(blockHash);
+        for (size_t i = 0; i < vOutpoints.size(); i++)
+            scorer.GetScore(vOutpoints[i]);
+    }
+}
+
+BENCHMARK(MasternodeScoreLegacy);
+BENCHMARK(MasternodeScore);
@@ -0,0 +1,104 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "script/sigcache.h"
+#include "memusage.h"
+#include "random.h"
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_set.hpp>
+
+/* Threads hammering the cache at once, as the script check threads do */
+static const int SIGCACHE_BENCH_THREADS = 4;
+/* Cache operations per thread per benchmark iteration */
+static const int SIGCACHE_BENCH_OPS = 20000;
+static const size_t SIGCACHE_BENCH_BYTES = DEFAULT_MAX_SIG_CACHE_SIZE * ((size_t) 1 << 20);
+
+namespace {
+
+class CLegacyHasher
+{
+public:
+    size_t operator()(const uint256& key) const {
+        return key.GetCheapHash();
+    }
+};
+
+/** The previous signature cache: one unordered_set behind one shared_mutex */
+class CLegacySignatureCache
+{
+private:
+    typedef boost::unordered_set<uint256, CLegacyHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_sigcache;
+
+public:
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.count(entry);
+    }
+
+    void Set(const uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        while (memusage::DynamicUsage(setValid) > SIGCACHE_BENCH_BYTES)
+        {
+            map_type::size_type s = GetRand(setValid.bucket_count());
+            map_type::local_iterator it = setValid.begin(s);
+            if (it != setValid.end(s)) {
+                setValid.erase(*it);
+            }
+        }
+        setValid.insert(entry);
+    }
+};
+
+/** Each thread stores its own entries and looks every one of them up again */
+template <typename Cache>
+void SigCacheWorker(Cache* cache, const std::vector<uint256>* entries)
+{
+    for (size_t i = 0; i < entries->size(); i++) {
+        if (!cache->Get((*entries)[i]))
+            cache->Set((*entries)[i]);
+        cache->Get((*entries)[i / 2]);
+    }
+}
+
+template <typename Cache>
+void RunSigCacheBench(benchmark::State& state, Cache& cache)
+{
+    std::vector<std::vector<uint256> > vEntries(SIGCACHE_BENCH_THREADS);
+    while (state.KeepRunning()) {
+        for (int t = 0; t < SIGCACHE_BENCH_THREADS; t++) {
+            vEntries[t].resize(SIGCACHE_BENCH_OPS);
+            GetRandBytes((unsigned char*)&vEntries[t][0], SIGCACHE_BENCH_OPS * sizeof(uint256));
+        }
+        boost::thread_group threads;
+        for (int t = 0; t < SIGCACHE_BENCH_THREADS; t++)
+            threads.create_thread(boost::bind(&SigCacheWorker<Cache>, &cache, &vEntries[t]));
+        threads.join_all();
+    }
+}
+
+}
+
+static void SigCacheLegacy_Threads(benchmark::State& state)
+{
+    CLegacySignatureCache cache;
+    RunSigCacheBench(state, cache);
+}
+
+static void SigCacheSharded_Threads(benchmark::State& state)
+{
+    CSignatureCache cache(SIGCACHE_BENCH_BYTES);
+    RunSigCacheBench(state, cache);
+}
+
+BENCHMARK(SigCacheLegacy_Threads);
+BENCHMARK(SigCacheSharded_Threads);
@@ -0,0 +1,71 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "darksend.h"
+#include "key.h"
+#include "masternode-payments.h"
+#include "pubkey.h"
+#include "random.h"
+#include "script/standard.h"
+
+#include <cassert>
+
+static CMasternodePaymentVote BenchVote(CKey& key)
+{
+    key.MakeNewKey(true);
+    return CMasternodePaymentVote(CTxIn(COutPoint(GetRandHash(), 1)), 100000, GetScriptForDestination(key.GetPubKey().GetID()));
+}
+
+// Verify a payment vote signed over its string form, as older peers sign them.
+static void VoteVerifyMessage(benchmark::State& state)
+{
+    ECCVerifyHandle verifyHandle;
+    CKey key;
+    CMasternodePaymentVote vote = BenchVote(key);
+    CPubKey pubKey = key.GetPubKey();
+    darkSendSigner.SignMessage(vote.GetSignatureMessage(), vote.vchSig, key);
+    std::string strError;
+    while (state.KeepRunning()) {
+        assert(darkSendSigner.VerifyMessage(pubKey, vote.vchSig, vote.GetSignatureMessage(), strError));
+    }
+}
+
+// Verify a payment vote signed over its binary digest.
+static void VoteVerifyDigest(benchmark::State& state)
+{
+    ECCVerifyHandle verifyHandle;
+    CKey key;
+    CMasternodePaymentVote vote = BenchVote(key);
+    CPubKey pubKey = key.GetPubKey();
+    darkSendSigner.SignHash(vote.GetSignatureHash(), vote.vchSig, key);
+    std::string strError;
+    while (state.KeepRunning()) {
+        assert(darkSendSigner.VerifyHash(vote.GetSignatureHash(), pubKey, vote.vchSig, strError));
+    }
+}
+
+// Only the part that differs: turning the vote into the hash that is signed.
+static void VoteHashMessage(benchmark::State& state)
+{
+    CKey key;
+    CMasternodePaymentVote vote = BenchVote(key);
+    while (state.KeepRunning()) {
+        CDarkSendSigner::GetMessageHash(vote.GetSignatureMessage());
+    }
+}
+
+static void VoteHashDigest(benchmark::State& state)
+{
+    CKey key;
+    CMasternodePaymentVote vote = BenchVote(key);
+    while (state.KeepRunning()) {
+        vote.GetSignatureHash();
+    }
+}
+
+BENCHMARK(VoteVerifyMessage);
+BENCHMARK(VoteVerifyDigest);
+BENCHMARK(VoteHashMessage);
+BENCHMARK(VoteHashDigest);
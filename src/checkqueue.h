@@ -157,6 +157,14 @@ public:
             condWorker.notify_all();
     }
 
+    //! Let worker threads return once all queued work is done, instead of waiting for more
+    void Quit()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fQuit = true;
+        condWorker.notify_all();
+    }
+
     ~CCheckQueue()
     {
     }
@@ -9,6 +9,9 @@
 
 #include <assert.h>
 
+#include <algorithm>
+#include <iterator>
+
 /**
  * calculate number of bytes for the bitmask, and its number of non-zero bytes
  * each bit in the bitmask represents the availability of one output, but the
@@ -80,6 +83,24 @@ bool CCoinsViewBacked::GetStats(CCoinsStats &stats) const {
 
 CCoinsKeyHasher::CCoinsKeyHasher() : salt(GetRandHash()) {}
 
+void CCoinsCacheEntry::SetDirtyOutputs(const std::vector<uint32_t>& vOutputs) {
+    if (!(flags & DIRTY)) {
+        flags |= DIRTY | PARTIAL;
+        vDirtyOutputs = vOutputs;
+    } else if (flags & PARTIAL) {
+        std::vector<uint32_t> vMerged;
+        vMerged.reserve(vDirtyOutputs.size() + vOutputs.size());
+        std::set_union(vDirtyOutputs.begin(), vDirtyOutputs.end(), vOutputs.begin(), vOutputs.end(), std::back_inserter(vMerged));
+        vDirtyOutputs.swap(vMerged);
+    }
+    // Otherwise the whole entry is dirty already.
+}
+
+void CCoinsCacheEntry::SetDirty() {
+    flags = (flags | DIRTY) & ~PARTIAL;
+    std::vector<uint32_t>().swap(vDirtyOutputs);
+}
+
 CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), cachedCoinsUsage(0) { }
 
 CCoinsViewCache::~CCoinsViewCache()
@@ -134,9 +155,16 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
     } else {
         cachedCoinUsage = ret.first->second.coins.DynamicMemoryUsage();
     }
-    // Assume that whenever ModifyCoins is called, the entry will be modified.
-    ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
-    return CCoinsModifier(*this, ret.first, cachedCoinUsage);
+    // Unless the parent view does not have the entry at all, or it has been
+    // changed wholesale already, keep track of which outputs get modified so
+    // that only those need to be written back.
+    unsigned char flags = ret.first->second.flags;
+    bool fTrackOutputs = !(flags & CCoinsCacheEntry::FRESH) && (!(flags & CCoinsCacheEntry::DIRTY) || (flags & CCoinsCacheEntry::PARTIAL));
+    if (!fTrackOutputs) {
+        // Assume that whenever ModifyCoins is called, the entry will be modified.
+        ret.first->second.SetDirty();
+    }
+    return CCoinsModifier(*this, ret.first, cachedCoinUsage, fTrackOutputs);
 }
 
 CCoinsModifier CCoinsViewCache::ModifyNewCoins(const uint256 &txid) {
@@ -144,7 +172,7 @@ CCoinsModifier CCoinsViewCache::ModifyNewCoins(const uint256 &txid) {
     std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry()));
     ret.first->second.coins.Clear();
     ret.first->second.flags = CCoinsCacheEntry::FRESH;
-    ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
+    ret.first->second.SetDirty();
     return CCoinsModifier(*this, ret.first, 0);
 }
 
@@ -195,7 +223,8 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                     CCoinsCacheEntry& entry = cacheCoins[it->first];
                     entry.coins.swap(it->second.coins);
                     cachedCoinsUsage += entry.coins.DynamicMemoryUsage();
-                    entry.flags = CCoinsCacheEntry::DIRTY;
+                    entry.flags = it->second.flags & (CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::PARTIAL);
+                    entry.vDirtyOutputs.swap(it->second.vDirtyOutputs);
                     // We can mark it FRESH in the parent if it was FRESH in the child
                     // Otherwise it might have just been flushed from the parent's cache
                     // and already exist in the grandparent
@@ -215,7 +244,10 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                     cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
                     itUs->second.coins.swap(it->second.coins);
                     cachedCoinsUsage += itUs->second.coins.DynamicMemoryUsage();
-                    itUs->second.flags |= CCoinsCacheEntry::DIRTY;
+                    if (it->second.flags & CCoinsCacheEntry::PARTIAL)
+                        itUs->second.SetDirtyOutputs(it->second.vDirtyOutputs);
+                    else
+                        itUs->second.SetDirty();
                 }
             }
         }
@@ -298,9 +330,18 @@ double CCoinsViewCache::GetPriority(const CTransaction &tx, int nHeight, CAmount
     return tx.ComputePriority(dResult);
 }
 
-CCoinsModifier::CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage) : cache(cache_), it(it_), cachedCoinUsage(usage) {
+CCoinsModifier::CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage, bool fTrackOutputsIn) : cache(cache_), it(it_), cachedCoinUsage(usage), fTrackOutputs(fTrackOutputsIn), nHeightWas(0), nVersionWas(0), fCoinBaseWas(false) {
     assert(!cache.hasModifier);
     cache.hasModifier = true;
+    if (fTrackOutputs) {
+        const CCoins& coins = it->second.coins;
+        vWasAvailable.resize(coins.vout.size());
+        for (unsigned int i = 0; i < coins.vout.size(); i++)
+            vWasAvailable[i] = coins.IsAvailable(i);
+        nHeightWas = coins.nHeight;
+        nVersionWas = coins.nVersion;
+        fCoinBaseWas = coins.fCoinBase;
+    }
 }
 
 CCoinsModifier::~CCoinsModifier()
@@ -308,6 +349,22 @@ CCoinsModifier::~CCoinsModifier()
     assert(cache.hasModifier);
     cache.hasModifier = false;
     it->second.coins.Cleanup();
+    if (fTrackOutputs) {
+        // Outputs that were spent or added; if the transaction metadata
+        // changed, all remaining outputs too. An output that stays available
+        // keeps its contents.
+        const CCoins& coins = it->second.coins;
+        bool fMetaChanged = coins.nHeight != nHeightWas || coins.nVersion != nVersionWas || coins.fCoinBase != fCoinBaseWas;
+        std::vector<uint32_t> vChanged;
+        for (unsigned int i = 0; i < std::max(vWasAvailable.size(), coins.vout.size()); i++) {
+            bool fWasAvailable = i < vWasAvailable.size() && vWasAvailable[i];
+            bool fAvailable = coins.IsAvailable(i);
+            if (fWasAvailable != fAvailable || (fAvailable && fMetaChanged))
+                vChanged.push_back(i);
+        }
+        if (!vChanged.empty())
+            it->second.SetDirtyOutputs(vChanged);
+    }
     cache.cachedCoinsUsage -= cachedCoinUsage; // Subtract the old usage
     if ((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
         cache.cacheCoins.erase(it);
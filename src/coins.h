@@ -6,6 +6,7 @@
 #ifndef BITCOIN_COINS_H
 #define BITCOIN_COINS_H
 
+#include "arenamap.h"
 #include "compressor.h"
 #include "core_memusage.h"
 #include "memusage.h"
@@ -16,7 +17,6 @@
 #include <stdint.h>
 
 #include <boost/foreach.hpp>
-#include <boost/unordered_map.hpp>
 
 /**
  * Pruned version of CTransaction: only retains metadata and unspent transaction outputs
@@ -286,16 +286,23 @@ struct CCoinsCacheEntry
 {
     CCoins coins; // The actual cached data.
     unsigned char flags;
+    std::vector<uint32_t> vDirtyOutputs; // Sorted indexes of the outputs that changed, if PARTIAL.
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
         FRESH = (1 << 1), // The parent view does not have this entry (or it is pruned).
+        PARTIAL = (1 << 2), // Only the outputs in vDirtyOutputs (and nothing else) differ from the parent view.
     };
 
     CCoinsCacheEntry() : coins(), flags(0) {}
+
+    //! Mark the given outputs (sorted) as changed
+    void SetDirtyOutputs(const std::vector<uint32_t>& vOutputs);
+    //! Mark the whole entry as changed
+    void SetDirty();
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
+typedef arenamap<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
 
 struct CCoinsStats
 {
@@ -367,7 +374,12 @@ private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
     size_t cachedCoinUsage; // Cached memory usage of the CCoins object before modification
-    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage);
+    bool fTrackOutputs; // Whether to record which outputs get modified, rather than the whole entry
+    std::vector<bool> vWasAvailable; // Output availability before modification, if fTrackOutputs
+    int nHeightWas;
+    int nVersionWas;
+    bool fCoinBaseWas;
+    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage, bool fTrackOutputsIn = false);
 
 public:
     CCoins* operator->() {
@@ -0,0 +1,188 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/x11.h"
+
+#include "crypto/common.h"
+#include "crypto/sph_blake.h"
+#include "crypto/sph_bmw.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_jh.h"
+#include "crypto/sph_keccak.h"
+#include "crypto/sph_skein.h"
+#include "crypto/sph_luffa.h"
+#include "crypto/sph_cubehash.h"
+#include "crypto/sph_shavite.h"
+#include "crypto/sph_simd.h"
+#include "crypto/sph_echo.h"
+
+#include <string.h>
+
+#if defined(ENABLE_AESNI) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+namespace x11_aesni
+{
+void Cubehash512(const unsigned char* in, unsigned char* out, size_t n);
+void Shavite512(const unsigned char* in, unsigned char* out, size_t n);
+void Echo512(const unsigned char* in, unsigned char* out, size_t n);
+}
+#endif
+
+// Internal implementation code.
+namespace
+{
+/// One chained X11 stage after blake, applied to n consecutive 64-byte inputs.
+typedef void (*StageFn)(const unsigned char* in, unsigned char* out, size_t n);
+
+enum {
+    STAGE_BMW, STAGE_GROESTL, STAGE_SKEIN, STAGE_JH, STAGE_KECCAK, STAGE_LUFFA,
+    STAGE_CUBEHASH, STAGE_SHAVITE, STAGE_SIMD, STAGE_ECHO, STAGE_COUNT
+};
+
+/// Portable sph_* stages.
+namespace generic
+{
+void Blake512(const unsigned char* in, size_t len, unsigned char* out)
+{
+    sph_blake512_context ctx;
+    sph_blake512_init(&ctx);
+    sph_blake512(&ctx, in, len);
+    sph_blake512_close(&ctx, out);
+}
+
+#define SPH_STAGE(fn, algo) \
+void fn(const unsigned char* in, unsigned char* out, size_t n) \
+{ \
+    sph_##algo##_context ctx; \
+    for (size_t i = 0; i < n; i++) { \
+        sph_##algo##_init(&ctx); \
+        sph_##algo(&ctx, in + i * X11_OUTPUT_SIZE, X11_OUTPUT_SIZE); \
+        sph_##algo##_close(&ctx, out + i * X11_OUTPUT_SIZE); \
+    } \
+}
+
+SPH_STAGE(Bmw512, bmw512)
+SPH_STAGE(Groestl512, groestl512)
+SPH_STAGE(Skein512, skein512)
+SPH_STAGE(Jh512, jh512)
+SPH_STAGE(Keccak512, keccak512)
+SPH_STAGE(Luffa512, luffa512)
+SPH_STAGE(Cubehash512, cubehash512)
+SPH_STAGE(Shavite512, shavite512)
+SPH_STAGE(Simd512, simd512)
+SPH_STAGE(Echo512, echo512)
+
+#undef SPH_STAGE
+} // namespace generic
+
+struct Backend {
+    const char* name;
+    StageFn stages[STAGE_COUNT];
+};
+
+const Backend backendGeneric = {
+    "generic",
+    {
+        generic::Bmw512, generic::Groestl512, generic::Skein512, generic::Jh512,
+        generic::Keccak512, generic::Luffa512, generic::Cubehash512,
+        generic::Shavite512, generic::Simd512, generic::Echo512
+    }
+};
+
+#if defined(ENABLE_AESNI) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/// Generic stages with the AES-round based ones (shavite, echo) replaced by AES-NI code and cubehash by SSE2 code.
+const Backend backendAESNI = {
+    "aesni",
+    {
+        generic::Bmw512, generic::Groestl512, generic::Skein512, generic::Jh512,
+        generic::Keccak512, generic::Luffa512, x11_aesni::Cubehash512,
+        x11_aesni::Shavite512, generic::Simd512, x11_aesni::Echo512
+    }
+};
+
+bool HaveAESNI()
+{
+    uint32_t eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ecx >> 25) & 1;
+}
+#endif
+
+const Backend* backend = &backendGeneric;
+
+/** Run n inputs, len bytes each and stride bytes apart, through the chain in groups of X11_BATCH_SIZE. */
+void Chain(const Backend& b, const unsigned char* data, size_t len, size_t stride, size_t n, unsigned char* hashes)
+{
+    unsigned char buf[2][X11_BATCH_SIZE * X11_OUTPUT_SIZE];
+    while (n > 0) {
+        size_t lanes = n < X11_BATCH_SIZE ? n : X11_BATCH_SIZE;
+        for (size_t i = 0; i < lanes; i++)
+            generic::Blake512(data + i * stride, len, buf[0] + i * X11_OUTPUT_SIZE);
+        for (int s = 0; s < STAGE_COUNT - 1; s++)
+            b.stages[s](buf[s & 1], buf[(s + 1) & 1], lanes);
+        b.stages[STAGE_COUNT - 1](buf[(STAGE_COUNT - 1) & 1], hashes, lanes);
+        data += lanes * stride;
+        hashes += lanes * X11_OUTPUT_SIZE;
+        n -= lanes;
+    }
+}
+
+/**
+ * Compare a candidate backend against the portable code on a few header-sized
+ * and odd-sized inputs, one at a time and as a batch that spans two groups.
+ */
+bool SelfTest(const Backend& b)
+{
+    unsigned char data[200 + X11_BATCH_SIZE * 80];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (unsigned char)(i * 7 + 13);
+
+    static const size_t lengths[] = {0, 1, 63, 64, 80, 128, 200};
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        unsigned char expected[X11_OUTPUT_SIZE], actual[X11_OUTPUT_SIZE];
+        Chain(backendGeneric, data, lengths[i], 0, 1, expected);
+        Chain(b, data, lengths[i], 0, 1, actual);
+        if (memcmp(expected, actual, X11_OUTPUT_SIZE) != 0)
+            return false;
+    }
+
+    static const size_t nBatch = X11_BATCH_SIZE + 3;
+    unsigned char expected[nBatch * X11_OUTPUT_SIZE], actual[nBatch * X11_OUTPUT_SIZE];
+    for (size_t i = 0; i < nBatch; i++)
+        Chain(backendGeneric, data + i * 80, 80, 0, 1, expected + i * X11_OUTPUT_SIZE);
+    Chain(b, data, 80, 80, nBatch, actual);
+    return memcmp(expected, actual, sizeof(actual)) == 0;
+}
+} // namespace
+
+void X11(const unsigned char* data, size_t len, unsigned char hash[X11_OUTPUT_SIZE])
+{
+    Chain(*backend, data, len, 0, 1, hash);
+}
+
+void X11Generic(const unsigned char* data, size_t len, unsigned char hash[X11_OUTPUT_SIZE])
+{
+    Chain(backendGeneric, data, len, 0, 1, hash);
+}
+
+void X11Batch(const unsigned char* data, size_t len, size_t stride, size_t n, unsigned char* hashes)
+{
+    Chain(*backend, data, len, stride, n, hashes);
+}
+
+std::string X11AutoDetect()
+{
+    backend = &backendGeneric;
+#if defined(ENABLE_AESNI) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    if (HaveAESNI() && SelfTest(backendAESNI))
+        backend = &backendAESNI;
+#endif
+    return backend->name;
+}
+
+std::string X11BackendName()
+{
+    return backend->name;
+}
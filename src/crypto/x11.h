@@ -0,0 +1,47 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_X11_H
+#define BITCOIN_CRYPTO_X11_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Size in bytes of every intermediate X11 digest (and of the final, untrimmed one). */
+static const size_t X11_OUTPUT_SIZE = 64;
+
+/** Number of inputs X11Batch() pushes through each stage together. */
+static const size_t X11_BATCH_SIZE = 8;
+
+/**
+ * Compute the chained X11 hash (blake, bmw, groestl, skein, jh, keccak, luffa,
+ * cubehash, shavite, simd, echo; all 512-bit) of len bytes at data, using the
+ * backend picked by X11AutoDetect().
+ */
+void X11(const unsigned char* data, size_t len, unsigned char hash[X11_OUTPUT_SIZE]);
+
+/**
+ * Compute the X11 hashes of n inputs of len bytes each, the i'th one starting
+ * at data + i * stride, into n consecutive X11_OUTPUT_SIZE-byte digests at
+ * hashes. Inputs go through each stage X11_BATCH_SIZE at a time so that the
+ * backend can interleave them; the result is the same as calling X11() on
+ * every input.
+ */
+void X11Batch(const unsigned char* data, size_t len, size_t stride, size_t n, unsigned char* hashes);
+
+/** Compute the X11 hash with the portable sph_* code only, whatever backend is active. */
+void X11Generic(const unsigned char* data, size_t len, unsigned char hash[X11_OUTPUT_SIZE]);
+
+/**
+ * Detect the CPU features and select the fastest X11 backend that passes its
+ * self-test against the portable implementation. Must be called before any
+ * threads that hash headers are started. Returns the backend name.
+ */
+std::string X11AutoDetect();
+
+/** Name of the X11 backend currently in use ("generic" until X11AutoDetect() runs). */
+std::string X11BackendName();
+
+#endif // BITCOIN_CRYPTO_X11_H
@@ -0,0 +1,334 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// x86 versions of X11 stages, specialised for the fixed 64-byte inputs every
+// stage after blake receives: the two stages built from full AES rounds
+// (SHAvite-3-512 and ECHO-512) use AES-NI, CubeHash-512 uses plain SSE2.
+// Each entry point hashes n consecutive 64-byte inputs and steps several of
+// them together where a single one leaves the execution units idle.
+// They follow the structure of crypto/shavite.c, crypto/echo.c and
+// crypto/cubehash.c and are checked against them by X11AutoDetect() before
+// being used.
+
+#include "crypto/common.h"
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+namespace x11_aesni
+{
+namespace
+{
+const uint32_t SHAVITE_IV512[16] = {
+    0x72FCCDD8, 0x79CA4727, 0x128A077B, 0x40D55AEC,
+    0xD1901A06, 0x430AE307, 0xB29F5CD1, 0xDF07FBFC,
+    0x8E45D73D, 0x681AB538, 0xBDE86578, 0xDD577E47,
+    0xE275EADE, 0x502D9FCD, 0xB9357178, 0x022A4B9A
+};
+
+const uint32_t CUBEHASH_IV512[32] = {
+    0x2AEA2A61, 0x50F494D4, 0x2D538B8B, 0x4167D83E,
+    0x3FEE2313, 0xC701CF8C, 0xCC39968E, 0x50AC5695,
+    0x4D42C787, 0xA647A8B3, 0x97CF0BEF, 0x825B4537,
+    0xEEF864D2, 0xF22090C4, 0xD0E5CD33, 0xA23911AE,
+    0xFCD398D9, 0x148FE485, 0x1B017BEF, 0xB6444532,
+    0x6A536159, 0x2FF5781C, 0x91FA7934, 0x0DBADEA9,
+    0xD65C8A2B, 0xA5A70E75, 0xB1C62456, 0xBC796576,
+    0x1921C8F7, 0xE7989AF1, 0x7795D246, 0xD43E3B44
+};
+
+/** A full AES round without key addition (SubBytes, ShiftRows, MixColumns). */
+inline __m128i AESRoundNoKey(__m128i x)
+{
+    return _mm_aesenc_si128(x, _mm_setzero_si128());
+}
+
+inline __m128i Load(const uint32_t* p)
+{
+    return _mm_loadu_si128((const __m128i*)p);
+}
+
+inline void Store(uint32_t* p, __m128i x)
+{
+    _mm_storeu_si128((__m128i*)p, x);
+}
+
+/** GF(2^8) doubling of every byte, as in ECHO's BigMixColumns. */
+inline __m128i MulTwo(__m128i x)
+{
+    __m128i hi = _mm_cmplt_epi8(x, _mm_setzero_si128());
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(hi, _mm_set1_epi8(0x1B)));
+}
+
+inline __m128i RotL32(__m128i x, int n)
+{
+    return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+}
+
+/**
+ * Sixteen CubeHash rounds on N independent states; a[l] holds x[0..15] and
+ * b[l] holds x[16..31] of lane l, four words per register.
+ */
+template <int N>
+inline void CubeHashRounds(__m128i a[N][4], __m128i b[N][4])
+{
+    for (int r = 0; r < 16; r++) {
+        for (int l = 0; l < N; l++) {
+            for (int j = 0; j < 4; j++) {
+                b[l][j] = _mm_add_epi32(b[l][j], a[l][j]);
+                a[l][j] = RotL32(a[l][j], 7);
+            }
+        }
+        for (int l = 0; l < N; l++) {
+            __m128i t = a[l][0];
+            a[l][0] = a[l][2];
+            a[l][2] = t;
+            t = a[l][1];
+            a[l][1] = a[l][3];
+            a[l][3] = t;
+            for (int j = 0; j < 4; j++) {
+                a[l][j] = _mm_xor_si128(a[l][j], b[l][j]);
+                b[l][j] = _mm_shuffle_epi32(b[l][j], _MM_SHUFFLE(1, 0, 3, 2));
+            }
+        }
+        for (int l = 0; l < N; l++) {
+            for (int j = 0; j < 4; j++) {
+                b[l][j] = _mm_add_epi32(b[l][j], a[l][j]);
+                a[l][j] = RotL32(a[l][j], 11);
+            }
+        }
+        for (int l = 0; l < N; l++) {
+            __m128i t = a[l][0];
+            a[l][0] = a[l][1];
+            a[l][1] = t;
+            t = a[l][2];
+            a[l][2] = a[l][3];
+            a[l][3] = t;
+            for (int j = 0; j < 4; j++) {
+                a[l][j] = _mm_xor_si128(a[l][j], b[l][j]);
+                b[l][j] = _mm_shuffle_epi32(b[l][j], _MM_SHUFFLE(2, 3, 0, 1));
+            }
+        }
+    }
+}
+
+/** CUBEHASH-512 of N consecutive 64-byte inputs (two 32-byte blocks plus the padding block each). */
+template <int N>
+void Cubehash512Lanes(const unsigned char* in, unsigned char* out)
+{
+    __m128i a[N][4], b[N][4];
+    for (int l = 0; l < N; l++) {
+        for (int j = 0; j < 4; j++) {
+            a[l][j] = Load(&CUBEHASH_IV512[4 * j]);
+            b[l][j] = Load(&CUBEHASH_IV512[16 + 4 * j]);
+        }
+    }
+    for (int blk = 0; blk < 2; blk++) {
+        for (int l = 0; l < N; l++) {
+            a[l][0] = _mm_xor_si128(a[l][0], _mm_loadu_si128((const __m128i*)(in + 64 * l + 32 * blk)));
+            a[l][1] = _mm_xor_si128(a[l][1], _mm_loadu_si128((const __m128i*)(in + 64 * l + 32 * blk + 16)));
+        }
+        CubeHashRounds<N>(a, b);
+    }
+    for (int l = 0; l < N; l++)
+        a[l][0] = _mm_xor_si128(a[l][0], _mm_set_epi32(0, 0, 0, 0x80));
+    CubeHashRounds<N>(a, b);
+    for (int l = 0; l < N; l++)
+        b[l][3] = _mm_xor_si128(b[l][3], _mm_set_epi32(1, 0, 0, 0));
+    for (int i = 0; i < 10; i++)
+        CubeHashRounds<N>(a, b);
+    for (int l = 0; l < N; l++)
+        for (int j = 0; j < 4; j++)
+            _mm_storeu_si128((__m128i*)(out + 64 * l + 16 * j), a[l][j]);
+}
+
+/** SHAVITE-512 of N consecutive 64-byte inputs (one padded 128-byte block each, bit count 512). */
+template <int N>
+void Shavite512Lanes(const unsigned char* in, unsigned char* out)
+{
+    const uint32_t count0 = 512, count1 = 0, count2 = 0, count3 = 0;
+    uint32_t rk[N][448];
+
+    for (int l = 0; l < N; l++) {
+        unsigned char block[128];
+        memcpy(block, in + 64 * l, 64);
+        block[64] = 0x80;
+        memset(block + 65, 0, 110 - 65);
+        memset(block + 110, 0, 16);
+        block[110] = count0 & 0xFF;
+        block[111] = (count0 >> 8) & 0xFF;
+        block[126] = (16 << 5) & 0xFF;
+        block[127] = 16 >> 3;
+        memcpy(rk[l], block, 128);
+    }
+
+    // Message expansion (see c512() in crypto/shavite.c).
+    size_t u = 32;
+    for (;;) {
+        for (int s = 0; s < 4; s++) {
+            for (int l = 0; l < N; l++) {
+                __m128i x = _mm_shuffle_epi32(Load(&rk[l][u - 32]), _MM_SHUFFLE(0, 3, 2, 1));
+                x = _mm_xor_si128(AESRoundNoKey(x), Load(&rk[l][u - 4]));
+                if (u == 32)
+                    x = _mm_xor_si128(x, _mm_setr_epi32(count0, count1, count2, ~count3));
+                else if (u == 440)
+                    x = _mm_xor_si128(x, _mm_setr_epi32(count1, count0, count3, ~count2));
+                Store(&rk[l][u], x);
+            }
+            u += 4;
+
+            for (int l = 0; l < N; l++) {
+                __m128i x = _mm_shuffle_epi32(Load(&rk[l][u - 32]), _MM_SHUFFLE(0, 3, 2, 1));
+                x = _mm_xor_si128(AESRoundNoKey(x), Load(&rk[l][u - 4]));
+                if (u == 164)
+                    x = _mm_xor_si128(x, _mm_setr_epi32(count3, count2, count1, ~count0));
+                else if (u == 316)
+                    x = _mm_xor_si128(x, _mm_setr_epi32(count2, count3, count0, ~count1));
+                Store(&rk[l][u], x);
+            }
+            u += 4;
+        }
+        if (u == 448)
+            break;
+        for (int s = 0; s < 8; s++) {
+            for (int l = 0; l < N; l++)
+                Store(&rk[l][u], _mm_xor_si128(Load(&rk[l][u - 32]), Load(&rk[l][u - 7])));
+            u += 4;
+        }
+    }
+
+    // 14 rounds of the Feistel-like network on four 128-bit words. Each half
+    // round is a chain of four dependent AES rounds, so the lanes are stepped
+    // together to keep the AES unit busy.
+    __m128i h[N][4], p[N][4];
+    for (int l = 0; l < N; l++)
+        for (int i = 0; i < 4; i++)
+            h[l][i] = p[l][i] = Load(&SHAVITE_IV512[4 * i]);
+    u = 0;
+    for (int r = 0; r < 14; r++) {
+        for (int half = 0; half < 2; half++) {
+            __m128i x[N];
+            for (int l = 0; l < N; l++)
+                x[l] = AESRoundNoKey(_mm_xor_si128(p[l][2 * half + 1], Load(&rk[l][u])));
+            for (int k = 4; k < 16; k += 4)
+                for (int l = 0; l < N; l++)
+                    x[l] = AESRoundNoKey(_mm_xor_si128(x[l], Load(&rk[l][u + k])));
+            for (int l = 0; l < N; l++)
+                p[l][2 * half] = _mm_xor_si128(p[l][2 * half], x[l]);
+            u += 16;
+        }
+        for (int l = 0; l < N; l++) {
+            __m128i t = p[l][3];
+            p[l][3] = p[l][2];
+            p[l][2] = p[l][1];
+            p[l][1] = p[l][0];
+            p[l][0] = t;
+        }
+    }
+    for (int l = 0; l < N; l++)
+        for (int i = 0; i < 4; i++)
+            _mm_storeu_si128((__m128i*)(out + 64 * l + 16 * i), _mm_xor_si128(h[l][i], p[l][i]));
+}
+
+/** ECHO-512 of exactly 64 bytes (one padded 128-byte block, bit count 512). */
+void Echo512Lane(const unsigned char* in, unsigned char* out)
+{
+    __m128i W[16], V[8], M[8];
+
+    for (int i = 0; i < 8; i++)
+        V[i] = _mm_set_epi64x(0, 512);
+    M[0] = _mm_loadu_si128((const __m128i*)(in + 0));
+    M[1] = _mm_loadu_si128((const __m128i*)(in + 16));
+    M[2] = _mm_loadu_si128((const __m128i*)(in + 32));
+    M[3] = _mm_loadu_si128((const __m128i*)(in + 48));
+    M[4] = _mm_set_epi32(0, 0, 0, 0x80);
+    M[5] = _mm_setzero_si128();
+    // 16-bit output size (512) at byte 110, then the 128-bit bit counter.
+    M[6] = _mm_set_epi32(0x02000000, 0, 0, 0);
+    M[7] = _mm_set_epi32(0, 0, 0, 512);
+
+    for (int i = 0; i < 8; i++) {
+        W[i] = V[i];
+        W[i + 8] = M[i];
+    }
+
+    uint32_t k = 512;
+    for (int r = 0; r < 10; r++) {
+        // BigSubWords
+        for (int n = 0; n < 16; n++) {
+            W[n] = _mm_aesenc_si128(W[n], _mm_set_epi32(0, 0, 0, k++));
+            W[n] = AESRoundNoKey(W[n]);
+        }
+
+        // BigShiftRows
+        __m128i t = W[1];
+        W[1] = W[5];
+        W[5] = W[9];
+        W[9] = W[13];
+        W[13] = t;
+        t = W[2];
+        W[2] = W[10];
+        W[10] = t;
+        t = W[6];
+        W[6] = W[14];
+        W[14] = t;
+        t = W[15];
+        W[15] = W[11];
+        W[11] = W[7];
+        W[7] = W[3];
+        W[3] = t;
+
+        // BigMixColumns
+        for (int c = 0; c < 16; c += 4) {
+            __m128i a = W[c], b = W[c + 1], cc = W[c + 2], d = W[c + 3];
+            __m128i ab = _mm_xor_si128(a, b);
+            __m128i bc = _mm_xor_si128(b, cc);
+            __m128i cd = _mm_xor_si128(cc, d);
+            __m128i abx = MulTwo(ab);
+            __m128i bcx = MulTwo(bc);
+            __m128i cdx = MulTwo(cd);
+            W[c] = _mm_xor_si128(abx, _mm_xor_si128(bc, d));
+            W[c + 1] = _mm_xor_si128(bcx, _mm_xor_si128(a, cd));
+            W[c + 2] = _mm_xor_si128(cdx, _mm_xor_si128(ab, d));
+            W[c + 3] = _mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(_mm_xor_si128(cdx, ab), cc));
+        }
+    }
+
+    // BigFinal; only the first four chaining words form the 512-bit digest.
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_xor_si128(V[i], _mm_xor_si128(M[i], _mm_xor_si128(W[i], W[i + 8])));
+        _mm_storeu_si128((__m128i*)(out + 16 * i), v);
+    }
+}
+} // namespace
+
+void Cubehash512(const unsigned char* in, unsigned char* out, size_t n)
+{
+    for (; n >= 2; n -= 2, in += 128, out += 128)
+        Cubehash512Lanes<2>(in, out);
+    if (n)
+        Cubehash512Lanes<1>(in, out);
+}
+
+void Shavite512(const unsigned char* in, unsigned char* out, size_t n)
+{
+    for (; n >= 4; n -= 4, in += 256, out += 256)
+        Shavite512Lanes<4>(in, out);
+    for (; n > 0; n--, in += 64, out += 64)
+        Shavite512Lanes<1>(in, out);
+}
+
+void Echo512(const unsigned char* in, unsigned char* out, size_t n)
+{
+    // The sixteen AES states of one ECHO block are already independent, so
+    // there is nothing to gain from interleaving lanes here.
+    for (; n > 0; n--, in += 64, out += 64)
+        Echo512Lane(in, out);
+}
+} // namespace x11_aesni
+
+#endif // ENABLE_AESNI
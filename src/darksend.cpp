@@ -10,14 +10,17 @@
 #include "governance.h"
 #include "init.h"
 #include "instantx.h"
+#include "masternode-db.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
+#include "scheduler.h"
 #include "script/sign.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilmoneystr.h"
 
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 
 int nPrivateSendRounds = DEFAULT_PRIVATESEND_ROUNDS;
@@ -155,6 +158,7 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
             mnodeman.nDsqCount++;
             pmn->nLastDsq = mnodeman.nDsqCount;
             pmn->fAllowMixingTx = true;
+            mnodeman.FlagMasternodeAsDirty(pmn->vin.prevout);
 
             LogPrint("privatesend", "DSQUEUE -- new PrivateSend queue (%s) from masternode %s\n", dsq.ToString(), pmn->addr.ToString());
             if(pSubmittedToMasternode && pSubmittedToMasternode->vin.prevout == dsq.vin.prevout) {
@@ -2327,28 +2331,35 @@ bool CDarkSendSigner::GetKeysFromSecret(std::string strSecret, CKey& keyRet, CPu
 
 bool CDarkSendSigner::SignMessage(std::string strMessage, std::vector<unsigned char>& vchSigRet, CKey key)
 {
-    CHashWriter ss(SER_GETHASH, 0);
-    ss << strMessageMagic;
-    ss << strMessage;
-
-    return key.SignCompact(ss.GetHash(), vchSigRet);
+    return SignHash(GetMessageHash(strMessage), vchSigRet, key);
 }
 
 bool CDarkSendSigner::VerifyMessage(CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string strMessage, std::string& strErrorRet)
 {
-    CHashWriter ss(SER_GETHASH, 0);
-    ss << strMessageMagic;
-    ss << strMessage;
+    if(!VerifyHash(GetMessageHash(strMessage), pubkey, vchSig, strErrorRet)) {
+        strErrorRet += strprintf(", strMessage=%s", strMessage);
+        return false;
+    }
+
+    return true;
+}
+
+bool CDarkSendSigner::SignHash(const uint256& hash, std::vector<unsigned char>& vchSigRet, const CKey& key)
+{
+    return key.SignCompact(hash, vchSigRet);
+}
 
+bool CDarkSendSigner::VerifyHash(const uint256& hash, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
+{
     CPubKey pubkeyFromSig;
-    if(!pubkeyFromSig.RecoverCompact(ss.GetHash(), vchSig)) {
+    if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
         strErrorRet = "Error recovering public key.";
         return false;
     }
 
     if(pubkeyFromSig.GetID() != pubkey.GetID()) {
-        strErrorRet = strprintf("Keys don't match: pubkey=%s, pubkeyFromSig=%s, strMessage=%s, vchSig=%s",
-                                pubkey.GetID().ToString(), pubkeyFromSig.GetID().ToString(), strMessage,
+        strErrorRet = strprintf("Keys don't match: pubkey=%s, pubkeyFromSig=%s, hash=%s, vchSig=%s",
+                                pubkey.GetID().ToString(), pubkeyFromSig.GetID().ToString(), hash.ToString(),
                                 EncodeBase64(&vchSig[0], vchSig.size()));
         return false;
     }
@@ -2356,6 +2367,24 @@ bool CDarkSendSigner::VerifyMessage(CPubKey pubkey, const std::vector<unsigned c
     return true;
 }
 
+uint256 CDarkSendSigner::GetMessageHash(const std::string& strMessage)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << strMessageMagic;
+    ss << strMessage;
+    return ss.GetHash();
+}
+
+bool CDarkSendSigner::IsNewSigsActive()
+{
+    return sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+}
+
+int CDarkSendSigner::GetMinSignaturePeerVersion(int nMinPeerVersion)
+{
+    return IsNewSigsActive() ? std::max(nMinPeerVersion, MESSAGE_DIGEST_VERSION) : nMinPeerVersion;
+}
+
 bool CDarkSendEntry::AddScriptSig(const CTxIn& txin)
 {
     BOOST_FOREACH(CTxDSIn& txdsin, vecTxDSIn) {
@@ -2373,14 +2402,28 @@ bool CDarkSendEntry::AddScriptSig(const CTxIn& txin)
     return false;
 }
 
+uint256 CDarksendQueue::GetSignatureHash() const
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << std::string(NetMsgType::DSQUEUE);
+    ss << vin;
+    ss << nDenom;
+    ss << nTime;
+    ss << fReady;
+    return ss.GetHash();
+}
+
+std::string CDarksendQueue::GetSignatureMessage() const
+{
+    return vin.ToString() + boost::lexical_cast<std::string>(nDenom) + boost::lexical_cast<std::string>(nTime) + boost::lexical_cast<std::string>(fReady);
+}
+
 bool CDarksendQueue::Sign()
 {
     if(!fMasterNode) return false;
 
-    std::string strMessage = vin.ToString() + boost::lexical_cast<std::string>(nDenom) + boost::lexical_cast<std::string>(nTime) + boost::lexical_cast<std::string>(fReady);
-
-    if(!darkSendSigner.SignMessage(strMessage, vchSig, activeMasternode.keyMasternode)) {
-        LogPrintf("CDarksendQueue::Sign -- SignMessage() failed, %s\n", ToString());
+    if(!darkSendSigner.Sign(*this, vchSig, activeMasternode.keyMasternode)) {
+        LogPrintf("CDarksendQueue::Sign -- Sign() failed, %s\n", ToString());
         return false;
     }
 
@@ -2389,10 +2432,9 @@ bool CDarksendQueue::Sign()
 
 bool CDarksendQueue::CheckSignature(const CPubKey& pubKeyMasternode)
 {
-    std::string strMessage = vin.ToString() + boost::lexical_cast<std::string>(nDenom) + boost::lexical_cast<std::string>(nTime) + boost::lexical_cast<std::string>(fReady);
     std::string strError = "";
 
-    if(!darkSendSigner.VerifyMessage(pubKeyMasternode, vchSig, strMessage, strError)) {
+    if(!darkSendSigner.Verify(*this, pubKeyMasternode, vchSig, strError)) {
         LogPrintf("CDarksendQueue::CheckSignature -- Got bad Masternode queue signature: %s; error: %s\n", ToString(), strError);
         return false;
     }
@@ -2402,9 +2444,10 @@ bool CDarksendQueue::CheckSignature(const CPubKey& pubKeyMasternode)
 
 bool CDarksendQueue::Relay()
 {
+    int nMinPeerVersion = darkSendSigner.GetMinSignaturePeerVersion(MIN_PRIVATESEND_PEER_PROTO_VERSION);
     std::vector<CNode*> vNodesCopy = CopyNodeVector();
     BOOST_FOREACH(CNode* pnode, vNodesCopy)
-    if(pnode->nVersion >= MIN_PRIVATESEND_PEER_PROTO_VERSION)
+    if(pnode->nVersion >= nMinPeerVersion)
         pnode->PushMessage(NetMsgType::DSQUEUE, (*this));
 
     ReleaseNodeVector(vNodesCopy);
@@ -2500,61 +2543,114 @@ void CDarksendPool::UpdatedBlockTip(const CBlockIndex *pindex)
     }
 }
 
-//TODO: Rename/move to core
-void ThreadCheckDarkSendPool()
+// Whether the masternode list and everything that depends on it can be maintained yet
+static bool IsMaintenanceAllowed()
 {
-    if(fLiteMode) return; // disable all MonetaryUnit specific functionality
+    return masternodeSync.IsBlockchainSynced() && !ShutdownRequested();
+}
 
-    static bool fOneThread;
-    if(fOneThread) return;
-    fOneThread = true;
+static void ProcessPendingMasternodeMessages()
+{
+    // masternode announcements and pings left over from the last full batch
+    mnodeman.ProcessPendingMessages();
+}
 
-    // Make this thread recognisable as the PrivateSend thread
-    RenameThread("mue-privatesend");
+static void ProcessPendingGovernanceMessages()
+{
+    // governance objects and votes left over from the last full batch
+    governance.ProcessPendingMessages();
+}
 
-    unsigned int nTick = 0;
-    unsigned int nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN;
+static void CheckMasternodes()
+{
+    if(!IsMaintenanceAllowed()) return;
+    mnodeman.Check();
+}
 
-    while (true)
-    {
-        MilliSleep(1000);
+static void ManageActiveMasternode(CScheduler* pscheduler)
+{
+    // check if we should activate or ping every few minutes,
+    // try again shortly while the chain is still syncing
+    int64_t nDelay = 15;
+    if(IsMaintenanceAllowed()) {
+        activeMasternode.ManageState();
+        nDelay = MASTERNODE_MIN_MNP_SECONDS;
+    }
+    pscheduler->scheduleFromNow(boost::bind(&ManageActiveMasternode, pscheduler), nDelay);
+}
 
-        // try to sync from all available nodes, one step at a time
-        masternodeSync.ProcessTick();
+static void RemoveExpiredMasternodeData()
+{
+    if(!IsMaintenanceAllowed()) return;
+    mnodeman.ProcessMasternodeConnections();
+    mnodeman.CheckAndRemove();
+    mnpayments.CheckAndRemove();
+    instantsend.CheckAndRemove();
+}
 
-        if(masternodeSync.IsBlockchainSynced() && !ShutdownRequested()) {
+static void DoMasternodeVerificationStep()
+{
+    if(!IsMaintenanceAllowed() || !fMasterNode) return;
+    mnodeman.DoFullVerificationStep();
+}
 
-            nTick++;
+static void DoGovernanceMaintenance()
+{
+    if(!IsMaintenanceAllowed()) return;
+    governance.DoMaintenance();
+}
 
-            // make sure to check all masternodes first
-            mnodeman.Check();
+static void WriteMasternodeDB()
+{
+    if(!IsMaintenanceAllowed() || !pmasternodedb) return;
+    pmasternodedb->Write(mnodeman);
+}
 
-            // check if we should activate or ping every few minutes,
-            // slightly postpone first run to give net thread a chance to connect to some peers
-            if(nTick % MASTERNODE_MIN_MNP_SECONDS == 15)
-                activeMasternode.ManageState();
+static void CheckDarkSendPool()
+{
+    if(!IsMaintenanceAllowed()) return;
+    darkSendPool.CheckTimeout();
+    darkSendPool.CheckForCompleteQueue();
+}
 
-            if(nTick % 60 == 0) {
-                mnodeman.ProcessMasternodeConnections();
-                mnodeman.CheckAndRemove();
-                mnpayments.CheckAndRemove();
-                instantsend.CheckAndRemove();
-            }
-            if(fMasterNode && (nTick % (60 * 5) == 0)) {
-                mnodeman.DoFullVerificationStep();
-            }
+static void DoAutomaticDenominating(CScheduler* pscheduler)
+{
+    if(IsMaintenanceAllowed()) {
+        darkSendPool.DoAutomaticDenominating();
+    }
+    int64_t nDelay = PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN);
+    pscheduler->scheduleFromNow(boost::bind(&DoAutomaticDenominating, pscheduler), nDelay);
+}
 
-            if(nTick % (60 * 5) == 0) {
-                governance.DoMaintenance();
-            }
+static void LoadSeenMasternodeMessages()
+{
+    // not needed to start up, so loaded here rather than before
+    if(pmasternodedb) {
+        pmasternodedb->LoadSeenMessages(mnodeman);
+    }
+}
 
-            darkSendPool.CheckTimeout();
-            darkSendPool.CheckForCompleteQueue();
+//TODO: Rename/move to core
+void ScheduleDarkSendPoolTasks(CScheduler& scheduler)
+{
+    if(fLiteMode) return; // disable all MonetaryUnit specific functionality
 
-            if(nDoAutoNextRun == nTick) {
-                darkSendPool.DoAutomaticDenominating();
-                nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN);
-            }
-        }
-    }
+    scheduler.scheduleFromNow(&LoadSeenMasternodeMessages, 0);
+
+    // try to sync from all available nodes, one step at a time
+    scheduler.scheduleEvery(boost::bind(&CMasternodeSync::ProcessTick, &masternodeSync), MASTERNODE_SYNC_TICK_SECONDS);
+    scheduler.scheduleEvery(&ProcessPendingMasternodeMessages, 1);
+    scheduler.scheduleEvery(&ProcessPendingGovernanceMessages, 1);
+
+    // each masternode rechecks itself at most every MASTERNODE_CHECK_SECONDS anyway
+    scheduler.scheduleEvery(&CheckMasternodes, MASTERNODE_CHECK_SECONDS);
+    // slightly postpone first run to give net thread a chance to connect to some peers
+    scheduler.scheduleFromNow(boost::bind(&ManageActiveMasternode, &scheduler), 15);
+    scheduler.scheduleEvery(&RemoveExpiredMasternodeData, 60);
+    scheduler.scheduleEvery(&DoMasternodeVerificationStep, 60 * 5);
+    scheduler.scheduleEvery(&DoGovernanceMaintenance, 60 * 5);
+    scheduler.scheduleEvery(&WriteMasternodeDB, 60 * 10);
+
+    scheduler.scheduleEvery(&CheckDarkSendPool, 1);
+    scheduler.scheduleFromNow(boost::bind(&DoAutomaticDenominating, &scheduler), PRIVATESEND_AUTO_TIMEOUT_MIN);
 }
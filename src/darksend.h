@@ -10,6 +10,7 @@
 #include "wallet/wallet.h"
 
 class CDarksendPool;
+class CScheduler;
 class CDarkSendSigner;
 class CDarksendBroadcastTx;
 
@@ -180,6 +181,9 @@ public:
     /// Check if we have a valid Masternode address
     bool CheckSignature(const CPubKey& pubKeyMasternode);
 
+    uint256 GetSignatureHash() const;
+    std::string GetSignatureMessage() const;
+
     bool Relay();
 
     /// Is this queue expired?
@@ -250,6 +254,46 @@ public:
     bool SignMessage(std::string strMessage, std::vector<unsigned char>& vchSigRet, CKey key);
     /// Verify the message, returns true if succcessful
     bool VerifyMessage(CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string strMessage, std::string& strErrorRet);
+    /// Sign the hash, returns true if successful
+    bool SignHash(const uint256& hash, std::vector<unsigned char>& vchSigRet, const CKey& key);
+    /// Verify a signature of the hash, returns true if successful
+    bool VerifyHash(const uint256& hash, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
+    /// The hash SignMessage signs for the message
+    static uint256 GetMessageHash(const std::string& strMessage);
+    /// Are messages signed over their binary digest rather than their string form yet?
+    bool IsNewSigsActive();
+    /// Peers older than this would reject the masternode messages we sign or relay now
+    int GetMinSignaturePeerVersion(int nMinPeerVersion = MIN_PEER_PROTO_VERSION);
+
+    /**
+     * Masternode messages (type T) sign a binary digest of their fields,
+     * T::GetSignatureHash(), or as older peers do, the string
+     * T::GetSignatureMessage(). Both forms are accepted; SPORK_6_NEW_SIGS
+     * switches signers from the string to the digest. Digests start with
+     * the message's command name, so a signature is valid for one type only.
+     */
+    template <typename T>
+    uint256 GetSignedHash(const T& message)
+    {
+        return IsNewSigsActive() ? message.GetSignatureHash() : GetMessageHash(message.GetSignatureMessage());
+    }
+
+    template <typename T>
+    bool Sign(const T& message, std::vector<unsigned char>& vchSigRet, const CKey& key)
+    {
+        return SignHash(GetSignedHash(message), vchSigRet, key);
+    }
+
+    /// Verify a signature of the message in either form, starting with the one signers use now
+    template <typename T>
+    bool Verify(const T& message, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
+    {
+        bool fNewSigs = IsNewSigsActive();
+        if(VerifyHash(fNewSigs ? message.GetSignatureHash() : GetMessageHash(message.GetSignatureMessage()), pubkey, vchSig, strErrorRet)) {
+            return true;
+        }
+        return VerifyHash(fNewSigs ? GetMessageHash(message.GetSignatureMessage()) : message.GetSignatureHash(), pubkey, vchSig, strErrorRet);
+    }
 };
 
 /** Used to keep track of current status of mixing pool
@@ -497,6 +541,7 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
 };
 
-void ThreadCheckDarkSendPool();
+/** Schedule the periodic masternode, governance and PrivateSend tasks */
+void ScheduleDarkSendPoolTasks(CScheduler& scheduler);
 
 #endif
@@ -0,0 +1,61 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_EXPIRYQUEUE_H
+#define BITCOIN_EXPIRYQUEUE_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+/**
+ * Keys of a container ordered by when their entries expire (a time or a
+ * block height), so that expired entries can be removed without scanning
+ * the whole container.
+ *
+ * The container stays the authority on what expires when: a key that was
+ * erased or refreshed after it was pushed still comes out of the queue at
+ * its old expiry, and should be looked up again before anything is removed.
+ */
+template <typename K>
+class expiryqueue
+{
+public:
+    typedef K key_type;
+    typedef std::pair<int64_t, K> value_type;
+    typedef typename std::vector<value_type>::size_type size_type;
+
+protected:
+    std::priority_queue<value_type, std::vector<value_type>, std::greater<value_type> > queue;
+
+public:
+    void push(const key_type& k, int64_t nExpiry)
+    {
+        queue.push(std::make_pair(nExpiry, k));
+    }
+    /** Take the next key that expires before nNow, false when there is none */
+    bool pop_expired(int64_t nNow, key_type& kRet)
+    {
+        if (queue.empty() || queue.top().first >= nNow)
+            return false;
+        kRet = queue.top().second;
+        queue.pop();
+        return true;
+    }
+    size_type size() const {
+        return queue.size();
+    }
+    bool empty() const {
+        return queue.empty();
+    }
+    void clear()
+    {
+        std::priority_queue<value_type, std::vector<value_type>, std::greater<value_type> >().swap(queue);
+    }
+};
+
+#endif // BITCOIN_EXPIRYQUEUE_H
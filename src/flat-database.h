@@ -13,6 +13,64 @@
 #include "util.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/scoped_ptr.hpp>
+
+/**
+ * A file mapped into memory, read as a stream without copying it.
+ * Reads stop short of nEnd, which leaves out the checksum at the end.
+ */
+class CMappedFileReader
+{
+private:
+    boost::interprocess::file_mapping mapping;
+    boost::interprocess::mapped_region region;
+    const char* pbegin;
+    size_t nEnd;
+    size_t nPos;
+    int nType;
+    int nVersion;
+
+public:
+    // throws boost::interprocess::interprocess_exception if the file can't be mapped
+    CMappedFileReader(const boost::filesystem::path& path, int nTypeIn, int nVersionIn) :
+        mapping(path.string().c_str(), boost::interprocess::read_only),
+        region(mapping, boost::interprocess::read_only),
+        pbegin((const char*)region.get_address()),
+        nEnd(region.get_size()),
+        nPos(0),
+        nType(nTypeIn),
+        nVersion(nVersionIn)
+    {
+        region.advise(boost::interprocess::mapped_region::advice_sequential);
+    }
+
+    const char* data() const { return pbegin; }
+    size_t size() const { return region.get_size(); }
+
+    void SetEnd(size_t nEndIn) { nEnd = std::min(nEndIn, size()); }
+    size_t GetPos() const { return nPos; }
+    size_t GetRemaining() const { return nEnd - nPos; }
+
+    int GetType() { return nType; }
+    int GetVersion() { return nVersion; }
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > nEnd - nPos)
+            throw std::ios_base::failure("CMappedFileReader::read(): end of data");
+        memcpy(pch, pbegin + nPos, nSize);
+        nPos += nSize;
+    }
+
+    template<typename T>
+    CMappedFileReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
 
 /**
 *   Generic Dumping and Loading
@@ -44,125 +102,176 @@ private:
 
         int64_t nStart = GetTimeMillis();
 
-        // serialize, checksum data up to that point, then append checksum
-        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-        ssObj << strMagicMessage; // specific magic message for this type of object
-        ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-        ssObj << objToSave;
-        uint256 hash = Hash(ssObj.begin(), ssObj.end());
-        ssObj << hash;
+        // write next to the file and move it into place once complete, so a crash never leaves half a file
+        boost::filesystem::path pathTmp = pathDB.string() + ".new";
 
         // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
-        // Write and commit header, data
+        // serialize straight into the file, checksumming along the way, then append checksum
         try {
-            fileout << ssObj;
+            CHashingWriter<CAutoFile> writer(&fileout);
+            writer << strMagicMessage; // specific magic message for this type of object
+            writer << FLATDATA(Params().MessageStart()); // network specific magic number
+            writer << objToSave;
+            fileout << writer.GetHash();
         }
         catch (std::exception &e) {
+            fileout.fclose();
+            boost::filesystem::remove(pathTmp);
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
+        FileCommit(fileout.Get());
         fileout.fclose();
 
+        if (!RenameOver(pathTmp, pathDB)) {
+            boost::filesystem::remove(pathTmp);
+            return error("%s: Failed to rename %s to %s", __func__, pathTmp.string(), pathDB.string());
+        }
+
         LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToSave.ToString());
 
         return true;
     }
 
-    ReadResult Read(T& objToLoad, bool fDryRun = false)
+    /**
+     * Map the file and check its size. The reader is left positioned at the
+     * start, limited to the data before the checksum.
+     */
+    ReadResult Open(boost::scoped_ptr<CMappedFileReader>& pfilein, uint256& hashIn)
     {
-        //LOCK(objToLoad.cs);
-
-        int64_t nStart = GetTimeMillis();
-        // open input file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "rb");
-        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-        if (filein.IsNull())
-        {
+        try {
+            pfilein.reset(new CMappedFileReader(pathDB, SER_DISK, CLIENT_VERSION));
+        }
+        catch (std::exception &e) {
             error("%s: Failed to open file %s", __func__, pathDB.string());
             return FileError;
         }
 
-        // use file size to size memory buffer
-        int fileSize = boost::filesystem::file_size(pathDB);
-        int dataSize = fileSize - sizeof(uint256);
-        // Don't try to resize to a negative number if file is small
-        if (dataSize < 0)
-            dataSize = 0;
-        std::vector<unsigned char> vchData;
-        vchData.resize(dataSize);
-        uint256 hashIn;
-
-        // read data and checksum from file
-        try {
-            filein.read((char *)&vchData[0], dataSize);
-            filein >> hashIn;
-        }
-        catch (std::exception &e) {
-            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        if (pfilein->size() < sizeof(uint256)) {
+            error("%s: Deserialize or I/O error - file %s is too small", __func__, pathDB.string());
             return HashReadError;
         }
-        filein.fclose();
+        size_t nDataSize = pfilein->size() - sizeof(uint256);
+        memcpy(hashIn.begin(), pfilein->data() + nDataSize, sizeof(uint256));
+        pfilein->SetEnd(nDataSize);
+        return Ok;
+    }
+
+    ReadResult ReadHeader(CHashVerifier<CMappedFileReader>& verifier)
+    {
+        unsigned char pchMsgTmp[4];
+        std::string strMagicMessageTmp;
 
-        CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
+        // de-serialize file header (file specific magic message) and ..
+        verifier >> strMagicMessageTmp;
 
-        // verify stored checksum matches input data
-        uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-        if (hashIn != hashTmp)
+        // ... verify the message matches predefined one
+        if (strMagicMessage != strMagicMessageTmp)
         {
-            error("%s: Checksum mismatch, data corrupted", __func__);
-            return IncorrectHash;
+            error("%s: Invalid magic message", __func__);
+            return IncorrectMagicMessage;
         }
 
+        // de-serialize file header (network specific magic number) and ..
+        verifier >> FLATDATA(pchMsgTmp);
 
-        unsigned char pchMsgTmp[4];
-        std::string strMagicMessageTmp;
-        try {
-            // de-serialize file header (file specific magic message) and ..
-            ssObj >> strMagicMessageTmp;
+        // ... verify the network matches ours
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+        {
+            error("%s: Invalid network magic number", __func__);
+            return IncorrectMagicNumber;
+        }
 
-            // ... verify the message matches predefined one
-            if (strMagicMessage != strMagicMessageTmp)
-            {
-                error("%s: Invalid magic message", __func__);
-                return IncorrectMagicMessage;
-            }
+        return Ok;
+    }
 
+    /**
+     * Deserialize straight from the mapped file, hashing the data as it is
+     * read; the checksum is compared once the object is complete.
+     */
+    ReadResult Read(T& objToLoad)
+    {
+        //LOCK(objToLoad.cs);
 
-            // de-serialize file header (network specific magic number) and ..
-            ssObj >> FLATDATA(pchMsgTmp);
+        int64_t nStart = GetTimeMillis();
 
-            // ... verify the network matches ours
-            if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
-            {
-                error("%s: Invalid network magic number", __func__);
-                return IncorrectMagicNumber;
-            }
+        boost::scoped_ptr<CMappedFileReader> pfilein;
+        uint256 hashIn;
+        ReadResult result = Open(pfilein, hashIn);
+        if (result != Ok)
+            return result;
 
-            // de-serialize data into T object
-            ssObj >> objToLoad;
+        CHashVerifier<CMappedFileReader> verifier(pfilein.get());
+        try {
+            result = ReadHeader(verifier);
+            if (result == Ok) {
+                // de-serialize data into T object
+                verifier >> objToLoad;
+            }
         }
         catch (std::exception &e) {
             objToLoad.Clear();
+            // corrupted data fails to deserialize too, tell the two apart
+            if (Hash(pfilein->data(), pfilein->data() + pfilein->size() - sizeof(uint256)) != hashIn)
+            {
+                error("%s: Checksum mismatch, data corrupted", __func__);
+                return IncorrectHash;
+            }
             error("%s: Deserialize or I/O error - %s", __func__, e.what());
             return IncorrectFormat;
         }
 
+        // anything after the object is covered by the checksum as well
+        verifier.write(pfilein->data() + pfilein->GetPos(), pfilein->GetRemaining());
+        if (verifier.GetHash() != hashIn)
+        {
+            if (result == Ok)
+                objToLoad.Clear();
+            error("%s: Checksum mismatch, data corrupted", __func__);
+            return IncorrectHash;
+        }
+        if (result != Ok)
+            return result;
+
         LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToLoad.ToString());
-        if(!fDryRun) {
-            LogPrintf("%s: Cleaning....\n", __func__);
-            objToLoad.CheckAndRemove();
-            LogPrintf("     %s\n", objToLoad.ToString());
-        }
+        LogPrintf("%s: Cleaning....\n", __func__);
+        objToLoad.CheckAndRemove();
+        LogPrintf("     %s\n", objToLoad.ToString());
 
         return Ok;
     }
 
+    /** Check the checksum and header of the file, without deserializing the object */
+    ReadResult Verify()
+    {
+        boost::scoped_ptr<CMappedFileReader> pfilein;
+        uint256 hashIn;
+        ReadResult result = Open(pfilein, hashIn);
+        if (result != Ok)
+            return result;
+
+        if (Hash(pfilein->data(), pfilein->data() + pfilein->size() - sizeof(uint256)) != hashIn)
+        {
+            error("%s: Checksum mismatch, data corrupted", __func__);
+            return IncorrectHash;
+        }
+
+        CHashVerifier<CMappedFileReader> verifier(pfilein.get());
+        try {
+            return ReadHeader(verifier);
+        }
+        catch (std::exception &e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return IncorrectFormat;
+        }
+    }
+
 
 public:
     CFlatDB(std::string strFilenameIn, std::string strMagicMessageIn)
@@ -199,8 +308,7 @@ public:
         int64_t nStart = GetTimeMillis();
 
         LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
+        ReadResult readResult = Verify();
 
         // there was an error and it was not an error on file opening => do not proceed
         if (readResult == FileError)
@@ -35,6 +35,7 @@ CGovernanceObject::CGovernanceObject()
       fExpired(false),
       fUnparsable(false),
       mapCurrentMNVotes(),
+      mapVoteTally(),
       mapOrphanVotes(),
       fileVotes()
 {
@@ -63,6 +64,7 @@ CGovernanceObject::CGovernanceObject(uint256 nHashParentIn, int nRevisionIn, int
       fExpired(false),
       fUnparsable(false),
       mapCurrentMNVotes(),
+      mapVoteTally(),
       mapOrphanVotes(),
       fileVotes()
 {
@@ -91,6 +93,7 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other)
       fExpired(other.fExpired),
       fUnparsable(other.fUnparsable),
       mapCurrentMNVotes(other.mapCurrentMNVotes),
+      mapVoteTally(other.mapVoteTally),
       mapOrphanVotes(other.mapOrphanVotes),
       fileVotes(other.fileVotes)
 {}
@@ -104,7 +107,8 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         std::ostringstream ostr;
         ostr << "CGovernanceObject::ProcessVote -- Masternode index not found\n";
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_WARNING);
-        if(mapOrphanVotes.Insert(vote.GetVinMasternode(), vote_time_pair_t(vote, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME))) {
+        if(mapOrphanVotes.Insert(vote.GetVinMasternode().prevout, vote_time_pair_t(vote, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME))) {
+            governance.AddMasternodeOrphanVote(vote.GetVinMasternode().prevout, GetHash());
             if(pfrom) {
                 mnodeman.AskForMN(pfrom, vote.GetVinMasternode());
             }
@@ -188,6 +192,9 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_PERMANENT_ERROR);
         return false;
     }
+    vote_tally_t& tally = mapVoteTally[int(eSignal)];
+    tally.Add(voteInstance.eOutcome, -1);
+    tally.Add(vote.GetOutcome(), 1);
     voteInstance = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
     if(!fileVotes.HasVote(vote.GetHash())) {
         fileVotes.AddVote(vote);
@@ -209,6 +216,23 @@ void CGovernanceObject::RebuildVoteMap()
         }
     }
     mapCurrentMNVotes = mapMNVotesNew;
+    // votes of masternodes that are gone were dropped
+    RebuildVoteTally();
+}
+
+void CGovernanceObject::RebuildVoteTally()
+{
+    mapVoteTally.clear();
+    for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
+        TallyVoteRecord(it->second, 1);
+    }
+}
+
+void CGovernanceObject::TallyVoteRecord(const vote_rec_t& recVote, int nDelta)
+{
+    for(vote_instance_m_cit it = recVote.mapInstances.begin(); it != recVote.mapInstances.end(); ++it) {
+        mapVoteTally[it->first].Add(it->second.eOutcome, nDelta);
+    }
 }
 
 void CGovernanceObject::ClearMasternodeVotes()
@@ -219,7 +243,8 @@ void CGovernanceObject::ClearMasternodeVotes()
         CTxIn vinMasternode;
         bool fRemove = true;
         if(mnodeman.Get(it->first, vinMasternode, fIndexRebuilt)) {
-            if(mnodeman.Has(vinMasternode)) {
+            // votes are erased for good, so don't go by a possibly stale list view
+            if(mnodeman.HasLive(vinMasternode)) {
                 fRemove = false;
             }
             else {
@@ -228,6 +253,7 @@ void CGovernanceObject::ClearMasternodeVotes()
         }
 
         if(fRemove) {
+            TallyVoteRecord(it->second, -1);
             mapCurrentMNVotes.erase(it++);
         }
         else {
@@ -282,11 +308,17 @@ bool CGovernanceObject::CheckSignature(CPubKey& pubKeyMasternode)
 {
     std::string strError;
 
-    std::string strMessage = GetSignatureMessage();
+    uint256 hash = CDarkSendSigner::GetMessageHash(GetSignatureMessage());
 
     LOCK(cs);
-    if(!darkSendSigner.VerifyMessage(pubKeyMasternode, vchSig, strMessage, strError)) {
-        LogPrintf("CGovernance::CheckSignature -- VerifyMessage() failed, error: %s\n", strError);
+
+    // objects received in a batch had their signatures verified together beforehand
+    if(governance.IsSignatureVerified(pubKeyMasternode, vchSig, hash)) {
+        return true;
+    }
+
+    if(!darkSendSigner.VerifyHash(hash, pubKeyMasternode, vchSig, strError)) {
+        LogPrintf("CGovernance::CheckSignature -- VerifyHash() failed, error: %s\n", strError);
         return false;
     }
 
@@ -609,19 +641,11 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError)
 
 int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn) const
 {
-    int nCount = 0;
-    for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
-        const vote_rec_t& recVote = it->second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if(it2 == recVote.mapInstances.end()) {
-            continue;
-        }
-        const vote_instance_t& voteInstance = it2->second;
-        if(voteInstance.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
-        }
+    vote_tally_m_cit it = mapVoteTally.find(eVoteSignalIn);
+    if(it == mapVoteTally.end()) {
+        return 0;
     }
-    return nCount;
+    return it->second.Get(eVoteOutcomeIn);
 }
 
 /**
@@ -667,7 +691,8 @@ bool CGovernanceObject::GetCurrentMNVotes(const CTxIn& mnCollateralOutpoint, vot
 void CGovernanceObject::Relay()
 {
     CInv inv(MSG_GOVERNANCE_OBJECT, GetHash());
-    RelayInv(inv, PROTOCOL_VERSION);
+    // governance signatures are the same for every peer that takes governance messages
+    RelayInv(inv, MIN_GOVERNANCE_PEER_PROTO_VERSION);
 }
 
 void CGovernanceObject::UpdateSentinelVariables()
@@ -721,44 +746,61 @@ void CGovernanceObject::swap(CGovernanceObject& first, CGovernanceObject& second
     swap(first.nCollateralHash, second.nCollateralHash);
     swap(first.strData, second.strData);
     swap(first.nObjectType, second.nObjectType);
+    swap(first.vinMasternode, second.vinMasternode);
+    swap(first.vchSig, second.vchSig);
 
     // swap all cached valid flags
+    swap(first.fCachedLocalValidity, second.fCachedLocalValidity);
+    swap(first.strLocalValidityError, second.strLocalValidityError);
     swap(first.fCachedFunding, second.fCachedFunding);
     swap(first.fCachedValid, second.fCachedValid);
     swap(first.fCachedDelete, second.fCachedDelete);
     swap(first.fCachedEndorsed, second.fCachedEndorsed);
     swap(first.fDirtyCache, second.fDirtyCache);
     swap(first.fExpired, second.fExpired);
+    swap(first.fUnparsable, second.fUnparsable);
+
+    // and the votes
+    swap(first.mapCurrentMNVotes, second.mapCurrentMNVotes);
+    swap(first.mapVoteTally, second.mapVoteTally);
+    swap(first.mapOrphanVotes, second.mapOrphanVotes);
+    swap(first.fileVotes, second.fileVotes);
 }
 
-void CGovernanceObject::CheckOrphanVotes()
+void CGovernanceObject::CheckOrphanVotes(const COutPoint& outpointMasternode)
 {
+    std::vector<vote_time_pair_t> vecVotePairs;
+    mapOrphanVotes.GetAll(outpointMasternode, vecVotePairs);
+    mapOrphanVotes.Erase(outpointMasternode);
+
     int64_t nNow = GetAdjustedTime();
-    const vote_mcache_t::list_t& listVotes = mapOrphanVotes.GetItemList();
-    vote_mcache_t::list_cit it = listVotes.begin();
-    while(it != listVotes.end()) {
-        bool fRemove = false;
-        const CTxIn& key = it->key;
-        const vote_time_pair_t& pairVote = it->value;
+    for(size_t i = 0; i < vecVotePairs.size(); ++i) {
+        const vote_time_pair_t& pairVote = vecVotePairs[i];
         const CGovernanceVote& vote = pairVote.first;
         if(pairVote.second < nNow) {
-            fRemove = true;
-        }
-        else if(!mnodeman.Has(vote.GetVinMasternode())) {
-            ++it;
             continue;
         }
+        // should the masternode be missing again the vote is made an orphan again
         CGovernanceException exception;
         if(!ProcessVote(NULL, vote, exception)) {
             LogPrintf("CGovernanceObject::CheckOrphanVotes -- Failed to add orphan vote: %s\n", exception.what());
         }
         else {
             vote.Relay();
-            fRemove = true;
         }
-        ++it;
-        if(fRemove) {
-            mapOrphanVotes.Erase(key, pairVote);
+    }
+}
+
+bool CGovernanceObject::RemoveExpiredOrphanVotes(const COutPoint& outpointMasternode)
+{
+    std::vector<vote_time_pair_t> vecVotePairs;
+    mapOrphanVotes.GetAll(outpointMasternode, vecVotePairs);
+
+    int64_t nNow = GetAdjustedTime();
+    for(size_t i = 0; i < vecVotePairs.size(); ++i) {
+        if(vecVotePairs[i].second < nNow) {
+            mapOrphanVotes.Erase(outpointMasternode, vecVotePairs[i]);
         }
     }
+    return mapOrphanVotes.HasKey(outpointMasternode);
 }
@@ -27,6 +27,7 @@ class CGovernanceVote;
 static const int MAX_GOVERNANCE_OBJECT_DATA_SIZE = 16 * 1024;
 static const int MIN_GOVERNANCE_PEER_PROTO_VERSION = 70701;
 static const int GOVERNANCE_FILTER_PROTO_VERSION = 70701;
+static const int GOVERNANCE_VOTES_SINCE_PROTO_VERSION = 70702;
 
 static const double GOVERNANCE_FILTER_FP_RATE = 0.001;
 
@@ -42,6 +43,8 @@ static const int64_t GOVERNANCE_UPDATE_MIN = 3600;
 static const int64_t GOVERNANCE_DELETION_DELAY = 600;
 static const int64_t GOVERNANCE_ORPHAN_EXPIRATION_TIME = 600;
 static const int64_t GOVERNANCE_WATCHDOG_EXPIRATION_TIME = 7200;
+// votes are asked for this long before the time we last knew we had them all
+static const int64_t GOVERNANCE_VOTES_SINCE_MARGIN = 3600;
 
 static const int GOVERNANCE_TRIGGER_EXPIRATION_BLOCKS = 2160;
 
@@ -104,6 +107,58 @@ struct vote_rec_t {
     }
 };
 
+/**
+* Number of current masternode votes for one signal, by outcome
+*/
+struct vote_tally_t {
+    int nYesCount;
+    int nNoCount;
+    int nAbstainCount;
+
+    vote_tally_t()
+        : nYesCount(0),
+          nNoCount(0),
+          nAbstainCount(0)
+    {}
+
+    void Add(vote_outcome_enum_t eOutcome, int nDelta)
+    {
+        switch(eOutcome) {
+        case VOTE_OUTCOME_YES:
+            nYesCount += nDelta;
+            break;
+        case VOTE_OUTCOME_NO:
+            nNoCount += nDelta;
+            break;
+        case VOTE_OUTCOME_ABSTAIN:
+            nAbstainCount += nDelta;
+            break;
+        default:
+            break;
+        }
+    }
+
+    int Get(vote_outcome_enum_t eOutcome) const
+    {
+        switch(eOutcome) {
+        case VOTE_OUTCOME_YES:
+            return nYesCount;
+        case VOTE_OUTCOME_NO:
+            return nNoCount;
+        case VOTE_OUTCOME_ABSTAIN:
+            return nAbstainCount;
+        default:
+            return 0;
+        }
+    }
+};
+
+typedef std::map<int,vote_tally_t> vote_tally_m_t;
+
+typedef vote_tally_m_t::iterator vote_tally_m_it;
+
+typedef vote_tally_m_t::const_iterator vote_tally_m_cit;
+
 /**
 * Governance Object
 *
@@ -122,7 +177,7 @@ public: // Types
 
     typedef vote_m_t::const_iterator vote_m_cit;
 
-    typedef CacheMultiMap<CTxIn, vote_time_pair_t> vote_mcache_t;
+    typedef CacheMultiMap<COutPoint, vote_time_pair_t> vote_mcache_t;
 
 private:
     /// critical section to protect the inner data structures
@@ -184,6 +239,9 @@ private:
 
     vote_m_t mapCurrentMNVotes;
 
+    /// Outcomes of mapCurrentMNVotes counted by signal, kept up to date as votes come and go
+    vote_tally_m_t mapVoteTally;
+
     /// Limited map of votes orphaned by MN
     vote_mcache_t mapOrphanVotes;
 
@@ -325,6 +383,9 @@ public:
             READWRITE(mapCurrentMNVotes);
             READWRITE(fileVotes);
             LogPrint("gobject", "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
+            if(ser_action.ForRead()) {
+                RebuildVoteTally();
+            }
         }
 
         // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
@@ -347,10 +408,20 @@ private:
 
     void RebuildVoteMap();
 
+    /// Count the outcomes of mapCurrentMNVotes into mapVoteTally from scratch
+    void RebuildVoteTally();
+
+    /// Add (nDelta = 1) or take back (nDelta = -1) the outcomes of a masternode's votes in mapVoteTally
+    void TallyVoteRecord(const vote_rec_t& recVote, int nDelta);
+
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
 
-    void CheckOrphanVotes();
+    /// Process the orphan votes of a masternode which has just been added
+    void CheckOrphanVotes(const COutPoint& outpointMasternode);
+
+    /// Drop the expired orphan votes of a masternode, returns true if some are left
+    bool RemoveExpiredOrphanVotes(const COutPoint& outpointMasternode);
 
 };
 
@@ -137,6 +137,11 @@ public:
         vchSig = vchSigIn;
     }
 
+    const std::vector<unsigned char>& GetSignature() const {
+        return vchSig;
+    }
+
+    std::string GetSignatureMessage() const;
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool IsValid(bool fSignatureCheck) const;
     void Relay() const;
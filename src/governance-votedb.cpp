@@ -5,93 +5,318 @@
 
 #include "governance-votedb.h"
 
-CGovernanceObjectVoteFile::CGovernanceObjectVoteFile()
-    : nMemoryVotes(0),
-      listVotes(),
-      mapVoteIndex()
-{}
+#include "util.h"
+
+#include <algorithm>
+
+#include <boost/thread.hpp>
+
+static const char DB_VOTE = 'v';
+static const char DB_MASTERNODE_VOTE = 'm';
+static const char DB_VERSION = 'V';
+
+/** Version 1 added the masternode records */
+static const int VOTEDB_VERSION = 1;
+
+CGovernanceVoteDB* pgovernancevotedb = NULL;
+
+typedef std::pair<char, std::pair<uint256, std::pair<COutPoint, uint256> > > masternode_vote_key_t;
+
+static std::pair<char, std::pair<uint256, uint256> > VoteKey(const uint256& nParentHash, const uint256& nHash)
+{
+    return std::make_pair(DB_VOTE, std::make_pair(nParentHash, nHash));
+}
+
+static masternode_vote_key_t MasternodeVoteKey(const uint256& nParentHash, const COutPoint& outpointMasternode, const uint256& nHash)
+{
+    return std::make_pair(DB_MASTERNODE_VOTE, std::make_pair(nParentHash, std::make_pair(outpointMasternode, nHash)));
+}
+
+CGovernanceVoteDB::CGovernanceVoteDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(GetDataDir() / "govvotes", nCacheSize, fMemory, fWipe),
+    cacheVotes(MAX_CACHED_VOTES)
+{
+    if(!Exists(DB_VERSION)) {
+        IndexMasternodes();
+    }
+}
+
+void CGovernanceVoteDB::IndexMasternodes()
+{
+    LOCK(cs);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(&GetObfuscateKey());
+    int nIndexed = 0;
+
+    std::pair<char, std::pair<uint256, uint256> > key;
+    pcursor->Seek(VoteKey(uint256(), uint256()));
+    while(pcursor->Valid()) {
+        if(!pcursor->GetKey(key) || key.first != DB_VOTE) break;
+        CGovernanceVote vote;
+        if(pcursor->GetValue(vote)) {
+            batch.Write(MasternodeVoteKey(key.second.first, vote.GetVinMasternode().prevout, key.second.second), '1');
+            nIndexed++;
+        }
+        pcursor->Next();
+    }
+    batch.Write(DB_VERSION, VOTEDB_VERSION);
+
+    if(!WriteBatch(batch, true)) {
+        error("CGovernanceVoteDB::IndexMasternodes -- failed to index %d votes", nIndexed);
+        return;
+    }
+    if(nIndexed > 0) {
+        LogPrintf("CGovernanceVoteDB::IndexMasternodes -- indexed %d votes by masternode\n", nIndexed);
+    }
+}
+
+bool CGovernanceVoteDB::WriteVote(const CGovernanceVote& vote)
+{
+    LOCK(cs);
+    CDBBatch batch(&GetObfuscateKey());
+    batch.Write(VoteKey(vote.GetParentHash(), vote.GetHash()), vote);
+    batch.Write(MasternodeVoteKey(vote.GetParentHash(), vote.GetVinMasternode().prevout, vote.GetHash()), '1');
+    if(!WriteBatch(batch)) {
+        return error("CGovernanceVoteDB::WriteVote -- failed to write vote %s", vote.GetHash().ToString());
+    }
+    cacheVotes.Insert(vote.GetHash(), vote);
+    return true;
+}
+
+bool CGovernanceVoteDB::ReadVote(const uint256& nParentHash, const uint256& nHash, CGovernanceVote& voteRet)
+{
+    LOCK(cs);
+    if(cacheVotes.Get(nHash, voteRet) && voteRet.GetParentHash() == nParentHash) {
+        return true;
+    }
+    if(!Read(VoteKey(nParentHash, nHash), voteRet)) {
+        return false;
+    }
+    cacheVotes.Insert(nHash, voteRet);
+    return true;
+}
+
+bool CGovernanceVoteDB::HasVote(const uint256& nParentHash, const uint256& nHash)
+{
+    LOCK(cs);
+    CGovernanceVote vote;
+    if(cacheVotes.Get(nHash, vote) && vote.GetParentHash() == nParentHash) {
+        return true;
+    }
+    return Exists(VoteKey(nParentHash, nHash));
+}
+
+int CGovernanceVoteDB::EraseMasternodeVotes(const uint256& nParentHash, const COutPoint& outpointMasternode)
+{
+    LOCK(cs);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(&GetObfuscateKey());
+    int nErased = 0;
+
+    masternode_vote_key_t key;
+    pcursor->Seek(MasternodeVoteKey(nParentHash, outpointMasternode, uint256()));
+    while(pcursor->Valid()) {
+        if(!pcursor->GetKey(key) || key.first != DB_MASTERNODE_VOTE ||
+           key.second.first != nParentHash || key.second.second.first != outpointMasternode) break;
+        const uint256& nHash = key.second.second.second;
+        batch.Erase(key);
+        batch.Erase(VoteKey(nParentHash, nHash));
+        cacheVotes.Erase(nHash);
+        nErased++;
+        pcursor->Next();
+    }
+
+    if(nErased > 0 && !WriteBatch(batch)) {
+        error("CGovernanceVoteDB::EraseMasternodeVotes -- failed to erase %d votes of masternode %s on object %s", nErased, outpointMasternode.ToStringShort(), nParentHash.ToString());
+        return -1;
+    }
+    return nErased;
+}
+
+bool CGovernanceVoteDB::EraseObject(const uint256& nParentHash)
+{
+    LOCK(cs);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(&GetObfuscateKey());
+    int nErased = 0;
+
+    for(CGovernanceVoteCursor cursor(*this, nParentHash); cursor.Valid(); cursor.Next()) {
+        batch.Erase(VoteKey(nParentHash, cursor.GetVoteHash()));
+        cacheVotes.Erase(cursor.GetVoteHash());
+        nErased++;
+    }
+
+    masternode_vote_key_t key;
+    pcursor->Seek(MasternodeVoteKey(nParentHash, COutPoint(uint256(), 0), uint256()));
+    while(pcursor->Valid()) {
+        if(!pcursor->GetKey(key) || key.first != DB_MASTERNODE_VOTE || key.second.first != nParentHash) break;
+        batch.Erase(key);
+        pcursor->Next();
+    }
+
+    if(!WriteBatch(batch)) {
+        return error("CGovernanceVoteDB::EraseObject -- failed to erase %d votes of object %s", nErased, nParentHash.ToString());
+    }
+    return true;
+}
 
-CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other)
-    : nMemoryVotes(other.nMemoryVotes),
-      listVotes(other.listVotes),
-      mapVoteIndex()
+int CGovernanceVoteDB::PruneObjects(const std::set<uint256>& setKeep)
 {
-    RebuildIndex();
+    LOCK(cs);
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(&GetObfuscateKey());
+    int nErased = 0;
+
+    std::pair<char, std::pair<uint256, uint256> > key;
+    pcursor->Seek(VoteKey(uint256(), uint256()));
+    while(pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if(!pcursor->GetKey(key) || key.first != DB_VOTE) break;
+        if(!setKeep.count(key.second.first)) {
+            batch.Erase(key);
+            cacheVotes.Erase(key.second.second);
+            nErased++;
+        }
+        pcursor->Next();
+    }
+
+    masternode_vote_key_t keyMasternode;
+    pcursor->Seek(MasternodeVoteKey(uint256(), COutPoint(uint256(), 0), uint256()));
+    while(pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if(!pcursor->GetKey(keyMasternode) || keyMasternode.first != DB_MASTERNODE_VOTE) break;
+        if(!setKeep.count(keyMasternode.second.first)) {
+            batch.Erase(keyMasternode);
+        }
+        pcursor->Next();
+    }
+
+    if(!WriteBatch(batch)) {
+        error("CGovernanceVoteDB::PruneObjects -- failed to erase %d votes", nErased);
+        return 0;
+    }
+    return nErased;
 }
 
+CGovernanceVoteCursor::CGovernanceVoteCursor(CGovernanceVoteDB& db, const uint256& nParentHashIn, const uint256& nStartHash)
+    : pcursor(db.NewIterator()),
+      nParentHash(nParentHashIn),
+      key(),
+      fValid(false)
+{
+    pcursor->Seek(VoteKey(nParentHash, nStartHash));
+    ReadKey();
+}
+
+void CGovernanceVoteCursor::ReadKey()
+{
+    fValid = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_VOTE && key.second.first == nParentHash;
+}
+
+bool CGovernanceVoteCursor::GetVote(CGovernanceVote& voteRet)
+{
+    return fValid && pcursor->GetValue(voteRet);
+}
+
+void CGovernanceVoteCursor::Next()
+{
+    if(!fValid) return;
+    pcursor->Next();
+    ReadKey();
+}
+
+CGovernanceObjectVoteFile::CGovernanceObjectVoteFile()
+    : nParentHash(),
+      nVoteCount(0)
+{}
+
 void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
 {
-    listVotes.push_front(vote);
-    mapVoteIndex[vote.GetHash()] = listVotes.begin();
-    ++nMemoryVotes;
+    if(!pgovernancevotedb) return;
+    nParentHash = vote.GetParentHash();
+    if(pgovernancevotedb->WriteVote(vote)) {
+        ++nVoteCount;
+    }
 }
 
 bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
 {
-    vote_m_cit it = mapVoteIndex.find(nHash);
-    if(it == mapVoteIndex.end()) {
+    if(!pgovernancevotedb || nVoteCount == 0) {
         return false;
     }
-    return true;
+    return pgovernancevotedb->HasVote(nParentHash, nHash);
 }
 
 bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& vote) const
 {
-    vote_m_cit it = mapVoteIndex.find(nHash);
-    if(it == mapVoteIndex.end()) {
+    if(!pgovernancevotedb || nVoteCount == 0) {
         return false;
     }
-    vote = *(it->second);
-    return true;
+    return pgovernancevotedb->ReadVote(nParentHash, nHash, vote);
 }
 
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 {
     std::vector<CGovernanceVote> vecResult;
-    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
-        vecResult.push_back(*it);
+    if(!pgovernancevotedb || nVoteCount == 0) {
+        return vecResult;
+    }
+    vecResult.reserve(nVoteCount);
+    for(CGovernanceVoteCursor cursor(*pgovernancevotedb, nParentHash); cursor.Valid(); cursor.Next()) {
+        CGovernanceVote vote;
+        if(cursor.GetVote(vote)) {
+            vecResult.push_back(vote);
+        }
+    }
+    return vecResult;
+}
+
+std::vector<uint256> CGovernanceObjectVoteFile::GetVoteHashes() const
+{
+    std::vector<uint256> vecResult;
+    if(!pgovernancevotedb || nVoteCount == 0) {
+        return vecResult;
+    }
+    vecResult.reserve(nVoteCount);
+    for(CGovernanceVoteCursor cursor(*pgovernancevotedb, nParentHash); cursor.Valid(); cursor.Next()) {
+        vecResult.push_back(cursor.GetVoteHash());
     }
     return vecResult;
 }
 
 void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const CTxIn& vinMasternode)
 {
-    vote_l_it it = listVotes.begin();
-    while(it != listVotes.end()) {
-        if(it->GetVinMasternode() == vinMasternode) {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
-        }
-        else {
-            ++it;
-        }
+    if(!pgovernancevotedb || nVoteCount == 0) {
+        return;
+    }
+    int nErased = pgovernancevotedb->EraseMasternodeVotes(nParentHash, vinMasternode.prevout);
+    if(nErased > 0) {
+        nVoteCount -= std::min(nVoteCount, nErased);
     }
 }
 
-CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanceObjectVoteFile& other)
+void CGovernanceObjectVoteFile::RemoveAllVotes()
 {
-    nMemoryVotes = other.nMemoryVotes;
-    listVotes = other.listVotes;
-    RebuildIndex();
-    return *this;
+    if(!pgovernancevotedb || nVoteCount == 0) {
+        return;
+    }
+    if(pgovernancevotedb->EraseObject(nParentHash)) {
+        nVoteCount = 0;
+    }
 }
 
-void CGovernanceObjectVoteFile::RebuildIndex()
+void CGovernanceObjectVoteFile::Recount(const uint256& nParentHashIn)
 {
-    mapVoteIndex.clear();
-    nMemoryVotes = 0;
-    vote_l_it it = listVotes.begin();
-    while(it != listVotes.end()) {
-        CGovernanceVote& vote = *it;
-        uint256 nHash = vote.GetHash();
-        if(mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
-            mapVoteIndex[nHash] = it;
-            ++nMemoryVotes;
-            ++it;
-        }
-        else {
-            listVotes.erase(it++);
-        }
+    nParentHash = nParentHashIn;
+    nVoteCount = 0;
+    if(!pgovernancevotedb) {
+        return;
+    }
+    for(CGovernanceVoteCursor cursor(*pgovernancevotedb, nParentHash); cursor.Valid(); cursor.Next()) {
+        ++nVoteCount;
     }
 }
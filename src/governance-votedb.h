@@ -6,49 +6,116 @@
 #ifndef GOVERNANCE_VOTEDB_H
 #define GOVERNANCE_VOTEDB_H
 
-#include <list>
-#include <map>
+#include <set>
+#include <utility>
+#include <vector>
 
+#include <boost/scoped_ptr.hpp>
+
+#include "cachemap.h"
+#include "dbwrapper.h"
 #include "governance-vote.h"
 #include "serialize.h"
+#include "sync.h"
 #include "uint256.h"
 
+class CGovernanceVoteDB;
+
+extern CGovernanceVoteDB* pgovernancevotedb;
+
+//! cache size of the governance vote database (MiB)
+static const int64_t nGovernanceVoteDBCache = 8;
+
 /**
- * Represents the collection of votes associated with a given CGovernanceObject
- * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
+ * Access to the governance vote database (govvotes/), which holds the votes
+ * that used to be serialized into governance.dat along with their objects.
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * Votes are keyed by the object they belong to, so that the votes of one
+ * object can be read with a CGovernanceVoteCursor without loading the others.
+ * Each vote also has a placeholder record keyed by its object and masternode,
+ * so that the votes of a masternode can be erased without reading the others.
+ * The most recently read or written votes are also kept in memory, up to
+ * MAX_CACHED_VOTES of them.
  */
-class CGovernanceObjectVoteFile
+class CGovernanceVoteDB : public CDBWrapper
 {
-public: // Types
-    typedef std::list<CGovernanceVote> vote_l_t;
+private:
+    static const int MAX_CACHED_VOTES = 10000;
 
-    typedef vote_l_t::iterator vote_l_it;
+    CCriticalSection cs;
 
-    typedef vote_l_t::const_iterator vote_l_cit;
+    CacheMap<uint256, CGovernanceVote> cacheVotes;
 
-    typedef std::map<uint256,vote_l_it> vote_m_t;
+    /// Add the masternode records of a database written before there were any
+    void IndexMasternodes();
 
-    typedef vote_m_t::iterator vote_m_it;
+    CGovernanceVoteDB(const CGovernanceVoteDB&);
+    void operator=(const CGovernanceVoteDB&);
 
-    typedef vote_m_t::const_iterator vote_m_cit;
+public:
+    CGovernanceVoteDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool WriteVote(const CGovernanceVote& vote);
+    bool ReadVote(const uint256& nParentHash, const uint256& nHash, CGovernanceVote& voteRet);
+    bool HasVote(const uint256& nParentHash, const uint256& nHash);
+    /// Erase the votes of a masternode on an object, returns the number of votes erased or -1 on failure
+    int EraseMasternodeVotes(const uint256& nParentHash, const COutPoint& outpointMasternode);
+    /// Erase all the votes of an object
+    bool EraseObject(const uint256& nParentHash);
+    /// Erase the votes of every object that is not in setKeep, returns the number of votes erased
+    int PruneObjects(const std::set<uint256>& setKeep);
+};
 
+/**
+ * Iterates over the votes of one object in the vote database, in vote hash
+ * order, starting at the first vote whose hash is not below nStartHash. Like
+ * any database iterator it sees the votes as they were when it was created.
+ */
+class CGovernanceVoteCursor
+{
 private:
-    static const int MAX_MEMORY_VOTES = -1;
+    boost::scoped_ptr<CDBIterator> pcursor;
+
+    uint256 nParentHash;
 
-    int nMemoryVotes;
+    std::pair<char, std::pair<uint256, uint256> > key;
 
-    vote_l_t listVotes;
+    bool fValid;
 
-    vote_m_t mapVoteIndex;
+    void ReadKey();
 
 public:
-    CGovernanceObjectVoteFile();
+    CGovernanceVoteCursor(CGovernanceVoteDB& db, const uint256& nParentHashIn, const uint256& nStartHash = uint256());
+
+    bool Valid() const {
+        return fValid;
+    }
+
+    const uint256& GetVoteHash() const {
+        return key.second.second;
+    }
+
+    bool GetVote(CGovernanceVote& voteRet);
+
+    void Next();
+};
 
-    CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other);
+/**
+ * Represents the collection of votes associated with a given CGovernanceObject.
+ *
+ * The votes themselves live in the vote database; only the number of them is
+ * kept with the object, which is all that goes into governance.dat. Without a
+ * vote database (pgovernancevotedb is NULL) votes are dropped.
+ */
+class CGovernanceObjectVoteFile
+{
+private:
+    uint256 nParentHash;
+
+    int nVoteCount;
+
+public:
+    CGovernanceObjectVoteFile();
 
     /**
      * Add a vote to the file
@@ -56,39 +123,48 @@ public:
     void AddVote(const CGovernanceVote& vote);
 
     /**
-     * Return true if the vote with this hash is currently cached in memory
+     * Return true if the vote with this hash is in the file
      */
     bool HasVote(const uint256& nHash) const;
 
     /**
-     * Retrieve a vote cached in memory
+     * Retrieve a vote from the file
      */
     bool GetVote(const uint256& nHash, CGovernanceVote& vote) const;
 
-    int GetVoteCount() {
-        return nMemoryVotes;
+    int GetVoteCount() const {
+        return nVoteCount;
+    }
+
+    const uint256& GetParentHash() const {
+        return nParentHash;
     }
 
     std::vector<CGovernanceVote> GetVotes() const;
 
-    CGovernanceObjectVoteFile& operator=(const CGovernanceObjectVoteFile& other);
+    std::vector<uint256> GetVoteHashes() const;
 
     void RemoveVotesFromMasternode(const CTxIn& vinMasternode);
 
+    /**
+     * Erase all the votes, when the object is deleted
+     */
+    void RemoveAllVotes();
+
+    /**
+     * Count the votes of the object from the database again, which may have
+     * been written after governance.dat was
+     */
+    void Recount(const uint256& nParentHashIn);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
-        READWRITE(nMemoryVotes);
-        READWRITE(listVotes);
-        if(ser_action.ForRead()) {
-            RebuildIndex();
-        }
+        READWRITE(nParentHash);
+        READWRITE(nVoteCount);
     }
-private:
-    void RebuildIndex();
-
 };
 
 #endif
@@ -19,7 +19,7 @@ CGovernanceManager governance;
 
 int nSubmittedFinalBudget;
 
-const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-11"; //BBoBB CFRMD1360
+const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-14"; //BBoBB CFRMD1360
 
 CGovernanceManager::CGovernanceManager()
     : pCurrentBlockIndex(NULL),
@@ -37,6 +37,9 @@ CGovernanceManager::CGovernanceManager()
       mapLastMasternodeObject(),
       setRequestedObjects(),
       fRateChecksEnabled(true),
+      mapSyncCursors(),
+      mapVoteRequests(),
+      mapVotesComplete(),
       cs()
 {}
 
@@ -121,6 +124,7 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
         uint256 nProp;
         CBloomFilter filter;
+        int64_t nVotesSince = 0;
 
         vRecv >> nProp;
 
@@ -132,6 +136,10 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
             filter.clear();
         }
 
+        if(pfrom->nVersion >= GOVERNANCE_VOTES_SINCE_PROTO_VERSION && !vRecv.empty()) {
+            vRecv >> nVotesSince;
+        }
+
         if(nProp == uint256()) {
             if(netfulfilledman.HasFulfilledRequest(pfrom->addr, NetMsgType::MNGOVERNANCESYNC)) {
                 // Asking for the whole list multiple times in a short period of time is no good
@@ -142,7 +150,7 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
             netfulfilledman.AddFulfilledRequest(pfrom->addr, NetMsgType::MNGOVERNANCESYNC);
         }
 
-        Sync(pfrom, nProp, filter);
+        Sync(pfrom, nProp, filter, nVotesSince);
         LogPrint("gobject", "MNGOVERNANCESYNC -- syncing governance objects to our peer at %s\n", pfrom->addr.ToString());
 
     }
@@ -178,69 +186,7 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
             return;
         }
 
-        LOCK2(cs_main, cs);
-
-        if(mapSeenGovernanceObjects.count(nHash)) {
-            // TODO - print error code? what if it's GOVOBJ_ERROR_IMMATURE?
-            LogPrint("gobject", "MNGOVERNANCEOBJECT -- Received already seen object: %s\n", strHash);
-            return;
-        }
-
-        bool fRateCheckBypassed = false;
-        if(!MasternodeRateCheck(govobj, UPDATE_FAIL_ONLY, false, fRateCheckBypassed)) {
-            LogPrintf("MNGOVERNANCEOBJECT -- masternode rate check failed - %s - (current block height %d) \n", strHash, nCachedBlockHeight);
-            return;
-        }
-
-        std::string strError = "";
-        // CHECK OBJECT AGAINST LOCAL BLOCKCHAIN
-
-        bool fMasternodeMissing = false;
-        bool fIsValid = govobj.IsValidLocally(strError, fMasternodeMissing, true);
-
-        if(fMasternodeMissing) {
-            mapMasternodeOrphanObjects.insert(std::make_pair(nHash, object_time_pair_t(govobj, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME)));
-            LogPrintf("MNGOVERNANCEOBJECT -- Missing masternode for: %s, strError = %s\n", strHash, strError);
-            // fIsValid must also be false here so we will return early in the next if block
-        }
-        if(!fIsValid) {
-            mapSeenGovernanceObjects.insert(std::make_pair(nHash, SEEN_OBJECT_ERROR_INVALID));
-            LogPrintf("MNGOVERNANCEOBJECT -- Governance object is invalid - %s\n", strError);
-            return;
-        }
-
-        if(fRateCheckBypassed) {
-            if(!MasternodeRateCheck(govobj, UPDATE_FAIL_ONLY, true, fRateCheckBypassed)) {
-                LogPrintf("MNGOVERNANCEOBJECT -- masternode rate check failed (after signature verification) - %s - (current block height %d) \n", strHash, nCachedBlockHeight);
-                return;
-            }
-        }
-
-        // UPDATE CACHED VARIABLES FOR THIS OBJECT AND ADD IT TO OUR MANANGED DATA
-
-        govobj.UpdateSentinelVariables(); //this sets local vars in object
-
-        bool fAddToSeen = true;
-        if(AddGovernanceObject(govobj, fAddToSeen, pfrom))
-        {
-            LogPrintf("MNGOVERNANCEOBJECT -- %s new\n", strHash);
-            govobj.Relay();
-        }
-
-        if(fAddToSeen) {
-            // UPDATE THAT WE'VE SEEN THIS OBJECT
-            mapSeenGovernanceObjects.insert(std::make_pair(nHash, SEEN_OBJECT_IS_VALID));
-            // Update the rate buffer
-            MasternodeRateCheck(govobj, UPDATE_TRUE, true, fRateCheckBypassed);
-        }
-
-        masternodeSync.AddedGovernanceItem();
-
-
-        // WE MIGHT HAVE PENDING/ORPHAN VOTES FOR THIS OBJECT
-
-        CGovernanceException exception;
-        CheckOrphanVotes(govobj, exception);
+        QueueObject(pfrom, govobj);
     }
 
     // A NEW GOVERNANCE OBJECT VOTE HAS ARRIVED
@@ -268,20 +214,157 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
             return;
         }
 
-        CGovernanceException exception;
-        if(ProcessVote(pfrom, vote, exception)) {
-            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
-            masternodeSync.AddedGovernanceItem();
-            vote.Relay();
-        }
-        else {
-            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
-            if((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
-                Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
+        QueueVote(pfrom, vote);
+    }
+}
+
+void CGovernanceManager::QueueObject(CNode* pfrom, const CGovernanceObject& govobj)
+{
+    pending_message_t message;
+    message.fVote = false;
+    message.govobj = govobj;
+    pendingMessages.Queue(*this, pfrom, message);
+}
+
+void CGovernanceManager::QueueVote(CNode* pfrom, const CGovernanceVote& vote)
+{
+    pending_message_t message;
+    message.fVote = true;
+    message.vote = vote;
+    pendingMessages.Queue(*this, pfrom, message);
+}
+
+void CGovernanceManager::ProcessPendingMessages()
+{
+    size_t nCount = pendingMessages.Process(*this);
+    if(nCount > 0) {
+        LogPrint("gobject", "CGovernanceManager::ProcessPendingMessages -- processed %d messages\n", (int)nCount);
+    }
+}
+
+void CGovernanceManager::AddPendingSignatures(const std::vector<pending_message_t>& vecMessages, CMasternodeSignatureBatch& batch)
+{
+    BOOST_FOREACH(const pending_message_t& message, vecMessages) {
+        masternode_info_t infoMn;
+        if(message.fVote) {
+            const CGovernanceVote& vote = message.vote;
+            if(HaveVoteForHash(vote.GetHash())) continue;
+            infoMn = mnodeman.GetMasternodeInfo(vote.GetVinMasternode());
+            if(infoMn.fInfoValid) {
+                batch.Add(infoMn.pubKeyMasternode, vote.GetSignature(), CDarkSendSigner::GetMessageHash(vote.GetSignatureMessage()));
+            }
+        } else {
+            const CGovernanceObject& govobj = message.govobj;
+            // objects without a masternode are checked against their collateral instead
+            if(govobj.vinMasternode == CTxIn()) continue;
+            infoMn = mnodeman.GetMasternodeInfo(govobj.vinMasternode);
+            if(infoMn.fInfoValid) {
+                batch.Add(infoMn.pubKeyMasternode, govobj.vchSig, CDarkSendSigner::GetMessageHash(govobj.GetSignatureMessage()));
             }
+        }
+    }
+}
+
+void CGovernanceManager::ProcessPendingMessage(CNode* pfrom, pending_message_t& message)
+{
+    if(message.fVote) {
+        ProcessVoteMessage(pfrom, message.vote);
+    } else {
+        ProcessObjectMessage(pfrom, message.govobj);
+    }
+}
+
+bool CGovernanceManager::IsSignatureVerified(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash)
+{
+    return pendingMessages.IsVerified(pubKey, vchSig, hash);
+}
+
+void CGovernanceManager::ProcessObjectMessage(CNode* pfrom, CGovernanceObject& govobj)
+{
+    uint256 nHash = govobj.GetHash();
+    std::string strHash = nHash.ToString();
+
+    LOCK2(cs_main, cs);
+
+    if(mapSeenGovernanceObjects.count(nHash)) {
+        // TODO - print error code? what if it's GOVOBJ_ERROR_IMMATURE?
+        LogPrint("gobject", "MNGOVERNANCEOBJECT -- Received already seen object: %s\n", strHash);
+        return;
+    }
+
+    bool fRateCheckBypassed = false;
+    if(!MasternodeRateCheck(govobj, UPDATE_FAIL_ONLY, false, fRateCheckBypassed)) {
+        LogPrintf("MNGOVERNANCEOBJECT -- masternode rate check failed - %s - (current block height %d) \n", strHash, nCachedBlockHeight);
+        return;
+    }
+
+    std::string strError = "";
+    // CHECK OBJECT AGAINST LOCAL BLOCKCHAIN
+
+    bool fMasternodeMissing = false;
+    bool fIsValid = govobj.IsValidLocally(strError, fMasternodeMissing, true);
+
+    if(fMasternodeMissing) {
+        mapMasternodeOrphanObjects.insert(std::make_pair(nHash, object_time_pair_t(govobj, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME)));
+        mapMasternodeOrphanObjectIndex[govobj.vinMasternode.prevout].insert(nHash);
+        LogPrintf("MNGOVERNANCEOBJECT -- Missing masternode for: %s, strError = %s\n", strHash, strError);
+        // fIsValid must also be false here so we will return early in the next if block
+    }
+    if(!fIsValid) {
+        mapSeenGovernanceObjects.insert(std::make_pair(nHash, SEEN_OBJECT_ERROR_INVALID));
+        LogPrintf("MNGOVERNANCEOBJECT -- Governance object is invalid - %s\n", strError);
+        return;
+    }
+
+    if(fRateCheckBypassed) {
+        if(!MasternodeRateCheck(govobj, UPDATE_FAIL_ONLY, true, fRateCheckBypassed)) {
+            LogPrintf("MNGOVERNANCEOBJECT -- masternode rate check failed (after signature verification) - %s - (current block height %d) \n", strHash, nCachedBlockHeight);
             return;
         }
+    }
+
+    // UPDATE CACHED VARIABLES FOR THIS OBJECT AND ADD IT TO OUR MANANGED DATA
+
+    govobj.UpdateSentinelVariables(); //this sets local vars in object
+
+    bool fAddToSeen = true;
+    if(AddGovernanceObject(govobj, fAddToSeen, pfrom))
+    {
+        LogPrintf("MNGOVERNANCEOBJECT -- %s new\n", strHash);
+        govobj.Relay();
+    }
 
+    if(fAddToSeen) {
+        // UPDATE THAT WE'VE SEEN THIS OBJECT
+        mapSeenGovernanceObjects.insert(std::make_pair(nHash, SEEN_OBJECT_IS_VALID));
+        // Update the rate buffer
+        MasternodeRateCheck(govobj, UPDATE_TRUE, true, fRateCheckBypassed);
+    }
+
+    masternodeSync.AddedGovernanceItem();
+
+    // WE MIGHT HAVE PENDING/ORPHAN VOTES FOR THIS OBJECT
+
+    CGovernanceException exception;
+    CheckOrphanVotes(govobj, exception);
+}
+
+void CGovernanceManager::ProcessVoteMessage(CNode* pfrom, const CGovernanceVote& vote)
+{
+    uint256 nHash = vote.GetHash();
+    std::string strHash = nHash.ToString();
+
+    CGovernanceException exception;
+    if(ProcessVote(pfrom, vote, exception)) {
+        LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
+        masternodeSync.AddedGovernanceItem();
+        vote.Relay();
+    }
+    else {
+        LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
+        if((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
+            Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
+        }
     }
 }
 
@@ -459,6 +542,11 @@ void CGovernanceManager::UpdateCachesAndClean()
         }
     }
 
+    // votes are kept by masternode index, move them over to a rebuilt index before looking them up
+    if(mnodeman.GetIndexRebuiltFlag()) {
+        RebuildVoteMaps();
+    }
+
     for(size_t i = 0; i < vecDirtyHashes.size(); ++i) {
         object_m_it it = mapObjects.find(vecDirtyHashes[i]);
         if(it == mapObjects.end()) {
@@ -519,6 +607,7 @@ void CGovernanceManager::UpdateCachesAndClean()
                 (nTimeSinceDeletion >= GOVERNANCE_DELETION_DELAY)) {
             LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", (*it).first.ToString());
             mnodeman.RemoveGovernanceObject(pObj->GetHash());
+            pObj->GetVoteFile().RemoveAllVotes();
 
             // Remove vote references
             const object_ref_cache_t::list_t& listItems = mapVoteToObject.GetItemList();
@@ -536,6 +625,7 @@ void CGovernanceManager::UpdateCachesAndClean()
             if(pObj->nObjectType == GOVERNANCE_OBJECT_WATCHDOG) {
                 mapWatchdogObjects.erase(it->first);
             }
+            mapVotesComplete.erase(it->first);
             mapObjects.erase(it++);
         } else {
             ++it;
@@ -555,20 +645,6 @@ CGovernanceObject *CGovernanceManager::FindGovernanceObject(const uint256& nHash
     return NULL;
 }
 
-std::vector<CGovernanceVote> CGovernanceManager::GetMatchingVotes(const uint256& nParentHash)
-{
-    LOCK(cs);
-    std::vector<CGovernanceVote> vecResult;
-
-    object_m_it it = mapObjects.find(nParentHash);
-    if(it == mapObjects.end()) {
-        return vecResult;
-    }
-    CGovernanceObject& govobj = it->second;
-
-    return govobj.GetVoteFile().GetVotes();
-}
-
 std::vector<CGovernanceVote> CGovernanceManager::GetCurrentVotes(const uint256& nParentHash, const CTxIn& mnCollateralOutpointFilter)
 {
     LOCK(cs);
@@ -677,6 +753,8 @@ void CGovernanceManager::DoMaintenance()
     // CHECK AND REMOVE - REPROCESS GOVERNANCE OBJECTS
 
     UpdateCachesAndClean();
+
+    CleanSyncCursors();
 }
 
 bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
@@ -735,86 +813,246 @@ bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
     return true;
 }
 
-void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFilter& filter)
+void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFilter& filter, int64_t nVotesSince)
 {
 
     /*
-        This code checks each of the hash maps for all known budget proposals and finalized budget proposals, then checks them against the
-        budget object to see if they're OK. If all checks pass, we'll send it to the peer.
+        This queues the request, SendSyncChunk() then checks each of the known governance objects (or the votes of the
+        one asked for) a chunk at a time and sends them to the peer if they're OK.
     */
 
     // do not provide any data until our node is synced
     if(fMasterNode && !masternodeSync.IsSynced()) return;
 
-    int nObjCount = 0;
-    int nVoteCount = 0;
-
-    // SYNC GOVERNANCE OBJECTS WITH OTHER CLIENT
-
-    LogPrint("gobject", "CGovernanceManager::Sync -- syncing to peer=%d, nProp = %s\n", pfrom->id, nProp.ToString());
+    LogPrint("gobject", "CGovernanceManager::Sync -- syncing to peer=%d, nProp = %s, nVotesSince = %d\n", pfrom->id, nProp.ToString(), nVotesSince);
 
     {
-        LOCK2(cs_main, cs);
-
-        if(nProp == uint256()) {
-            // all valid objects, no votes
-            for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
-                CGovernanceObject& govobj = it->second;
-                std::string strHash = it->first.ToString();
+        LOCK(cs);
 
-                LogPrint("gobject", "CGovernanceManager::Sync -- attempting to sync govobj: %s, peer=%d\n", strHash, pfrom->id);
+        std::list<sync_cursor_rec>& listCursors = mapSyncCursors[pfrom->id];
+        BOOST_FOREACH(const sync_cursor_rec& cursorWaiting, listCursors) {
+            if(cursorWaiting.nProp == nProp) {
+                // answered once the one waiting is
+                LogPrint("gobject", "CGovernanceManager::Sync -- request already waiting, ignoring, peer=%d\n", pfrom->id);
+                return;
+            }
+        }
 
-                if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) {
-                    LogPrintf("CGovernanceManager::Sync -- not syncing deleted/expired govobj: %s, peer=%d\n",
-                              strHash, pfrom->id);
-                    continue;
-                }
+        bool fQueue = true;
+        sync_cursor_rec cursor(nProp, filter, nVotesSince);
 
-                // Push the inventory budget proposal message over to the other client
-                LogPrint("gobject", "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", strHash, pfrom->id);
-                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
-                ++nObjCount;
-            }
-        } else {
+        if(listCursors.size() >= MAX_SYNC_CURSORS_PER_PEER) {
+            LogPrint("gobject", "CGovernanceManager::Sync -- too many requests waiting, answering with nothing, peer=%d\n", pfrom->id);
+            fQueue = false;
+        }
+        else if(nProp != uint256()) {
             // single valid object and its valid votes
             object_m_it it = mapObjects.find(nProp);
             if(it == mapObjects.end()) {
                 LogPrint("gobject", "CGovernanceManager::Sync -- no matching object for hash %s, peer=%d\n", nProp.ToString(), pfrom->id);
-                return;
+                fQueue = false;
             }
-            CGovernanceObject& govobj = it->second;
-            std::string strHash = it->first.ToString();
-
-            LogPrint("gobject", "CGovernanceManager::Sync -- attempting to sync govobj: %s, peer=%d\n", strHash, pfrom->id);
-
-            if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) {
+            else if(it->second.IsSetCachedDelete() || it->second.IsSetExpired()) {
                 LogPrintf("CGovernanceManager::Sync -- not syncing deleted/expired govobj: %s, peer=%d\n",
-                          strHash, pfrom->id);
-                return;
+                          it->first.ToString(), pfrom->id);
+                fQueue = false;
             }
+            else {
+                // Push the inventory budget proposal message over to the other client
+                LogPrint("gobject", "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", it->first.ToString(), pfrom->id);
+                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
+                ++cursor.nObjCount;
+            }
+        }
 
-            // Push the inventory budget proposal message over to the other client
-            LogPrint("gobject", "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", strHash, pfrom->id);
-            pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
-            ++nObjCount;
+        if(fQueue) {
+            listCursors.push_back(cursor);
+            return;
+        }
+        if(listCursors.empty()) mapSyncCursors.erase(pfrom->id);
+    }
 
-            std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-            for(size_t i = 0; i < vecVotes.size(); ++i) {
-                if(!vecVotes[i].IsValid(true)) {
-                    continue;
-                }
-                if(filter.contains(vecVotes[i].GetHash())) {
-                    continue;
-                }
-                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
-                ++nVoteCount;
-            }
+    // don't keep the peer waiting for an answer
+    SendSyncStatus(pfrom, nProp, 0, 0);
+}
+
+void CGovernanceManager::SendSyncChunk(CNode* pto)
+{
+    uint256 nProp;
+    int nObjCount = 0;
+    int nVoteCount = 0;
+
+    {
+        // called for every peer all the time, try again next time rather than hold up the network thread
+        TRY_LOCK(cs, lockGovernance);
+        if(!lockGovernance) return;
+
+        sync_cursor_m_it it = mapSyncCursors.find(pto->id);
+        if(it == mapSyncCursors.end()) return;
+
+        sync_cursor_rec& cursor = it->second.front();
+        bool fDone = (cursor.nProp == uint256()) ? SyncObjectsChunk(pto, cursor) : SyncVotesChunk(pto, cursor);
+        if(!fDone) return;
+
+        nProp = cursor.nProp;
+        nObjCount = cursor.nObjCount;
+        nVoteCount = cursor.nVoteCount;
+        it->second.pop_front();
+        if(it->second.empty()) {
+            mapSyncCursors.erase(it);
+        }
+    }
+
+    SendSyncStatus(pto, nProp, nObjCount, nVoteCount);
+    LogPrintf("CGovernanceManager::SendSyncChunk -- sent %d objects and %d votes to peer=%d\n", nObjCount, nVoteCount, pto->id);
+}
+
+void CGovernanceManager::SendSyncStatus(CNode* pto, const uint256& nProp, int nObjCount, int nVoteCount)
+{
+    // peers that can ask for recent votes only also learn which of their requests the counts answer
+    if(nProp != uint256() && pto->nVersion >= GOVERNANCE_VOTES_SINCE_PROTO_VERSION) {
+        pto->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ, nObjCount, nProp);
+        pto->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount, nProp);
+        return;
+    }
+    pto->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ, nObjCount);
+    pto->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount);
+}
+
+void CGovernanceManager::SyncStatusCount(CNode* pfrom, int nItemID, int nCount, const uint256& nProp)
+{
+    LOCK(cs);
+
+    vote_request_m_it itNode = mapVoteRequests.find(pfrom->id);
+    if(itNode == mapVoteRequests.end()) return;
+    std::map<uint256, vote_request_rec>::iterator it = itNode->second.find(nProp);
+    if(it == itNode->second.end()) return;
+
+    if(nItemID == MASTERNODE_SYNC_GOVOBJ) {
+        it->second.fObjectSent = nCount > 0;
+        return;
+    }
+    if(nItemID != MASTERNODE_SYNC_GOVOBJ_VOTE) return;
+
+    // the peer offered us every vote of the object it had when we asked
+    if(it->second.fAllVotes && it->second.fObjectSent && mapObjects.count(nProp)) {
+        int64_t& nTimeComplete = mapVotesComplete[nProp];
+        nTimeComplete = std::max(nTimeComplete, it->second.nTimeRequested);
+        LogPrint("gobject", "CGovernanceManager::SyncStatusCount -- have all votes of %s before %d, peer=%d\n", nProp.ToString(), nTimeComplete, pfrom->id);
+    }
+
+    itNode->second.erase(it);
+    if(itNode->second.empty()) {
+        mapVoteRequests.erase(itNode);
+    }
+}
+
+size_t CGovernanceManager::GetVoteRequestCount(NodeId nodeid)
+{
+    LOCK(cs);
+    vote_request_m_it it = mapVoteRequests.find(nodeid);
+    return it == mapVoteRequests.end() ? 0 : it->second.size();
+}
+
+void CGovernanceManager::RemoveSyncRequests(NodeId nodeid)
+{
+    LOCK(cs);
+    mapSyncCursors.erase(nodeid);
+    mapVoteRequests.erase(nodeid);
+}
+
+bool CGovernanceManager::SyncObjectsChunk(CNode* pto, sync_cursor_rec& cursor)
+{
+    // all valid objects, no votes
+    object_m_it it = cursor.nHashLast.IsNull() ? mapObjects.begin() : mapObjects.upper_bound(cursor.nHashLast);
+    for(int nExamined = 0; it != mapObjects.end() && nExamined < SYNC_CHUNK_SIZE; ++it, ++nExamined) {
+        CGovernanceObject& govobj = it->second;
+        std::string strHash = it->first.ToString();
+        cursor.nHashLast = it->first;
+
+        LogPrint("gobject", "CGovernanceManager::SyncObjectsChunk -- attempting to sync govobj: %s, peer=%d\n", strHash, pto->id);
+
+        if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) {
+            LogPrintf("CGovernanceManager::SyncObjectsChunk -- not syncing deleted/expired govobj: %s, peer=%d\n",
+                      strHash, pto->id);
+            continue;
+        }
+
+        // Push the inventory budget proposal message over to the other client
+        LogPrint("gobject", "CGovernanceManager::SyncObjectsChunk -- syncing govobj: %s, peer=%d\n", strHash, pto->id);
+        pto->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
+        ++cursor.nObjCount;
+    }
+    return it == mapObjects.end();
+}
+
+bool CGovernanceManager::SyncVotesChunk(CNode* pto, sync_cursor_rec& cursor)
+{
+    // the object may have been deleted since the request came in
+    if(!pgovernancevotedb || !mapObjects.count(cursor.nProp)) return true;
+
+    CGovernanceVoteCursor dbcursor(*pgovernancevotedb, cursor.nProp, cursor.nHashLast);
+    if(dbcursor.Valid() && dbcursor.GetVoteHash() == cursor.nHashLast) {
+        dbcursor.Next();
+    }
+    for(int nExamined = 0; dbcursor.Valid() && nExamined < SYNC_CHUNK_SIZE; dbcursor.Next(), ++nExamined) {
+        uint256 nHash = dbcursor.GetVoteHash();
+        cursor.nHashLast = nHash;
+        if(cursor.filter.contains(nHash)) {
+            continue;
+        }
+        CGovernanceVote vote;
+        if(!dbcursor.GetVote(vote) || vote.GetTimestamp() < cursor.nVotesSince) {
+            continue;
+        }
+        // the signature was checked when the vote was accepted, only make sure its masternode is still around
+        if(!vote.IsValid(false)) {
+            continue;
         }
+        pto->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, nHash));
+        ++cursor.nVoteCount;
     }
+    return !dbcursor.Valid();
+}
 
-    pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ, nObjCount);
-    pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount);
-    LogPrintf("CGovernanceManager::Sync -- sent %d objects and %d votes to peer=%d\n", nObjCount, nVoteCount, pfrom->id);
+void CGovernanceManager::CleanSyncCursors()
+{
+    LOCK(cs);
+
+    int64_t nNow = GetTime();
+    sync_cursor_m_it it = mapSyncCursors.begin();
+    while(it != mapSyncCursors.end()) {
+        std::list<sync_cursor_rec>& listCursors = it->second;
+        while(!listCursors.empty() && listCursors.front().nTimeCreated + SYNC_CURSOR_TIMEOUT < nNow) {
+            listCursors.pop_front();
+        }
+        if(listCursors.empty()) {
+            mapSyncCursors.erase(it++);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    // our requests the peer never answered, e.g. because it wasn't synced yet
+    vote_request_m_it itNode = mapVoteRequests.begin();
+    while(itNode != mapVoteRequests.end()) {
+        std::map<uint256, vote_request_rec>::iterator itRequest = itNode->second.begin();
+        while(itRequest != itNode->second.end()) {
+            if(itRequest->second.nTimeRequested + SYNC_CURSOR_TIMEOUT < nNow) {
+                itNode->second.erase(itRequest++);
+            }
+            else {
+                ++itRequest;
+            }
+        }
+        if(itNode->second.empty()) {
+            mapVoteRequests.erase(itNode++);
+        }
+        else {
+            ++itNode;
+        }
+    }
 }
 
 bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, update_mode_enum_t eUpdateLast)
@@ -990,52 +1228,68 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
     return fOk;
 }
 
-void CGovernanceManager::CheckMasternodeOrphanVotes()
+void CGovernanceManager::CheckMasternodeOrphanVotes(const std::vector<COutPoint>& vecOutpoints)
 {
     LOCK2(cs_main, cs);
     fRateChecksEnabled = false;
-    for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
-        it->second.CheckOrphanVotes();
+    for(size_t i = 0; i < vecOutpoints.size(); ++i) {
+        txout_hash_m_it itIndex = mapMasternodeOrphanVoteIndex.find(vecOutpoints[i]);
+        if(itIndex == mapMasternodeOrphanVoteIndex.end()) continue;
+        // votes that are still orphans afterwards are indexed again
+        std::set<uint256> setHashes;
+        setHashes.swap(itIndex->second);
+        mapMasternodeOrphanVoteIndex.erase(itIndex);
+        BOOST_FOREACH(const uint256& nHash, setHashes) {
+            object_m_it it = mapObjects.find(nHash);
+            if(it == mapObjects.end()) continue;
+            it->second.CheckOrphanVotes(vecOutpoints[i]);
+        }
     }
     fRateChecksEnabled = true;
 }
 
-void CGovernanceManager::CheckMasternodeOrphanObjects()
+void CGovernanceManager::CheckMasternodeOrphanObjects(const std::vector<COutPoint>& vecOutpoints)
 {
     LOCK2(cs_main, cs);
     int64_t nNow = GetAdjustedTime();
     fRateChecksEnabled = false;
-    object_time_m_it it = mapMasternodeOrphanObjects.begin();
-    while(it != mapMasternodeOrphanObjects.end()) {
-        object_time_pair_t& pair = it->second;
-        CGovernanceObject& govobj = pair.first;
-
-        if(pair.second < nNow) {
-            mapMasternodeOrphanObjects.erase(it++);
-            continue;
-        }
-
-        string strError;
-        bool fMasternodeMissing = false;
-        bool fIsValid = govobj.IsValidLocally(strError, fMasternodeMissing, true);
-        if(!fIsValid) {
-            if(!fMasternodeMissing) {
-                mapMasternodeOrphanObjects.erase(it++);
+    for(size_t i = 0; i < vecOutpoints.size(); ++i) {
+        txout_hash_m_it itIndex = mapMasternodeOrphanObjectIndex.find(vecOutpoints[i]);
+        if(itIndex == mapMasternodeOrphanObjectIndex.end()) continue;
+        std::set<uint256> setHashes;
+        setHashes.swap(itIndex->second);
+        mapMasternodeOrphanObjectIndex.erase(itIndex);
+        BOOST_FOREACH(const uint256& nHash, setHashes) {
+            object_time_m_it it = mapMasternodeOrphanObjects.find(nHash);
+            if(it == mapMasternodeOrphanObjects.end()) continue;
+
+            object_time_pair_t& pair = it->second;
+            CGovernanceObject& govobj = pair.first;
+
+            if(pair.second < nNow) {
+                mapMasternodeOrphanObjects.erase(it);
+                continue;
             }
-            else {
-                ++it;
+
+            string strError;
+            bool fMasternodeMissing = false;
+            bool fIsValid = govobj.IsValidLocally(strError, fMasternodeMissing, true);
+            if(!fIsValid) {
+                if(fMasternodeMissing) {
+                    mapMasternodeOrphanObjectIndex[govobj.vinMasternode.prevout].insert(nHash);
+                }
+                else {
+                    mapMasternodeOrphanObjects.erase(it);
+                }
+                continue;
             }
-            continue;
-        }
 
-        bool fAddToSeen = true;
-        if(AddGovernanceObject(govobj, fAddToSeen)) {
-            LogPrintf("CGovernanceManager::CheckMasternodeOrphanObjects -- %s new\n", govobj.GetHash().ToString());
-            govobj.Relay();
-            mapMasternodeOrphanObjects.erase(it++);
-        }
-        else {
-            ++it;
+            bool fAddToSeen = true;
+            if(AddGovernanceObject(govobj, fAddToSeen)) {
+                LogPrintf("CGovernanceManager::CheckMasternodeOrphanObjects -- %s new\n", nHash.ToString());
+                govobj.Relay();
+            }
+            mapMasternodeOrphanObjects.erase(it);
         }
     }
     fRateChecksEnabled = true;
@@ -1057,20 +1311,39 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
     CBloomFilter filter;
     filter.clear();
 
+    // peers that know about it only send the votes we could be missing, so the filter only needs to hold those
+    int64_t nVotesSince = 0;
+
     if(fUseFilter) {
         LOCK(cs);
         CGovernanceObject* pObj = FindGovernanceObject(nHash);
 
         if(pObj) {
+            hash_time_m_cit itComplete = mapVotesComplete.find(nHash);
+            if(pfrom->nVersion >= GOVERNANCE_VOTES_SINCE_PROTO_VERSION && itComplete != mapVotesComplete.end()) {
+                nVotesSince = itComplete->second - GOVERNANCE_VOTES_SINCE_MARGIN;
+            }
             filter = CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
             std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
             for(size_t i = 0; i < vecVotes.size(); ++i) {
+                if(vecVotes[i].GetTimestamp() < nVotesSince) continue;
                 filter.insert(vecVotes[i].GetHash());
             }
         }
     }
 
-    pfrom->PushMessage(NetMsgType::MNGOVERNANCESYNC, nHash, filter);
+    // these peers say when they answered, see SendSyncStatus()
+    if(pfrom->nVersion >= GOVERNANCE_VOTES_SINCE_PROTO_VERSION) {
+        LOCK(cs);
+        mapVoteRequests[pfrom->id][nHash] = vote_request_rec(nVotesSince <= 0);
+    }
+
+    if(nVotesSince > 0) {
+        pfrom->PushMessage(NetMsgType::MNGOVERNANCESYNC, nHash, filter, nVotesSince);
+    }
+    else {
+        pfrom->PushMessage(NetMsgType::MNGOVERNANCESYNC, nHash, filter);
+    }
 }
 
 int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode)
@@ -1162,6 +1435,8 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
             if(nProjectedSize > SETASKFOR_MAX_SZ/2) continue;
             // to early to ask the same node
             if(mapAskedRecently[nHashGovobj].count(pnode->addr)) continue;
+            // it would answer more requests with nothing, see MAX_SYNC_CURSORS_PER_PEER
+            if(pnode->nVersion >= GOVERNANCE_VOTES_SINCE_PROTO_VERSION && GetVoteRequestCount(pnode->id) >= MAX_SYNC_CURSORS_PER_PEER - 1) continue;
 
             RequestGovernanceObject(pnode, nHashGovobj, true);
             mapAskedRecently[nHashGovobj][pnode->addr] = nNow + nTimeout;
@@ -1212,9 +1487,10 @@ void CGovernanceManager::RebuildIndexes()
     mapVoteToObject.Clear();
     for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
         CGovernanceObject& govobj = it->second;
-        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-        for(size_t i = 0; i < vecVotes.size(); ++i) {
-            mapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
+        govobj.GetVoteFile().Recount(it->first);
+        std::vector<uint256> vecVoteHashes = govobj.GetVoteFile().GetVoteHashes();
+        for(size_t i = 0; i < vecVoteHashes.size(); ++i) {
+            mapVoteToObject.Insert(vecVoteHashes[i], &govobj);
         }
     }
 }
@@ -1262,6 +1538,17 @@ void CGovernanceManager::InitOnLoad()
     LOCK(cs);
     int64_t nStart = GetTimeMillis();
     LogPrintf("Preparing masternode indexes and governance triggers...\n");
+    if(pgovernancevotedb) {
+        // votes of objects that were deleted or never made it into governance.dat
+        std::set<uint256> setObjects;
+        for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+            setObjects.insert(setObjects.end(), it->first);
+        }
+        int nPruned = pgovernancevotedb->PruneObjects(setObjects);
+        if(nPruned > 0) {
+            LogPrintf("CGovernanceManager::InitOnLoad -- pruned %d votes of unknown objects\n", nPruned);
+        }
+    }
     RebuildIndexes();
     AddCachedTriggers();
     LogPrintf("Masternode indexes and governance triggers prepared  %dms\n", GetTimeMillis() - nStart);
@@ -1370,4 +1657,42 @@ void CGovernanceManager::CleanOrphanObjects()
             mapOrphanVotes.Erase(prevIt->key, prevIt->value);
         }
     }
+
+    object_time_m_it itObject = mapMasternodeOrphanObjects.begin();
+    while(itObject != mapMasternodeOrphanObjects.end()) {
+        if(itObject->second.second < nNow) {
+            txout_hash_m_it itIndex = mapMasternodeOrphanObjectIndex.find(itObject->second.first.vinMasternode.prevout);
+            if(itIndex != mapMasternodeOrphanObjectIndex.end()) {
+                itIndex->second.erase(itObject->first);
+                if(itIndex->second.empty()) {
+                    mapMasternodeOrphanObjectIndex.erase(itIndex);
+                }
+            }
+            mapMasternodeOrphanObjects.erase(itObject++);
+        }
+        else {
+            ++itObject;
+        }
+    }
+
+    txout_hash_m_it itIndex = mapMasternodeOrphanVoteIndex.begin();
+    while(itIndex != mapMasternodeOrphanVoteIndex.end()) {
+        std::set<uint256>& setHashes = itIndex->second;
+        std::set<uint256>::iterator itHash = setHashes.begin();
+        while(itHash != setHashes.end()) {
+            object_m_it it = mapObjects.find(*itHash);
+            if(it == mapObjects.end() || !it->second.RemoveExpiredOrphanVotes(itIndex->first)) {
+                setHashes.erase(itHash++);
+            }
+            else {
+                ++itHash;
+            }
+        }
+        if(setHashes.empty()) {
+            mapMasternodeOrphanVoteIndex.erase(itIndex++);
+        }
+        else {
+            ++itIndex;
+        }
+    }
 }
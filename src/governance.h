@@ -15,6 +15,7 @@
 #include "governance-exceptions.h"
 #include "governance-object.h"
 #include "governance-vote.h"
+#include "masternodeman.h"
 #include "net.h"
 #include "sync.h"
 #include "timedata.h"
@@ -171,6 +172,45 @@ public: // Types
         bool fStatusOK;
     };
 
+    /// How far a peer's govsync request has been answered
+    struct sync_cursor_rec {
+        sync_cursor_rec(const uint256& nPropIn = uint256(), const CBloomFilter& filterIn = CBloomFilter(), int64_t nVotesSinceIn = 0)
+            : nProp(nPropIn),
+              filter(filterIn),
+              nVotesSince(nVotesSinceIn),
+              nHashLast(),
+              nObjCount(0),
+              nVoteCount(0),
+              nTimeCreated(GetTime())
+        {}
+
+        /// Object whose votes were asked for, or 0 for all the objects
+        uint256 nProp;
+        CBloomFilter filter;
+        /// Only votes signed at or after this time are sent, 0 for all of them
+        int64_t nVotesSince;
+        /// Last object or vote hash that was looked at
+        uint256 nHashLast;
+        int nObjCount;
+        int nVoteCount;
+        int64_t nTimeCreated;
+    };
+
+    /// A request we sent a peer for the votes of one object
+    struct vote_request_rec {
+        vote_request_rec(bool fAllVotesIn = false)
+            : fAllVotes(fAllVotesIn),
+              fObjectSent(false),
+              nTimeRequested(GetTime())
+        {}
+
+        /// Asked for every vote rather than only the recent ones
+        bool fAllVotes;
+        /// The peer had the object, so its vote count is an answer
+        bool fObjectSent;
+        int64_t nTimeRequested;
+    };
+
 
     typedef std::map<uint256, CGovernanceObject> object_m_t;
 
@@ -204,6 +244,10 @@ public: // Types
 
     typedef txout_m_t::const_iterator txout_m_cit;
 
+    typedef std::map<COutPoint, std::set<uint256> > txout_hash_m_t;
+
+    typedef txout_hash_m_t::iterator txout_hash_m_it;
+
     typedef std::set<uint256> hash_s_t;
 
     typedef hash_s_t::iterator hash_s_it;
@@ -222,9 +266,39 @@ public: // Types
 
     typedef hash_time_m_t::const_iterator hash_time_m_cit;
 
+    typedef std::map<NodeId, std::list<sync_cursor_rec> > sync_cursor_m_t;
+
+    typedef sync_cursor_m_t::iterator sync_cursor_m_it;
+
+    typedef sync_cursor_m_t::const_iterator sync_cursor_m_cit;
+
+    typedef std::map<NodeId, std::map<uint256, vote_request_rec> > vote_request_m_t;
+
+    typedef vote_request_m_t::iterator vote_request_m_it;
+
 private:
     static const int MAX_CACHE_SIZE = 1000000;
 
+    /// Objects or votes looked at per SendMessages call when answering a govsync request
+    static const int SYNC_CHUNK_SIZE = 500;
+
+    /// Requests a peer can have waiting to be answered, later ones are answered with nothing.
+    /// We keep our own requests to a peer below this, leaving room for the object list.
+    static const size_t MAX_SYNC_CURSORS_PER_PEER = 4;
+
+    /// Requests not answered by then are dropped, e.g. because the peer went away
+    static const int64_t SYNC_CURSOR_TIMEOUT = 60 * 60;
+
+    static const size_t PENDING_MESSAGES_BATCH_SIZE = 256;
+
+    /// A governance object or vote waiting for its signature to be verified
+    struct pending_message_t
+    {
+        bool fVote;
+        CGovernanceObject govobj;
+        CGovernanceVote vote;
+    };
+
     static const std::string SERIALIZATION_VERSION_STRING;
 
     // Keep track of current block index
@@ -240,6 +314,12 @@ private:
 
     object_time_m_t mapMasternodeOrphanObjects;
 
+    /// Hashes of the objects in mapMasternodeOrphanObjects by the masternode they are waiting for
+    txout_hash_m_t mapMasternodeOrphanObjectIndex;
+
+    /// Hashes of the objects holding orphan votes by the masternode these votes are waiting for
+    txout_hash_m_t mapMasternodeOrphanVoteIndex;
+
     hash_time_m_t mapWatchdogObjects;
 
     uint256 nHashWatchdogCurrent;
@@ -260,6 +340,19 @@ private:
 
     bool fRateChecksEnabled;
 
+    sync_cursor_m_t mapSyncCursors;
+
+    /// Our requests for the votes of single objects not answered yet, by peer
+    vote_request_m_t mapVoteRequests;
+
+    /// When we last asked a peer for every vote of the object and it answered,
+    /// so we were offered all the votes signed before then
+    hash_time_m_t mapVotesComplete;
+
+    CPendingMessageQueue<CGovernanceManager, pending_message_t, PENDING_MESSAGES_BATCH_SIZE> pendingMessages;
+
+    friend class CPendingMessageQueue<CGovernanceManager, pending_message_t, PENDING_MESSAGES_BATCH_SIZE>;
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -282,15 +375,33 @@ public:
      */
     bool ConfirmInventoryRequest(const CInv& inv);
 
-    void Sync(CNode* node, const uint256& nProp, const CBloomFilter& filter);
+    /// Queue a peer's govsync request, it is answered a chunk at a time by SendSyncChunk()
+    void Sync(CNode* node, const uint256& nProp, const CBloomFilter& filter, int64_t nVotesSince = 0);
+
+    /// Answer the next chunk of the peer's oldest govsync request, called from SendMessages
+    void SendSyncChunk(CNode* pto);
+
+    /// A peer's count of the objects or votes it sent for our govsync request for nProp
+    void SyncStatusCount(CNode* pfrom, int nItemID, int nCount, const uint256& nProp);
+
+    /// Drop the unanswered govsync requests from and to the peer, called when it disconnects
+    void RemoveSyncRequests(NodeId nodeid);
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
     void DoMaintenance();
 
+    /// Queue an object from this peer to be processed with the next batch of objects and votes
+    void QueueObject(CNode* pfrom, const CGovernanceObject& govobj);
+    /// Queue a vote from this peer to be processed with the next batch of objects and votes
+    void QueueVote(CNode* pfrom, const CGovernanceVote& vote);
+    /// Process the queued objects and votes, verifying their signatures in parallel first
+    void ProcessPendingMessages();
+    /// Whether a batch of pending messages verified this signature already
+    bool IsSignatureVerified(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash);
+
     CGovernanceObject *FindGovernanceObject(const uint256& nHash);
 
-    std::vector<CGovernanceVote> GetMatchingVotes(const uint256& nParentHash);
     std::vector<CGovernanceVote> GetCurrentVotes(const uint256& nParentHash, const CTxIn& mnCollateralOutpointFilter);
     std::vector<CGovernanceObject*> GetAllNewerThan(int64_t nMoreThanTime);
 
@@ -318,7 +429,13 @@ public:
         mapVoteToObject.Clear();
         mapInvalidVotes.Clear();
         mapOrphanVotes.Clear();
+        mapMasternodeOrphanObjects.clear();
+        mapMasternodeOrphanObjectIndex.clear();
+        mapMasternodeOrphanVoteIndex.clear();
         mapLastMasternodeObject.clear();
+        mapSyncCursors.clear();
+        mapVoteRequests.clear();
+        mapVotesComplete.clear();
     }
 
     std::string ToString() const;
@@ -344,6 +461,7 @@ public:
         READWRITE(nHashWatchdogCurrent);
         READWRITE(nTimeWatchdogCurrent);
         READWRITE(mapLastMasternodeObject);
+        READWRITE(mapVotesComplete);
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
             return;
@@ -362,6 +480,13 @@ public:
         return nCachedBlockHeight;
     }
 
+    /// Time before which we were offered every vote of the object, 0 if we don't know of such a time
+    int64_t GetVotesCompleteTime(const uint256& nHash) const {
+        LOCK(cs);
+        hash_time_m_cit it = mapVotesComplete.find(nHash);
+        return it == mapVotesComplete.end() ? 0 : it->second;
+    }
+
     // Accessors for thread-safe access to maps
     bool HaveObjectForHash(uint256 nHash);
 
@@ -389,9 +514,32 @@ public:
         return fOK;
     }
 
-    void CheckMasternodeOrphanVotes();
+    /// Process the orphan votes of these newly added masternodes
+    void CheckMasternodeOrphanVotes(const std::vector<COutPoint>& vecOutpoints);
 
-    void CheckMasternodeOrphanObjects();
+    /// Process the orphan objects of these newly added masternodes
+    void CheckMasternodeOrphanObjects(const std::vector<COutPoint>& vecOutpoints);
+
+    /// Called by an object when it keeps a vote until the masternode shows up
+    void AddMasternodeOrphanVote(const COutPoint& outpointMasternode, const uint256& nHashObject)
+    {
+        LOCK(cs);
+        mapMasternodeOrphanVoteIndex[outpointMasternode].insert(nHashObject);
+    }
+
+    /// Number of masternodes that orphan objects are waiting for
+    int GetMasternodeOrphanObjectIndexSize() const
+    {
+        LOCK(cs);
+        return mapMasternodeOrphanObjectIndex.size();
+    }
+
+    /// Number of masternodes that orphan votes are waiting for
+    int GetMasternodeOrphanVoteIndexSize() const
+    {
+        LOCK(cs);
+        return mapMasternodeOrphanVoteIndex.size();
+    }
 
     bool AreRateChecksEnabled() const {
         LOCK(cs);
@@ -404,6 +552,11 @@ public:
     int RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy);
 
 private:
+    void AddPendingSignatures(const std::vector<pending_message_t>& vecMessages, CMasternodeSignatureBatch& batch);
+    void ProcessPendingMessage(CNode* pfrom, pending_message_t& message);
+    void ProcessObjectMessage(CNode* pfrom, CGovernanceObject& govobj);
+    void ProcessVoteMessage(CNode* pfrom, const CGovernanceVote& vote);
+
     void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, bool fUseFilter = false);
 
     void AddInvalidVote(const CGovernanceVote& vote)
@@ -443,6 +596,20 @@ private:
 
     void CleanOrphanObjects();
 
+    /// Send the counts that answer a govsync request
+    void SendSyncStatus(CNode* pto, const uint256& nProp, int nObjCount, int nVoteCount);
+
+    /// Our unanswered requests for the votes of single objects to the peer
+    size_t GetVoteRequestCount(NodeId nodeid);
+
+    /// Send a chunk of object inventory, returns true once every object was looked at
+    bool SyncObjectsChunk(CNode* pto, sync_cursor_rec& cursor);
+
+    /// Send a chunk of vote inventory of one object, returns true once every vote was looked at
+    bool SyncVotesChunk(CNode* pto, sync_cursor_rec& cursor);
+
+    void CleanSyncCursors();
+
 };
 
 #endif
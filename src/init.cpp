@@ -18,6 +18,7 @@
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/x11.h"
 #include "httpserver.h"
 #include "httprpc.h"
 #include "key.h"
@@ -49,10 +50,12 @@
 #include "dsnotificationinterface.h"
 #include "flat-database.h"
 #include "governance.h"
+#include "governance-votedb.h"
 #include "instantx.h"
 #ifdef ENABLE_WALLET
 #include "keepass.h"
 #endif
+#include "masternode-db.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
@@ -183,7 +186,6 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB *pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher *pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -226,12 +228,19 @@ void PrepareShutdown()
     StopNode();
 
     // STORE DATA CACHES INTO SERIALIZED DAT FILES
-    CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
-    flatdb1.Dump(mnodeman);
+    if (pmasternodedb) {
+        pmasternodedb->Write(mnodeman, true);
+        delete pmasternodedb;
+        pmasternodedb = NULL;
+    }
     CFlatDB<CMasternodePayments> flatdb2("mnpayments.dat", "magicMasternodePaymentsCache");
     flatdb2.Dump(mnpayments);
     CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
     flatdb3.Dump(governance);
+    if (pgovernancevotedb) {
+        delete pgovernancevotedb;
+        pgovernancevotedb = NULL;
+    }
     CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
     flatdb4.Dump(netfulfilledman);
 
@@ -410,6 +419,7 @@ std::string HelpMessage(HelpMessageMode mode)
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
+    strUsage += HelpMessageOpt("-trustblockindex", strprintf(_("Do not re-check the proof of work of stored block index entries up to the last checkpoint on startup (default: %u)"), DEFAULT_TRUST_BLOCK_INDEX));
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
 
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
@@ -546,7 +556,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", DEFAULT_LIMITFREERELAY));
         strUsage += HelpMessageOpt("-relaypriority", strprintf("Require high priority for relaying free or low-fee transactions (default: %u)", DEFAULT_RELAYPRIORITY));
-        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature and script execution caches to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"),
                                CURRENCY_UNIT, FormatMoney(DEFAULT_MIN_RELAY_TX_FEE)));
@@ -1029,6 +1039,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fTrustBlockIndex = GetBoolArg("-trustblockindex", DEFAULT_TRUST_BLOCK_INDEX);
 
     // mempool limits
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
@@ -1172,6 +1183,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
 
+    // Pick the fastest X11 implementation this CPU supports
+    std::string strX11Backend = X11AutoDetect();
+
     // Sanity check
     if (!InitSanityCheck())
         return InitError(_("Initialization sanity check failed. MonetaryUnit Core is shutting down."));
@@ -1213,13 +1227,17 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("Default data directory %s\n", GetDefaultDataDir().string());
     LogPrintf("Using data directory %s\n", strDataDir);
     LogPrintf("Using config file %s\n", GetConfigFile().string());
+    LogPrintf("Using the '%s' X11 implementation\n", strX11Backend);
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
     std::ostringstream strErrors;
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i=0; i<nScriptCheckThreads-1; i++)
+        for (int i=0; i<nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadCoinsPrefetch);
+            threadGroup.create_thread(&ThreadMasternodeSignatureCheck);
+        }
     }
 
     if (mapArgs.count("-sporkkey")) // spork priv key
@@ -1485,6 +1503,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
 
+                // Convert a chainstate written by an older version to per-output records.
+                if (!pcoinsdbview->Upgrade()) {
+                    strLoadError = _("Error upgrading chainstate database");
+                    break;
+                }
+                if (fRequestShutdown) {
+                    LogPrintf("Shutdown requested. Exiting.\n");
+                    return false;
+                }
+
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
                     //If we're reindexing in prune mode, wipe away unusable block files and all undo data files
@@ -1872,9 +1900,31 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE
 
     uiInterface.InitMessage(_("Loading masternode cache..."));
-    CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
-    if(!flatdb1.Load(mnodeman)) {
-        return InitError("Failed to load masternode cache from mncache.dat");
+    try {
+        pmasternodedb = new CMasternodeDB(nMasternodeDBCache << 20);
+        if(!pmasternodedb->IsCurrentFormat()) {
+            LogPrintf("Masternode cache is in another format, starting over\n");
+            delete pmasternodedb;
+            pmasternodedb = new CMasternodeDB(nMasternodeDBCache << 20, false, true);
+        }
+        bool fImport = pmasternodedb->IsEmpty() && boost::filesystem::exists(GetDataDir() / "mncache.dat");
+        if(!pmasternodedb->LoadMasternodes(mnodeman)) {
+            return InitError("Failed to load masternode cache from mncache/");
+        }
+        if(fImport) {
+            // carry the list over from mncache.dat, which is not written any more
+            CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
+            if(!flatdb1.Load(mnodeman)) {
+                return InitError("Failed to load masternode cache from mncache.dat");
+            }
+            if(pmasternodedb->Write(mnodeman, true)) {
+                boost::filesystem::remove(GetDataDir() / "mncache.dat");
+            }
+        } else {
+            mnodeman.CheckAndRemove();
+        }
+    } catch (const std::exception& e) {
+        return InitError(strprintf("Failed to open masternode cache: %s", e.what()));
     }
 
     if(mnodeman.size()) {
@@ -1885,6 +1935,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
 
         uiInterface.InitMessage(_("Loading governance cache..."));
+        try {
+            pgovernancevotedb = new CGovernanceVoteDB(nGovernanceVoteDBCache << 20);
+        } catch (const std::exception& e) {
+            return InitError(strprintf("Failed to open governance vote database: %s", e.what()));
+        }
         CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
         if(!flatdb3.Load(governance)) {
             return InitError("Failed to load governance cache from governance.dat");
@@ -1892,6 +1947,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         governance.InitOnLoad();
     } else {
         uiInterface.InitMessage(_("Masternode cache is empty, skipping payments and governance cache..."));
+        try {
+            // the votes on disk belong to the governance objects that are not loaded
+            pgovernancevotedb = new CGovernanceVoteDB(nGovernanceVoteDBCache << 20, false, true);
+        } catch (const std::exception& e) {
+            return InitError(strprintf("Failed to open governance vote database: %s", e.what()));
+        }
     }
 
     uiInterface.InitMessage(_("Loading fulfilled requests cache..."));
@@ -1911,9 +1972,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     masternodeSync.UpdatedBlockTip(chainActive.Tip());
     governance.UpdatedBlockTip(chainActive.Tip());
 
-    // ********************************************************* Step 11d: start mue-privatesend thread
+    // ********************************************************* Step 11d: schedule masternode and PrivateSend tasks
 
-    threadGroup.create_thread(boost::bind(&ThreadCheckDarkSendPool));
+    ScheduleDarkSendPoolTasks(scheduler);
 
     // ********************************************************* Step 12: start node
 
@@ -1004,16 +1004,30 @@ bool CTxLockVote::IsValid(CNode* pnode) const
 uint256 CTxLockVote::GetHash() const
 {
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << std::string(NetMsgType::TXLOCKVOTE);
     ss << txHash;
     ss << outpoint;
     ss << outpointMasternode;
     return ss.GetHash();
 }
 
+uint256 CTxLockVote::GetSignatureHash() const
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << txHash;
+    ss << outpoint;
+    ss << outpointMasternode;
+    return ss.GetHash();
+}
+
+std::string CTxLockVote::GetSignatureMessage() const
+{
+    return txHash.ToString() + outpoint.ToStringShort();
+}
+
 bool CTxLockVote::CheckSignature() const
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
 
     masternode_info_t infoMn = mnodeman.GetMasternodeInfo(CTxIn(outpointMasternode));
 
@@ -1022,8 +1036,8 @@ bool CTxLockVote::CheckSignature() const
         return false;
     }
 
-    if(!darkSendSigner.VerifyMessage(infoMn.pubKeyMasternode, vchMasternodeSignature, strMessage, strError)) {
-        LogPrintf("CTxLockVote::CheckSignature -- VerifyMessage() failed, error: %s\n", strError);
+    if(!darkSendSigner.Verify(*this, infoMn.pubKeyMasternode, vchMasternodeSignature, strError)) {
+        LogPrintf("CTxLockVote::CheckSignature -- Verify() failed, error: %s\n", strError);
         return false;
     }
 
@@ -1033,15 +1047,14 @@ bool CTxLockVote::CheckSignature() const
 bool CTxLockVote::Sign()
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
 
-    if(!darkSendSigner.SignMessage(strMessage, vchMasternodeSignature, activeMasternode.keyMasternode)) {
-        LogPrintf("CTxLockVote::Sign -- SignMessage() failed\n");
+    if(!darkSendSigner.Sign(*this, vchMasternodeSignature, activeMasternode.keyMasternode)) {
+        LogPrintf("CTxLockVote::Sign -- Sign() failed\n");
         return false;
     }
 
-    if(!darkSendSigner.VerifyMessage(activeMasternode.pubKeyMasternode, vchMasternodeSignature, strMessage, strError)) {
-        LogPrintf("CTxLockVote::Sign -- VerifyMessage() failed, error: %s\n", strError);
+    if(!darkSendSigner.Verify(*this, activeMasternode.pubKeyMasternode, vchMasternodeSignature, strError)) {
+        LogPrintf("CTxLockVote::Sign -- Verify() failed, error: %s\n", strError);
         return false;
     }
 
@@ -1051,7 +1064,7 @@ bool CTxLockVote::Sign()
 void CTxLockVote::Relay() const
 {
     CInv inv(MSG_TXLOCK_VOTE, GetHash());
-    RelayInv(inv);
+    RelayInv(inv, darkSendSigner.GetMinSignaturePeerVersion());
 }
 
 bool CTxLockVote::IsExpired(int nHeight) const
@@ -175,6 +175,8 @@ public:
     }
 
     uint256 GetHash() const;
+    uint256 GetSignatureHash() const;
+    std::string GetSignatureMessage() const;
 
     uint256 GetTxHash() const {
         return txHash;
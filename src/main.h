@@ -37,6 +37,7 @@ class CBlockTreeDB;
 class CBloomFilter;
 class CChainParams;
 class CInv;
+class CCoinsViewDB;
 class CScriptCheck;
 class CTxMemPool;
 class CValidationInterface;
@@ -116,6 +117,7 @@ static const bool DEFAULT_RELAYPRIORITY = true;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const unsigned int DEFAULT_BYTES_PER_SIGOP = 20;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+static const bool DEFAULT_TRUST_BLOCK_INDEX = false;
 static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
@@ -155,6 +157,8 @@ extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Skip the proof-of-work check of stored block index entries up to the last checkpoint when loading them */
+extern bool fTrustBlockIndex;
 extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern bool fAlerts;
@@ -235,6 +239,8 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the coins prefetch thread */
+void ThreadCoinsPrefetch();
 
 /** Try to detect Partition (network isolation) attacks against us */
 void PartitionCheck(bool (*initialDownloadCheck)(), CCriticalSection& cs, const CBlockIndex *const &bestHeader, int64_t nPowTargetSpacing);
@@ -717,6 +723,38 @@ public:
     }
 };
 
+/**
+ * Closure representing one read of a transaction's coins from a view that
+ * allows concurrent readers (the coins database), issued on the prefetch
+ * threads ahead of the ConnectBlock lookup that needs it, so that lookup is
+ * served from the database and OS caches. The coins read are dropped, so
+ * nothing prefetched can ever go stale.
+ */
+class CCoinsPrefetch
+{
+private:
+    CCoinsView* pbase;
+    uint256 txid;
+
+public:
+    CCoinsPrefetch(): pbase(NULL) {}
+    CCoinsPrefetch(CCoinsView* pbaseIn, const uint256& txidIn) : pbase(pbaseIn), txid(txidIn) { }
+
+    bool operator()();
+
+    void swap(CCoinsPrefetch &check) {
+        std::swap(pbase, check.pbase);
+        std::swap(txid, check.txid);
+    }
+};
+
+/**
+ * Append a CCoinsPrefetch from pbase for every transaction whose outputs block
+ * spends, skipping those created by the block itself and those that cache
+ * already holds.
+ */
+void GetBlockInputPrefetches(const CBlock& block, const CCoinsViewCache& cache, CCoinsView* pbase, std::vector<CCoinsPrefetch>& vPrefetch);
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, int type,
@@ -747,6 +785,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
+/** Same as above, for a header whose hash the caller has already computed */
+bool CheckBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, bool fCheckPOW = true);
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
 
 /** Context-dependent validity checks */
@@ -834,6 +874,9 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Global variable that points to the coins database underneath pcoinsTip */
+extern CCoinsViewDB *pcoinsdbview;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
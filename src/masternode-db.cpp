@@ -0,0 +1,258 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-db.h"
+
+#include "clientversion.h"
+#include "hash.h"
+#include "masternodeman.h"
+#include "util.h"
+
+#include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+static const char DB_VERSION = 'V';
+static const char DB_STATE = 's';
+static const char DB_MASTERNODE = 'm';
+static const char DB_SEEN_BROADCAST = 'b';
+static const char DB_SEEN_PING = 'p';
+
+/** Seen messages loaded per lock of CMasternodeMan::cs */
+static const size_t SEEN_MESSAGES_LOAD_CHUNK = 1000;
+
+CMasternodeDB* pmasternodedb = NULL;
+
+CMasternodeDB::CMasternodeDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(GetDataDir() / "mncache", nCacheSize, fMemory, fWipe),
+    fSeenMessagesLoaded(false)
+{
+}
+
+bool CMasternodeDB::IsCurrentFormat()
+{
+    std::string strVersion;
+    return !Read(DB_VERSION, strVersion) || strVersion == CMasternodeMan::SERIALIZATION_VERSION_STRING;
+}
+
+bool CMasternodeDB::LoadMasternodes(CMasternodeMan& mnodemanIn)
+{
+    LOCK2(cs, mnodemanIn.cs);
+
+    int64_t nStart = GetTimeMillis();
+
+    if(IsEmpty()) {
+        // nothing stored yet
+        fSeenMessagesLoaded = true;
+        return true;
+    }
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    std::pair<char, COutPoint> key;
+    pcursor->Seek(std::make_pair(DB_MASTERNODE, COutPoint()));
+    while(pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if(!pcursor->GetKey(key) || key.first != DB_MASTERNODE) break;
+        CMasternode mn;
+        if(!pcursor->GetValue(mn)) {
+            return error("CMasternodeDB::LoadMasternodes -- failed to read masternode %s", key.second.ToStringShort());
+        }
+        mnodemanIn.mapMasternodes.Add(mn);
+        pcursor->Next();
+    }
+
+    std::vector<unsigned char> vchState;
+    if(Read(DB_STATE, vchState)) {
+        try {
+            CDataStream ssState(vchState, SER_DISK, CLIENT_VERSION);
+            ssState >> mnodemanIn.mAskedUsForMasternodeList;
+            ssState >> mnodemanIn.mWeAskedForMasternodeList;
+            ssState >> mnodemanIn.mWeAskedForMasternodeListEntry;
+            ssState >> mnodemanIn.mMnbRecoveryRequests;
+            ssState >> mnodemanIn.mMnbRecoveryGoodReplies;
+            ssState >> mnodemanIn.nLastWatchdogVoteTime;
+            ssState >> mnodemanIn.nDsqCount;
+            ssState >> mnodemanIn.indexMasternodes;
+            ssState >> mnodemanIn.hashSnapshotSynced;
+        } catch (const std::exception& e) {
+            return error("CMasternodeDB::LoadMasternodes -- failed to read the manager state: %s", e.what());
+        }
+        hashWrittenState = Hash(vchState.begin(), vchState.end());
+    }
+
+    mnodemanIn.NotifyMasternodeStateChanged();
+
+    LogPrintf("CMasternodeDB::LoadMasternodes -- loaded %d masternodes  %dms\n", (int)mnodemanIn.mapMasternodes.size(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CMasternodeDB::LoadSeenMessages(CMasternodeMan& mnodemanIn)
+{
+    {
+        LOCK(cs);
+        if(fSeenMessagesLoaded) return true;
+    }
+
+    int64_t nStart = GetTimeMillis();
+    int nBroadcasts = 0;
+    int nPings = 0;
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // Writes wait for this, so the records are not going anywhere meanwhile
+    std::vector<std::pair<uint256, std::pair<int64_t, CMasternodeBroadcast> > > vecBroadcasts;
+    std::pair<char, uint256> key;
+    pcursor->Seek(std::make_pair(DB_SEEN_BROADCAST, uint256()));
+    while(true) {
+        boost::this_thread::interruption_point();
+        bool fValid = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_SEEN_BROADCAST;
+        if(fValid) {
+            std::pair<int64_t, CMasternodeBroadcast> value;
+            if(!pcursor->GetValue(value)) {
+                return error("CMasternodeDB::LoadSeenMessages -- failed to read broadcast %s", key.second.ToString());
+            }
+            vecBroadcasts.push_back(std::make_pair(key.second, value));
+            pcursor->Next();
+        }
+        if(vecBroadcasts.size() >= SEEN_MESSAGES_LOAD_CHUNK || (!fValid && !vecBroadcasts.empty())) {
+            LOCK2(cs, mnodemanIn.cs);
+            for(size_t i = 0; i < vecBroadcasts.size(); i++) {
+                // whatever was seen since startup is newer
+                mnodemanIn.mapSeenMasternodeBroadcast.insert(vecBroadcasts[i]);
+            }
+            nBroadcasts += vecBroadcasts.size();
+            vecBroadcasts.clear();
+        }
+        if(!fValid) break;
+    }
+
+    std::vector<CMasternodePing> vecPings;
+    pcursor->Seek(std::make_pair(DB_SEEN_PING, uint256()));
+    while(true) {
+        boost::this_thread::interruption_point();
+        bool fValid = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_SEEN_PING;
+        if(fValid) {
+            CMasternodePing mnp;
+            if(!pcursor->GetValue(mnp)) {
+                return error("CMasternodeDB::LoadSeenMessages -- failed to read ping %s", key.second.ToString());
+            }
+            vecPings.push_back(mnp);
+            pcursor->Next();
+        }
+        if(vecPings.size() >= SEEN_MESSAGES_LOAD_CHUNK || (!fValid && !vecPings.empty())) {
+            LOCK2(cs, mnodemanIn.cs);
+            for(size_t i = 0; i < vecPings.size(); i++) {
+                uint256 hash = vecPings[i].GetHash();
+                if(mnodemanIn.mapSeenMasternodePing.count(hash)) continue;
+                mnodemanIn.AddSeenPing(vecPings[i]);
+                // it is on disk already
+                LOCK(mnodemanIn.cs_dirty);
+                mnodemanIn.setDirtyPings.erase(hash);
+            }
+            nPings += vecPings.size();
+            vecPings.clear();
+        }
+        if(!fValid) break;
+    }
+
+    LOCK(cs);
+    fSeenMessagesLoaded = true;
+
+    LogPrintf("CMasternodeDB::LoadSeenMessages -- loaded %d broadcasts and %d pings  %dms\n", nBroadcasts, nPings, GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CMasternodeDB::Write(CMasternodeMan& mnodemanIn, bool fSync)
+{
+    LOCK(cs);
+
+    int64_t nStart = GetTimeMillis();
+    int nWritten = 0;
+    int nErased = 0;
+
+    CDBBatch batch(&GetObfuscateKey());
+    std::set<COutPoint> setMasternodes;
+    std::set<uint256> setBroadcasts;
+    std::set<uint256> setPings;
+    uint256 hashState;
+    {
+        LOCK(mnodemanIn.cs);
+
+        {
+            LOCK(mnodemanIn.cs_dirty);
+            setMasternodes.swap(mnodemanIn.setDirtyMasternodes);
+            // the seen messages on disk that are not loaded yet would be overwritten by older ones or not erased
+            if(fSeenMessagesLoaded) {
+                setBroadcasts.swap(mnodemanIn.setDirtyBroadcasts);
+                setPings.swap(mnodemanIn.setDirtyPings);
+            }
+        }
+
+        batch.Write(DB_VERSION, CMasternodeMan::SERIALIZATION_VERSION_STRING);
+
+        for(std::set<COutPoint>::const_iterator it = setMasternodes.begin(); it != setMasternodes.end(); ++it) {
+            CMasternode* pmn = mnodemanIn.mapMasternodes.Find(*it);
+            if(pmn) {
+                batch.Write(std::make_pair(DB_MASTERNODE, *it), *pmn);
+                nWritten++;
+            } else {
+                batch.Erase(std::make_pair(DB_MASTERNODE, *it));
+                nErased++;
+            }
+        }
+
+        for(std::set<uint256>::const_iterator it = setBroadcasts.begin(); it != setBroadcasts.end(); ++it) {
+            std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> >::const_iterator itMnb = mnodemanIn.mapSeenMasternodeBroadcast.find(*it);
+            if(itMnb != mnodemanIn.mapSeenMasternodeBroadcast.end()) {
+                batch.Write(std::make_pair(DB_SEEN_BROADCAST, *it), itMnb->second);
+                nWritten++;
+            } else {
+                batch.Erase(std::make_pair(DB_SEEN_BROADCAST, *it));
+                nErased++;
+            }
+        }
+
+        for(std::set<uint256>::const_iterator it = setPings.begin(); it != setPings.end(); ++it) {
+            std::map<uint256, CMasternodePing>::const_iterator itMnp = mnodemanIn.mapSeenMasternodePing.find(*it);
+            if(itMnp != mnodemanIn.mapSeenMasternodePing.end()) {
+                batch.Write(std::make_pair(DB_SEEN_PING, *it), itMnp->second);
+                nWritten++;
+            } else {
+                batch.Erase(std::make_pair(DB_SEEN_PING, *it));
+                nErased++;
+            }
+        }
+
+        CDataStream ssState(SER_DISK, CLIENT_VERSION);
+        ssState << mnodemanIn.mAskedUsForMasternodeList;
+        ssState << mnodemanIn.mWeAskedForMasternodeList;
+        ssState << mnodemanIn.mWeAskedForMasternodeListEntry;
+        ssState << mnodemanIn.mMnbRecoveryRequests;
+        ssState << mnodemanIn.mMnbRecoveryGoodReplies;
+        ssState << mnodemanIn.nLastWatchdogVoteTime;
+        ssState << mnodemanIn.nDsqCount;
+        ssState << mnodemanIn.indexMasternodes;
+        ssState << mnodemanIn.hashSnapshotSynced;
+        hashState = Hash(ssState.begin(), ssState.end());
+        if(hashState != hashWrittenState) {
+            batch.Write(DB_STATE, std::vector<unsigned char>(ssState.begin(), ssState.end()));
+            nWritten++;
+        }
+    }
+
+    if(!WriteBatch(batch, fSync)) {
+        // try again next time
+        LOCK(mnodemanIn.cs_dirty);
+        mnodemanIn.setDirtyMasternodes.insert(setMasternodes.begin(), setMasternodes.end());
+        mnodemanIn.setDirtyBroadcasts.insert(setBroadcasts.begin(), setBroadcasts.end());
+        mnodemanIn.setDirtyPings.insert(setPings.begin(), setPings.end());
+        return error("CMasternodeDB::Write -- failed to write %d records", nWritten + nErased);
+    }
+
+    hashWrittenState = hashState;
+
+    LogPrint("masternode", "CMasternodeDB::Write -- wrote %d and erased %d records  %dms\n", nWritten, nErased, GetTimeMillis() - nStart);
+    return true;
+}
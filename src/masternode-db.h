@@ -0,0 +1,57 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODE_DB_H
+#define MASTERNODE_DB_H
+
+#include "dbwrapper.h"
+#include "sync.h"
+#include "uint256.h"
+
+class CMasternodeMan;
+
+class CMasternodeDB;
+
+extern CMasternodeDB* pmasternodedb;
+
+//! cache size of the masternode database (MiB)
+static const int64_t nMasternodeDBCache = 2;
+
+/**
+ * Access to the masternode database (mncache/), which replaced mncache.dat.
+ *
+ * Every masternode, seen broadcast and seen ping is its own record, and the
+ * rest of CMasternodeMan is one more. Write() only touches the records
+ * CMasternodeMan flagged as dirty since the last write, so periodic writes
+ * stay cheap. Startup only has to read the masternodes; the seen messages are
+ * loaded later by LoadSeenMessages().
+ */
+class CMasternodeDB : public CDBWrapper
+{
+private:
+    CCriticalSection cs;
+
+    // hash of the manager state record, which is small enough to compare in full
+    uint256 hashWrittenState;
+
+    // the seen messages on disk are not all in memory until they are loaded, so can't be written before that
+    bool fSeenMessagesLoaded;
+
+    CMasternodeDB(const CMasternodeDB&);
+    void operator=(const CMasternodeDB&);
+
+public:
+    CMasternodeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /// Whether the records are empty or in the format of this version, rather than one they can't be read in
+    bool IsCurrentFormat();
+    /// Load the masternodes and the manager state
+    bool LoadMasternodes(CMasternodeMan& mnodemanIn);
+    /// Load the seen broadcasts and pings, a chunk at a time so that message processing can go on meanwhile
+    bool LoadSeenMessages(CMasternodeMan& mnodemanIn);
+    /// Write or erase the records of what was flagged as dirty since the last Write()
+    bool Write(CMasternodeMan& mnodemanIn, bool fSync = false);
+};
+
+#endif
@@ -241,6 +241,16 @@ void CMasternodePayments::Clear()
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
     mapMasternodeBlocks.clear();
     mapMasternodePaymentVotes.clear();
+    queueVoteExpiry.clear();
+}
+
+void CMasternodePayments::RebuildVoteExpiry()
+{
+    LOCK(cs_mapMasternodePaymentVotes);
+    queueVoteExpiry.clear();
+    for(std::map<uint256, CMasternodePaymentVote>::const_iterator it = mapMasternodePaymentVotes.begin(); it != mapMasternodePaymentVotes.end(); ++it) {
+        queueVoteExpiry.push(it->first, it->second.nBlockHeight);
+    }
 }
 
 bool CMasternodePayments::CanVote(COutPoint outMasternode, int nBlockHeight)
@@ -354,6 +364,7 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand,
 
             // Avoid processing same vote multiple times
             mapMasternodePaymentVotes[nHash] = vote;
+            queueVoteExpiry.push(nHash, vote.nBlockHeight);
             // but first mark vote as non-verified,
             // AddPaymentVote() below should take care of it if vote is actually ok
             mapMasternodePaymentVotes[nHash].MarkAsNotVerified();
@@ -415,20 +426,34 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand,
     }
 }
 
+uint256 CMasternodePaymentVote::GetSignatureHash() const
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << std::string(NetMsgType::MASTERNODEPAYMENTVOTE);
+    ss << vinMasternode.prevout;
+    ss << nBlockHeight;
+    ss << *(CScriptBase*)(&payee);
+    return ss.GetHash();
+}
+
+std::string CMasternodePaymentVote::GetSignatureMessage() const
+{
+    return vinMasternode.prevout.ToStringShort() +
+           boost::lexical_cast<std::string>(nBlockHeight) +
+           ScriptToAsmStr(payee);
+}
+
 bool CMasternodePaymentVote::Sign()
 {
     std::string strError;
-    std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                             boost::lexical_cast<std::string>(nBlockHeight) +
-                             ScriptToAsmStr(payee);
 
-    if(!darkSendSigner.SignMessage(strMessage, vchSig, activeMasternode.keyMasternode)) {
-        LogPrintf("CMasternodePaymentVote::Sign -- SignMessage() failed\n");
+    if(!darkSendSigner.Sign(*this, vchSig, activeMasternode.keyMasternode)) {
+        LogPrintf("CMasternodePaymentVote::Sign -- Sign() failed\n");
         return false;
     }
 
-    if(!darkSendSigner.VerifyMessage(activeMasternode.pubKeyMasternode, vchSig, strMessage, strError)) {
-        LogPrintf("CMasternodePaymentVote::Sign -- VerifyMessage() failed, error: %s\n", strError);
+    if(!darkSendSigner.Verify(*this, activeMasternode.pubKeyMasternode, vchSig, strError)) {
+        LogPrintf("CMasternodePaymentVote::Sign -- Verify() failed, error: %s\n", strError);
         return false;
     }
 
@@ -475,7 +500,11 @@ bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
 
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
 
-    mapMasternodePaymentVotes[vote.GetHash()] = vote;
+    uint256 nHash = vote.GetHash();
+    if(!mapMasternodePaymentVotes.count(nHash)) {
+        queueVoteExpiry.push(nHash, vote.nBlockHeight);
+    }
+    mapMasternodePaymentVotes[nHash] = vote;
 
     if(!mapMasternodeBlocks.count(vote.nBlockHeight)) {
         CMasternodeBlockPayees blockPayees(vote.nBlockHeight);
@@ -639,17 +668,15 @@ void CMasternodePayments::CheckAndRemove()
 
     int nLimit = GetStorageLimit();
 
-    std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.begin();
-    while(it != mapMasternodePaymentVotes.end()) {
-        CMasternodePaymentVote vote = (*it).second;
-
-        if(pCurrentBlockIndex->nHeight - vote.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CMasternodePayments::CheckAndRemove -- Removing old Masternode payment: nBlockHeight=%d\n", vote.nBlockHeight);
-            mapMasternodePaymentVotes.erase(it++);
-            mapMasternodeBlocks.erase(vote.nBlockHeight);
-        } else {
-            ++it;
-        }
+    // votes come out lowest block first, only the old ones are looked at
+    uint256 nHash;
+    while(queueVoteExpiry.pop_expired(pCurrentBlockIndex->nHeight - nLimit, nHash)) {
+        std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.find(nHash);
+        if(it == mapMasternodePaymentVotes.end()) continue;
+        int nBlockHeight = it->second.nBlockHeight;
+        LogPrint("mnpayments", "CMasternodePayments::CheckAndRemove -- Removing old Masternode payment: nBlockHeight=%d\n", nBlockHeight);
+        mapMasternodePaymentVotes.erase(it);
+        mapMasternodeBlocks.erase(nBlockHeight);
     }
     LogPrintf("CMasternodePayments::CheckAndRemove -- %s\n", ToString());
 }
@@ -781,7 +808,7 @@ void CMasternodePaymentVote::Relay()
     // do not relay until synced
     if (!masternodeSync.IsWinnersListSynced()) return;
     CInv inv(MSG_MASTERNODE_PAYMENT_VOTE, GetHash());
-    RelayInv(inv);
+    RelayInv(inv, darkSendSigner.GetMinSignaturePeerVersion());
 }
 
 bool CMasternodePaymentVote::CheckSignature(const CPubKey& pubKeyMasternode, int nValidationHeight, int &nDos)
@@ -789,12 +816,8 @@ bool CMasternodePaymentVote::CheckSignature(const CPubKey& pubKeyMasternode, int
     // do not ban by default
     nDos = 0;
 
-    std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                             boost::lexical_cast<std::string>(nBlockHeight) +
-                             ScriptToAsmStr(payee);
-
     std::string strError = "";
-    if (!darkSendSigner.VerifyMessage(pubKeyMasternode, vchSig, strMessage, strError)) {
+    if (!darkSendSigner.Verify(*this, pubKeyMasternode, vchSig, strError)) {
         // Only ban for future block vote when we are already synced.
         // Otherwise it could be the case when MN which signed this vote is using another key now
         // and we have no idea about the old one.
@@ -826,6 +849,9 @@ void CMasternodePayments::Sync(CNode* pnode)
 
     if(!pCurrentBlockIndex) return;
 
+    // older peers can't verify votes signed over digests
+    if(pnode->nVersion < darkSendSigner.GetMinSignaturePeerVersion()) return;
+
     int nInvCount = 0;
 
     for(int h = pCurrentBlockIndex->nHeight; h < pCurrentBlockIndex->nHeight + 20; h++) {
@@ -8,6 +8,7 @@
 
 #include "util.h"
 #include "core_io.h"
+#include "expiryqueue.h"
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
@@ -156,6 +157,9 @@ public:
         return ss.GetHash();
     }
 
+    uint256 GetSignatureHash() const;
+    std::string GetSignatureMessage() const;
+
     bool Sign();
     bool CheckSignature(const CPubKey& pubKeyMasternode, int nValidationHeight, int &nDos);
 
@@ -188,6 +192,11 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
+    // mapMasternodePaymentVotes by block height, to remove them in order once they're too old
+    expiryqueue<uint256> queueVoteExpiry;
+
+    void RebuildVoteExpiry();
+
 public:
     std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -201,6 +210,9 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
         READWRITE(mapMasternodePaymentVotes);
         READWRITE(mapMasternodeBlocks);
+        if(ser_action.ForRead()) {
+            RebuildVoteExpiry();
+        }
     }
 
     void Clear();
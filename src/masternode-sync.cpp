@@ -237,13 +237,20 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
 {
     if (strCommand == NetMsgType::SYNCSTATUSCOUNT) { //Sync status count
 
-        //do not care about stats if sync process finished or failed
-        if(IsSynced() || IsFailed()) return;
-
         int nItemID;
         int nCount;
         vRecv >> nItemID >> nCount;
 
+        // counts answering a request for the votes of one object say which object
+        if(!vRecv.empty()) {
+            uint256 nProp;
+            vRecv >> nProp;
+            governance.SyncStatusCount(pfrom, nItemID, nCount, nProp);
+        }
+
+        //do not care about stats if sync process finished or failed
+        if(IsSynced() || IsFailed()) return;
+
         LogPrintf("SYNCSTATUSCOUNT -- got inventory count: nItemID=%d  nCount=%d  peer=%d\n", nItemID, nCount, pfrom->id);
     }
 }
@@ -265,8 +272,9 @@ void CMasternodeSync::ClearFulfilledRequests()
 
 void CMasternodeSync::ProcessTick()
 {
+    // runs every MASTERNODE_SYNC_TICK_SECONDS
     static int nTick = 0;
-    if(nTick++ % MASTERNODE_SYNC_TICK_SECONDS != 0) return;
+    nTick++;
     if(!pCurrentBlockIndex) return;
 
     //the actual count of masternodes we have currently
@@ -112,6 +112,8 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb)
 {
     if(mnb.sigTime <= sigTime && !mnb.fRecovery) return false;
 
+    CPubKey pubKeyMasternodeOld = pubKeyMasternode;
+    CService addrOld = addr;
     pubKeyMasternode = mnb.pubKeyMasternode;
     sigTime = mnb.sigTime;
     vchSig = mnb.vchSig;
@@ -120,10 +122,15 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb)
     nPoSeBanScore = 0;
     nPoSeBanHeight = 0;
     nTimeLastChecked = 0;
+    mnodeman.NotifyMasternodeStateChanged();
+    mnodeman.FlagMasternodeAsDirty(vin.prevout);
+    if(pubKeyMasternode != pubKeyMasternodeOld || addr != addrOld) {
+        mnodeman.ReindexMasternode(this, pubKeyMasternodeOld, addrOld);
+    }
     int nDos = 0;
     if(mnb.lastPing == CMasternodePing() || (mnb.lastPing != CMasternodePing() && mnb.lastPing.CheckAndUpdate(this, true, nDos))) {
         lastPing = mnb.lastPing;
-        mnodeman.mapSeenMasternodePing.insert(std::make_pair(lastPing.GetHash(), lastPing));
+        mnodeman.AddSeenPing(lastPing);
     }
     // if it matches our Masternode privkey...
     if(fMasterNode && pubKeyMasternode == activeMasternode.pubKeyMasternode) {
@@ -148,24 +155,45 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb)
 //
 arith_uint256 CMasternode::CalculateScore(const uint256& blockHash)
 {
-    uint256 aux = ArithToUint256(UintToArith256(vin.prevout.hash) + vin.prevout.n);
+    return CMasternodeScorer(blockHash).GetScore(vin.prevout);
+}
+
+CMasternodeScorer::CMasternodeScorer(const uint256& blockHash)
+{
+    uint256 hash;
+    hasherBlockHash.Write(blockHash.begin(), blockHash.size());
+    CHash256(hasherBlockHash).Finalize(hash.begin());
+    hashBlockHash = UintToArith256(hash);
+}
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    ss << blockHash;
-    arith_uint256 hash2 = UintToArith256(ss.GetHash());
+arith_uint256 CMasternodeScorer::GetScore(const COutPoint& outpoint) const
+{
+    uint256 aux = ArithToUint256(UintToArith256(outpoint.hash) + outpoint.n);
 
-    CHashWriter ss2(SER_GETHASH, PROTOCOL_VERSION);
-    ss2 << blockHash;
-    ss2 << aux;
-    arith_uint256 hash3 = UintToArith256(ss2.GetHash());
+    uint256 hash;
+    CHash256(hasherBlockHash).Write(aux.begin(), aux.size()).Finalize(hash.begin());
+    arith_uint256 hash3 = UintToArith256(hash);
 
-    return (hash3 > hash2 ? hash3 - hash2 : hash2 - hash3);
+    return (hash3 > hashBlockHash ? hash3 - hashBlockHash : hashBlockHash - hash3);
 }
 
 void CMasternode::Check(bool fForce)
 {
     LOCK(cs);
 
+    int nActiveStateOld = nActiveState;
+    UpdateActiveState(fForce);
+    if(nActiveState != nActiveStateOld) {
+        // which masternodes are ranked depends on their state
+        mnodeman.NotifyMasternodeStateChanged();
+        mnodeman.FlagMasternodeAsDirty(vin.prevout);
+    }
+}
+
+void CMasternode::UpdateActiveState(bool fForce)
+{
+    AssertLockHeld(cs);
+
     if(ShutdownRequested()) return;
 
     if(!fForce && (GetTime() - nTimeLastChecked < MASTERNODE_CHECK_SECONDS)) return;
@@ -296,7 +324,7 @@ bool CMasternode::IsValidNetAddr(CService addrIn)
            (addrIn.IsIPv4() && IsReachable(addrIn) && addrIn.IsRoutable());
 }
 
-masternode_info_t CMasternode::GetInfo()
+masternode_info_t CMasternode::GetInfo() const
 {
     masternode_info_t info;
     info.vin = vin;
@@ -627,6 +655,7 @@ bool CMasternodeBroadcast::CheckOutpoint(int& nDos)
             // not mnb fault, let it to be checked again later
             LogPrint("masternode", "CMasternodeBroadcast::CheckOutpoint -- Failed to aquire lock, addr=%s", addr.ToString());
             mnodeman.mapSeenMasternodeBroadcast.erase(GetHash());
+            mnodeman.FlagBroadcastAsDirty(GetHash());
             return false;
         }
 
@@ -646,6 +675,7 @@ bool CMasternodeBroadcast::CheckOutpoint(int& nDos)
                       Params().GetConsensus().nMasternodeMinimumConfirmations, vin.prevout.ToStringShort());
             // maybe we miss few blocks, let this mnb to be checked again later
             mnodeman.mapSeenMasternodeBroadcast.erase(GetHash());
+            mnodeman.FlagBroadcastAsDirty(GetHash());
             return false;
         }
     }
@@ -682,24 +712,26 @@ bool CMasternodeBroadcast::CheckOutpoint(int& nDos)
     return true;
 }
 
+std::string CMasternodeBroadcast::GetSignatureMessage() const
+{
+    return addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
+           pubKeyCollateralAddress.GetID().ToString() + pubKeyMasternode.GetID().ToString() +
+           boost::lexical_cast<std::string>(nProtocolVersion);
+}
+
 bool CMasternodeBroadcast::Sign(CKey& keyCollateralAddress)
 {
     std::string strError;
-    std::string strMessage;
 
     sigTime = GetAdjustedTime();
 
-    strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
-                 pubKeyCollateralAddress.GetID().ToString() + pubKeyMasternode.GetID().ToString() +
-                 boost::lexical_cast<std::string>(nProtocolVersion);
-
-    if(!darkSendSigner.SignMessage(strMessage, vchSig, keyCollateralAddress)) {
-        LogPrintf("CMasternodeBroadcast::Sign -- SignMessage() failed\n");
+    if(!darkSendSigner.Sign(*this, vchSig, keyCollateralAddress)) {
+        LogPrintf("CMasternodeBroadcast::Sign -- Sign() failed\n");
         return false;
     }
 
-    if(!darkSendSigner.VerifyMessage(pubKeyCollateralAddress, vchSig, strMessage, strError)) {
-        LogPrintf("CMasternodeBroadcast::Sign -- VerifyMessage() failed, error: %s\n", strError);
+    if(!darkSendSigner.Verify(*this, pubKeyCollateralAddress, vchSig, strError)) {
+        LogPrintf("CMasternodeBroadcast::Sign -- Verify() failed, error: %s\n", strError);
         return false;
     }
 
@@ -708,17 +740,13 @@ bool CMasternodeBroadcast::Sign(CKey& keyCollateralAddress)
 
 bool CMasternodeBroadcast::CheckSignature(int& nDos)
 {
-    std::string strMessage;
     std::string strError = "";
     nDos = 0;
 
-    strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
-                 pubKeyCollateralAddress.GetID().ToString() + pubKeyMasternode.GetID().ToString() +
-                 boost::lexical_cast<std::string>(nProtocolVersion);
+    LogPrint("masternode", "CMasternodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", GetSignatureMessage(), CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
 
-    LogPrint("masternode", "CMasternodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
-
-    if(!darkSendSigner.VerifyMessage(pubKeyCollateralAddress, vchSig, strMessage, strError)) {
+    if(!mnodeman.IsSignatureVerified(pubKeyCollateralAddress, vchSig, darkSendSigner.GetSignedHash(*this)) &&
+       !darkSendSigner.Verify(*this, pubKeyCollateralAddress, vchSig, strError)) {
         LogPrintf("CMasternodeBroadcast::CheckSignature -- Got bad Masternode announce signature, error: %s\n", strError);
         nDos = 100;
         return false;
@@ -730,7 +758,7 @@ bool CMasternodeBroadcast::CheckSignature(int& nDos)
 void CMasternodeBroadcast::Relay()
 {
     CInv inv(MSG_MASTERNODE_ANNOUNCE, GetHash());
-    RelayInv(inv);
+    RelayInv(inv, darkSendSigner.GetMinSignaturePeerVersion());
 }
 
 CMasternodePing::CMasternodePing(CTxIn& vinNew)
@@ -744,21 +772,24 @@ CMasternodePing::CMasternodePing(CTxIn& vinNew)
     vchSig = std::vector<unsigned char>();
 }
 
+std::string CMasternodePing::GetSignatureMessage() const
+{
+    return vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+}
+
 bool CMasternodePing::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
 {
     std::string strError;
-    std::string strMasterNodeSignMessage;
 
     sigTime = GetAdjustedTime();
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
 
-    if(!darkSendSigner.SignMessage(strMessage, vchSig, keyMasternode)) {
-        LogPrintf("CMasternodePing::Sign -- SignMessage() failed\n");
+    if(!darkSendSigner.Sign(*this, vchSig, keyMasternode)) {
+        LogPrintf("CMasternodePing::Sign -- Sign() failed\n");
         return false;
     }
 
-    if(!darkSendSigner.VerifyMessage(pubKeyMasternode, vchSig, strMessage, strError)) {
-        LogPrintf("CMasternodePing::Sign -- VerifyMessage() failed, error: %s\n", strError);
+    if(!darkSendSigner.Verify(*this, pubKeyMasternode, vchSig, strError)) {
+        LogPrintf("CMasternodePing::Sign -- Verify() failed, error: %s\n", strError);
         return false;
     }
 
@@ -767,11 +798,11 @@ bool CMasternodePing::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
 
 bool CMasternodePing::CheckSignature(CPubKey& pubKeyMasternode, int &nDos)
 {
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
     std::string strError = "";
     nDos = 0;
 
-    if(!darkSendSigner.VerifyMessage(pubKeyMasternode, vchSig, strMessage, strError)) {
+    if(!mnodeman.IsSignatureVerified(pubKeyMasternode, vchSig, darkSendSigner.GetSignedHash(*this)) &&
+       !darkSendSigner.Verify(*this, pubKeyMasternode, vchSig, strError)) {
         LogPrintf("CMasternodePing::CheckSignature -- Got bad Masternode ping signature, masternode=%s, error: %s\n", vin.prevout.ToStringShort(), strError);
         nDos = 33;
         return false;
@@ -866,12 +897,14 @@ bool CMasternodePing::CheckAndUpdate(CMasternode* pmn, bool fFromNewBroadcast, i
     // let's store this ping as the last one
     LogPrint("masternode", "CMasternodePing::CheckAndUpdate -- Masternode ping accepted, masternode=%s\n", vin.prevout.ToStringShort());
     pmn->lastPing = *this;
+    mnodeman.FlagMasternodeAsDirty(vin.prevout);
 
     // and update mnodeman.mapSeenMasternodeBroadcast.lastPing which is probably outdated
     CMasternodeBroadcast mnb(*pmn);
     uint256 hash = mnb.GetHash();
     if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
         mnodeman.mapSeenMasternodeBroadcast[hash].second.lastPing = *this;
+        mnodeman.FlagBroadcastAsDirty(hash);
     }
 
     pmn->Check(true); // force update, ignoring cache
@@ -886,7 +919,7 @@ bool CMasternodePing::CheckAndUpdate(CMasternode* pmn, bool fFromNewBroadcast, i
 void CMasternodePing::Relay()
 {
     CInv inv(MSG_MASTERNODE_PING, GetHash());
-    RelayInv(inv);
+    RelayInv(inv, darkSendSigner.GetMinSignaturePeerVersion());
 }
 
 void CMasternode::AddGovernanceVote(uint256 nGovernanceObjectHash)
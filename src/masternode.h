@@ -77,10 +77,24 @@ public:
         return ss.GetHash();
     }
 
+    /// The digest signed once SPORK_6_NEW_SIGS is on, see CDarkSendSigner::Sign()
+    uint256 GetSignatureHash() const
+    {
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << std::string(NetMsgType::MNPING);
+        ss << vin;
+        ss << blockHash;
+        ss << sigTime;
+        return ss.GetHash();
+    }
+
     bool IsExpired() {
         return GetTime() - sigTime > MASTERNODE_NEW_START_REQUIRED_SECONDS;
     }
 
+    /// The message the masternode key signs
+    std::string GetSignatureMessage() const;
+
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool CheckSignature(CPubKey& pubKeyMasternode, int &nDos);
     bool SimpleCheck(int& nDos);
@@ -140,12 +154,32 @@ struct masternode_info_t
 // The Masternode Class. For managing the Darksend process. It contains the input of the 1000DRK, signature to prove
 // it's the one who own that ip address and code for calculating the payment election.
 //
+/**
+ * Masternode scores for one block. The hash of the block, and the hasher
+ * state after the block hash, are the same for every masternode: they are
+ * computed once here and shared by all the masternodes scored against it.
+ */
+class CMasternodeScorer
+{
+private:
+    arith_uint256 hashBlockHash;
+    CHash256 hasherBlockHash;
+
+public:
+    explicit CMasternodeScorer(const uint256& blockHash);
+
+    /// Same as CMasternode::CalculateScore(blockHash) for the masternode with this collateral
+    arith_uint256 GetScore(const COutPoint& outpoint) const;
+};
+
 class CMasternode
 {
 private:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    void UpdateActiveState(bool fForce);
+
 public:
     enum state {
         MASTERNODE_PRE_ENABLED,
@@ -323,7 +357,7 @@ public:
         if(nPoSeBanScore > -MASTERNODE_POSE_BAN_MAX_SCORE) nPoSeBanScore--;
     }
 
-    masternode_info_t GetInfo();
+    masternode_info_t GetInfo() const;
 
     static std::string StateToString(int nStateIn);
     std::string GetStateString() const;
@@ -403,6 +437,20 @@ public:
         return ss.GetHash();
     }
 
+    /// The digest signed once SPORK_6_NEW_SIGS is on, see CDarkSendSigner::Sign()
+    uint256 GetSignatureHash() const
+    {
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << std::string(NetMsgType::MNANNOUNCE);
+        ss << vin;
+        ss << addr;
+        ss << sigTime;
+        ss << pubKeyCollateralAddress;
+        ss << pubKeyMasternode;
+        ss << nProtocolVersion;
+        return ss.GetHash();
+    }
+
     /// Create Masternode broadcast, needs to be relayed manually after that
     static bool Create(CTxIn vin, CService service, CKey keyCollateralAddressNew, CPubKey pubKeyCollateralAddressNew, CKey keyMasternodeNew, CPubKey pubKeyMasternodeNew, std::string &strErrorRet, CMasternodeBroadcast &mnbRet);
     static bool Create(std::string strService, std::string strKey, std::string strTxHash, std::string strOutputIndex, std::string& strErrorRet, CMasternodeBroadcast &mnbRet, bool fOffline = false);
@@ -411,6 +459,9 @@ public:
     bool Update(CMasternode* pmn, int& nDos);
     bool CheckOutpoint(int& nDos);
 
+    /// The message the collateral key signs
+    std::string GetSignatureMessage() const;
+
     bool Sign(CKey& keyCollateralAddress);
     bool CheckSignature(int& nDos);
     void Relay();
@@ -5,6 +5,7 @@
 
 #include "activemasternode.h"
 #include "addrman.h"
+#include "checkqueue.h"
 #include "darksend.h"
 #include "governance.h"
 #include "masternode-payments.h"
@@ -13,10 +14,89 @@
 #include "netfulfilledman.h"
 #include "util.h"
 
+#include <algorithm>
+
 /** Masternode manager */
 CMasternodeMan mnodeman;
 
-const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-1";
+static CCheckQueue<CMasternodeSignatureCheck> mnsigcheckqueue(16);
+// only one batch may be verified on the queue at a time
+static CCriticalSection cs_mnsigcheckqueue;
+
+void ThreadMasternodeSignatureCheck() {
+    RenameThread("mue-mnsigcheck");
+    mnsigcheckqueue.Thread();
+}
+
+bool CMasternodeSignatureCheck::operator()()
+{
+    std::string strError;
+    *pfValid = darkSendSigner.VerifyHash(hash, pubKey, vchSig, strError);
+    return true;
+}
+
+uint256 CMasternodeSignatureBatch::GetSignatureHash(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << pubKey.GetID() << vchSig << hash;
+    return ss.GetHash();
+}
+
+void CMasternodeSignatureBatch::Add(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash)
+{
+    LOCK(cs);
+    signature_t signature;
+    signature.pubKey = pubKey;
+    signature.vchSig = vchSig;
+    signature.hash = hash;
+    vecQueued.push_back(signature);
+}
+
+void CMasternodeSignatureBatch::Verify()
+{
+    std::vector<signature_t> vecTodo;
+    {
+        LOCK(cs);
+        vecTodo.swap(vecQueued);
+    }
+    if(vecTodo.empty()) return;
+
+    std::vector<char> vecValid(vecTodo.size(), 0);
+    std::vector<CMasternodeSignatureCheck> vecChecks;
+    vecChecks.reserve(vecTodo.size());
+    for(size_t i = 0; i < vecTodo.size(); i++) {
+        vecChecks.push_back(CMasternodeSignatureCheck(vecTodo[i].pubKey, vecTodo[i].vchSig, vecTodo[i].hash, &vecValid[i]));
+    }
+    {
+        LOCK(cs_mnsigcheckqueue);
+        CCheckQueueControl<CMasternodeSignatureCheck> control(&mnsigcheckqueue);
+        control.Add(vecChecks);
+        control.Wait();
+    }
+
+    LOCK(cs);
+    for(size_t i = 0; i < vecTodo.size(); i++) {
+        if(vecValid[i]) {
+            setVerified.insert(GetSignatureHash(vecTodo[i].pubKey, vecTodo[i].vchSig, vecTodo[i].hash));
+        }
+    }
+}
+
+bool CMasternodeSignatureBatch::IsVerified(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash)
+{
+    LOCK(cs);
+    if(setVerified.empty()) return false;
+    return setVerified.erase(GetSignatureHash(pubKey, vchSig, hash));
+}
+
+void CMasternodeSignatureBatch::Clear()
+{
+    LOCK(cs);
+    vecQueued.clear();
+    setVerified.clear();
+}
+
+const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-2";
 
 struct CompareLastPaidBlock
 {
@@ -27,6 +107,15 @@ struct CompareLastPaidBlock
     }
 };
 
+struct CompareByOutpoint
+{
+    bool operator()(const CMasternode* t1,
+                    const CMasternode* t2) const
+    {
+        return t1->vin.prevout < t2->vin.prevout;
+    }
+};
+
 struct CompareScoreMN
 {
     bool operator()(const std::pair<int64_t, CMasternode*>& t1,
@@ -97,9 +186,174 @@ void CMasternodeIndex::RebuildIndex()
     }
 }
 
+CMasternodeRegistryHasher::CMasternodeRegistryHasher()
+    : salt(GetRandHash())
+{}
+
+size_t CMasternodeRegistryHasher::operator()(const COutPoint& outpoint) const
+{
+    return outpoint.hash.GetHash(salt) + outpoint.n;
+}
+
+size_t CMasternodeRegistryHasher::operator()(const CPubKey& pubKey) const
+{
+    // the bytes after the header byte are (the start of) the x coordinate
+    uint256 key;
+    if(pubKey.size() > 1) {
+        memcpy(key.begin(), pubKey.begin() + 1, std::min(pubKey.size() - 1, (unsigned int)key.size()));
+    }
+    return key.GetHash(salt);
+}
+
+size_t CMasternodeRegistryHasher::operator()(const CService& addr) const
+{
+    std::vector<unsigned char> vchKey = addr.GetKey();
+    uint256 key;
+    memcpy(key.begin(), &vchKey[0], std::min(vchKey.size(), (size_t)key.size()));
+    return key.GetHash(salt);
+}
+
+void CMasternodeRegistry::AddToIndexes(CMasternode* pmn)
+{
+    mapByPubKey.insert(std::make_pair(pmn->pubKeyMasternode, pmn));
+    mapByAddr.insert(std::make_pair(pmn->addr, pmn));
+}
+
+void CMasternodeRegistry::RemoveFromIndexes(CMasternode* pmn, const CPubKey& pubKeyMasternode, const CService& addr)
+{
+    std::pair<pubkey_index_t::iterator, pubkey_index_t::iterator> rangePubKey = mapByPubKey.equal_range(pubKeyMasternode);
+    for(pubkey_index_t::iterator it = rangePubKey.first; it != rangePubKey.second; ++it) {
+        if(it->second == pmn) {
+            mapByPubKey.erase(it);
+            break;
+        }
+    }
+    std::pair<addr_index_t::iterator, addr_index_t::iterator> rangeAddr = mapByAddr.equal_range(addr);
+    for(addr_index_t::iterator it = rangeAddr.first; it != rangeAddr.second; ++it) {
+        if(it->second == pmn) {
+            mapByAddr.erase(it);
+            break;
+        }
+    }
+}
+
+CMasternode* CMasternodeRegistry::Add(const CMasternode& mn)
+{
+    std::pair<iterator, bool> ret = mapMasternodes.insert(std::make_pair(mn.vin.prevout, mn));
+    if(!ret.second) return NULL;
+    AddToIndexes(&ret.first->second);
+    return &ret.first->second;
+}
+
+CMasternodeRegistry::iterator CMasternodeRegistry::Erase(iterator it)
+{
+    RemoveFromIndexes(&it->second, it->second.pubKeyMasternode, it->second.addr);
+    return mapMasternodes.erase(it);
+}
+
+void CMasternodeRegistry::Clear()
+{
+    mapByPubKey.clear();
+    mapByAddr.clear();
+    mapMasternodes.clear();
+}
+
+CMasternode* CMasternodeRegistry::Find(const COutPoint& outpoint)
+{
+    iterator it = mapMasternodes.find(outpoint);
+    return it == mapMasternodes.end() ? NULL : &it->second;
+}
+
+CMasternode* CMasternodeRegistry::Find(const CPubKey& pubKeyMasternode)
+{
+    // pick the same one every time, whatever the order of the index is
+    CMasternode* pmnFound = NULL;
+    std::pair<pubkey_index_t::iterator, pubkey_index_t::iterator> range = mapByPubKey.equal_range(pubKeyMasternode);
+    for(pubkey_index_t::iterator it = range.first; it != range.second; ++it) {
+        if(!pmnFound || it->second->vin.prevout < pmnFound->vin.prevout) {
+            pmnFound = it->second;
+        }
+    }
+    return pmnFound;
+}
+
+std::vector<CMasternode*> CMasternodeRegistry::FindByAddr(const CService& addr)
+{
+    std::vector<CMasternode*> vpMasternodes;
+    std::pair<addr_index_t::iterator, addr_index_t::iterator> range = mapByAddr.equal_range(addr);
+    for(addr_index_t::iterator it = range.first; it != range.second; ++it) {
+        vpMasternodes.push_back(it->second);
+    }
+    return vpMasternodes;
+}
+
+void CMasternodeRegistry::Reindex(CMasternode* pmn, const CPubKey& pubKeyMasternodeOld, const CService& addrOld)
+{
+    // only masternodes in the list are indexed, not copies of them
+    if(Find(pmn->vin.prevout) != pmn) return;
+    RemoveFromIndexes(pmn, pubKeyMasternodeOld, addrOld);
+    AddToIndexes(pmn);
+}
+
+std::vector<CMasternode> CMasternodeRegistry::GetAll() const
+{
+    std::vector<const CMasternode*> vpMasternodes;
+    vpMasternodes.reserve(mapMasternodes.size());
+    for(const_iterator it = mapMasternodes.begin(); it != mapMasternodes.end(); ++it) {
+        vpMasternodes.push_back(&it->second);
+    }
+    sort(vpMasternodes.begin(), vpMasternodes.end(), CompareByOutpoint());
+
+    std::vector<CMasternode> vMasternodes;
+    vMasternodes.reserve(vpMasternodes.size());
+    BOOST_FOREACH(const CMasternode* pmn, vpMasternodes) {
+        vMasternodes.push_back(*pmn);
+    }
+    return vMasternodes;
+}
+
+static bool CompareMasternodeOutpoint(const CMasternode& mn, const COutPoint& outpoint)
+{
+    return mn.vin.prevout < outpoint;
+}
+
+const CMasternode* CMasternodeListView::Find(const COutPoint& outpoint) const
+{
+    std::vector<CMasternode>::const_iterator it = std::lower_bound(vecMasternodes.begin(), vecMasternodes.end(), outpoint, CompareMasternodeOutpoint);
+    if(it == vecMasternodes.end() || it->vin.prevout != outpoint) return NULL;
+    return &(*it);
+}
+
+const CMasternode* CMasternodeListView::Find(const CPubKey& pubKeyMasternode) const
+{
+    std::map<CPubKey, size_t>::const_iterator it = mapByPubKey.find(pubKeyMasternode);
+    if(it == mapByPubKey.end()) return NULL;
+    return &vecMasternodes[it->second];
+}
+
+int CMasternodeListView::CountMasternodes(int nProtocolVersion) const
+{
+    int nCount = 0;
+    BOOST_FOREACH(const CMasternode& mn, vecMasternodes) {
+        if(mn.nProtocolVersion < nProtocolVersion) continue;
+        nCount++;
+    }
+    return nCount;
+}
+
+int CMasternodeListView::CountEnabled(int nProtocolVersion) const
+{
+    int nCount = 0;
+    BOOST_FOREACH(const CMasternode& mn, vecMasternodes) {
+        if(mn.nProtocolVersion < nProtocolVersion || mn.nActiveState != CMasternode::MASTERNODE_ENABLED) continue;
+        nCount++;
+    }
+    return nCount;
+}
+
 CMasternodeMan::CMasternodeMan()
     : cs(),
-      vMasternodes(),
+      mapMasternodes(),
       mAskedUsForMasternodeList(),
       mWeAskedForMasternodeList(),
       mWeAskedForMasternodeListEntry(),
@@ -111,10 +365,19 @@ CMasternodeMan::CMasternodeMan()
       indexMasternodes(),
       indexMasternodesOld(),
       fIndexRebuilt(false),
-      fMasternodesAdded(false),
+      vecMasternodesAdded(),
       fMasternodesRemoved(false),
       vecDirtyGovernanceObjectHashes(),
       nLastWatchdogVoteTime(0),
+      mapRankTables(),
+      nRankTablesListVersion(0),
+      cs_listversion(),
+      nListVersion(0),
+      mapSnapshotEntries(),
+      mapSnapshotRemoved(),
+      mapSnapshotHeights(),
+      hashSnapshotCurrent(),
+      hashSnapshotSynced(),
       mapSeenMasternodeBroadcast(),
       mapSeenMasternodePing(),
       nDsqCount(0)
@@ -127,9 +390,11 @@ bool CMasternodeMan::Add(CMasternode &mn)
     CMasternode *pmn = Find(mn.vin);
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
-        vMasternodes.push_back(mn);
+        mapMasternodes.Add(mn);
         indexMasternodes.AddMasternodeVIN(mn.vin);
-        fMasternodesAdded = true;
+        vecMasternodesAdded.push_back(mn.vin.prevout);
+        NotifyMasternodeStateChanged();
+        FlagMasternodeAsDirty(mn.vin.prevout);
         return true;
     }
 
@@ -171,8 +436,8 @@ void CMasternodeMan::Check()
 
     LogPrint("masternode", "CMasternodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        mn.Check();
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes) {
+        mnpair.second.Check();
     }
 }
 
@@ -190,30 +455,34 @@ void CMasternodeMan::CheckAndRemove()
         Check();
 
         // Remove spent masternodes, prepare structures and make requests to reasure the state of inactive ones
-        std::vector<CMasternode>::iterator it = vMasternodes.begin();
+        CMasternodeRegistry::iterator it = mapMasternodes.begin();
         std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES masternode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
-        while(it != vMasternodes.end()) {
-            CMasternodeBroadcast mnb = CMasternodeBroadcast(*it);
+        while(it != mapMasternodes.end()) {
+            CMasternode& mn = it->second;
+            CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
             uint256 hash = mnb.GetHash();
             // If collateral was spent ...
-            if ((*it).IsOutpointSpent()) {
-                LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing Masternode: %s  addr=%s  %i now\n", (*it).GetStateString(), (*it).addr.ToString(), size() - 1);
+            if (mn.IsOutpointSpent()) {
+                LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing Masternode: %s  addr=%s  %i now\n", mn.GetStateString(), mn.addr.ToString(), size() - 1);
 
                 // erase all of the broadcasts we've seen from this txin, ...
                 mapSeenMasternodeBroadcast.erase(hash);
-                mWeAskedForMasternodeListEntry.erase((*it).vin.prevout);
+                FlagBroadcastAsDirty(hash);
+                mWeAskedForMasternodeListEntry.erase(mn.vin.prevout);
 
                 // and finally remove it from the list
-                it->FlagGovernanceItemsAsDirty();
-                it = vMasternodes.erase(it);
+                mn.FlagGovernanceItemsAsDirty();
+                FlagMasternodeAsDirty(mn.vin.prevout);
+                it = mapMasternodes.Erase(it);
                 fMasternodesRemoved = true;
+                NotifyMasternodeStateChanged();
             } else {
                 bool fAsk = pCurrentBlockIndex &&
                             (nAskForMnbRecovery > 0) &&
                             masternodeSync.IsSynced() &&
-                            it->IsNewStartRequired() &&
+                            mn.IsNewStartRequired() &&
                             !IsMnbRecoveryRequested(hash);
                 if(fAsk) {
                     // this mn is in a non-recoverable state and we haven't asked other nodes yet
@@ -227,7 +496,7 @@ void CMasternodeMan::CheckAndRemove()
                     // ask first MNB_RECOVERY_QUORUM_TOTAL masternodes we can connect to and we haven't asked recently
                     for(int i = 0; setRequested.size() < MNB_RECOVERY_QUORUM_TOTAL && i < (int)vecMasternodeRanks.size(); i++) {
                         // avoid banning
-                        if(mWeAskedForMasternodeListEntry.count(it->vin.prevout) && mWeAskedForMasternodeListEntry[it->vin.prevout].count(vecMasternodeRanks[i].second.addr)) continue;
+                        if(mWeAskedForMasternodeListEntry.count(mn.vin.prevout) && mWeAskedForMasternodeListEntry[mn.vin.prevout].count(vecMasternodeRanks[i].second.addr)) continue;
                         // didn't ask recently, ok to ask now
                         CService addr = vecMasternodeRanks[i].second.addr;
                         setRequested.insert(addr);
@@ -235,7 +504,7 @@ void CMasternodeMan::CheckAndRemove()
                         fAskedForMnbRecovery = true;
                     }
                     if(fAskedForMnbRecovery) {
-                        LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Recovery initiated, masternode=%s\n", it->vin.prevout.ToStringShort());
+                        LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Recovery initiated, masternode=%s\n", mn.vin.prevout.ToStringShort());
                         nAskForMnbRecovery--;
                     }
                     // wait for mnb recovery replies for MNB_RECOVERY_WAIT_SECONDS seconds
@@ -295,6 +564,7 @@ void CMasternodeMan::CheckAndRemove()
         it1 = mWeAskedForMasternodeList.begin();
         while(it1 != mWeAskedForMasternodeList.end()) {
             if((*it1).second < GetTime()) {
+                mWeAskedForMasternodeListDiff.erase(it1->first);
                 mWeAskedForMasternodeList.erase(it1++);
             } else {
                 ++it1;
@@ -330,15 +600,13 @@ void CMasternodeMan::CheckAndRemove()
 
         // NOTE: do not expire mapSeenMasternodeBroadcast entries here, clean them on mnb updates!
 
-        // remove expired mapSeenMasternodePing
-        std::map<uint256, CMasternodePing>::iterator it4 = mapSeenMasternodePing.begin();
-        while(it4 != mapSeenMasternodePing.end()) {
-            if((*it4).second.IsExpired()) {
-                LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing expired Masternode ping: hash=%s\n", (*it4).second.GetHash().ToString());
-                mapSeenMasternodePing.erase(it4++);
-            } else {
-                ++it4;
-            }
+        // remove expired mapSeenMasternodePing, oldest first
+        uint256 hashPing;
+        while(queueSeenPingExpiry.pop_expired(GetTime() - MASTERNODE_NEW_START_REQUIRED_SECONDS, hashPing)) {
+            std::map<uint256, CMasternodePing>::iterator it4 = mapSeenMasternodePing.find(hashPing);
+            if(it4 == mapSeenMasternodePing.end() || !it4->second.IsExpired()) continue;
+            LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing expired Masternode ping: hash=%s\n", hashPing.ToString());
+            EraseSeenPing(hashPing);
         }
 
         // remove expired mapSeenMasternodeVerification
@@ -367,44 +635,66 @@ void CMasternodeMan::CheckAndRemove()
 void CMasternodeMan::Clear()
 {
     LOCK(cs);
-    vMasternodes.clear();
+    // the records of whatever is cleared go too
+    FlagAllAsDirty();
+    mapMasternodes.Clear();
+    NotifyMasternodeStateChanged();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
+    mWeAskedForMasternodeListDiff.clear();
     mWeAskedForMasternodeListEntry.clear();
     mapSeenMasternodeBroadcast.clear();
     mapSeenMasternodePing.clear();
+    queueSeenPingExpiry.clear();
+    vecMasternodesAdded.clear();
     nDsqCount = 0;
     nLastWatchdogVoteTime = 0;
     indexMasternodes.Clear();
     indexMasternodesOld.Clear();
+    mapSnapshotEntries.clear();
+    mapSnapshotRemoved.clear();
+    mapSnapshotHeights.clear();
+    hashSnapshotCurrent = uint256();
+    hashSnapshotSynced = uint256();
 }
 
-int CMasternodeMan::CountMasternodes(int nProtocolVersion)
+void CMasternodeMan::AddSeenPing(const CMasternodePing& mnp)
 {
-    LOCK(cs);
-    int nCount = 0;
-    nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinMasternodePaymentsProto() : nProtocolVersion;
+    AssertLockHeld(cs);
+    uint256 hash = mnp.GetHash();
+    if(mapSeenMasternodePing.insert(std::make_pair(hash, mnp)).second) {
+        queueSeenPingExpiry.push(hash, mnp.sigTime);
+        LOCK(cs_dirty);
+        setDirtyPings.insert(hash);
+    }
+}
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        if(mn.nProtocolVersion < nProtocolVersion) continue;
-        nCount++;
+void CMasternodeMan::EraseSeenPing(const uint256& hash)
+{
+    LOCK2(cs, cs_dirty);
+    mapSeenMasternodePing.erase(hash);
+    setDirtyPings.insert(hash);
+}
+
+void CMasternodeMan::RebuildSeenPingExpiry()
+{
+    AssertLockHeld(cs);
+    queueSeenPingExpiry.clear();
+    for(std::map<uint256, CMasternodePing>::const_iterator it = mapSeenMasternodePing.begin(); it != mapSeenMasternodePing.end(); ++it) {
+        queueSeenPingExpiry.push(it->first, it->second.sigTime);
     }
+}
 
-    return nCount;
+int CMasternodeMan::CountMasternodes(int nProtocolVersion)
+{
+    nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinMasternodePaymentsProto() : nProtocolVersion;
+    return GetListView()->CountMasternodes(nProtocolVersion);
 }
 
 int CMasternodeMan::CountEnabled(int nProtocolVersion)
 {
-    LOCK(cs);
-    int nCount = 0;
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinMasternodePaymentsProto() : nProtocolVersion;
-
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        if(mn.nProtocolVersion < nProtocolVersion || !mn.IsEnabled()) continue;
-        nCount++;
-    }
-
-    return nCount;
+    return GetListView()->CountEnabled(nProtocolVersion);
 }
 
 /* Only IPv4 masternodes are allowed in 12.1, saving this for later
@@ -413,10 +703,10 @@ int CMasternodeMan::CountByIP(int nNetworkType)
     LOCK(cs);
     int nNodeCount = 0;
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-        if ((nNetworkType == NET_IPV4 && mn.addr.IsIPv4()) ||
-            (nNetworkType == NET_TOR  && mn.addr.IsTor())  ||
-            (nNetworkType == NET_IPV6 && mn.addr.IsIPv6())) {
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes)
+        if ((nNetworkType == NET_IPV4 && mnpair.second.addr.IsIPv4()) ||
+            (nNetworkType == NET_TOR  && mnpair.second.addr.IsTor())  ||
+            (nNetworkType == NET_IPV6 && mnpair.second.addr.IsIPv6())) {
                 nNodeCount++;
         }
 
@@ -438,54 +728,53 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
         }
     }
 
-    pnode->PushMessage(NetMsgType::DSEG, CTxIn());
+    if(pnode->nVersion >= MIN_MNLISTDIFF_PROTO_VERSION) {
+        // on a first sync hashSnapshotSynced is null, which asks for the whole list
+        pnode->PushMessage(NetMsgType::GETMNLISTDIFF, hashSnapshotSynced);
+        mWeAskedForMasternodeListDiff[pnode->addr] = hashSnapshotSynced;
+        LogPrint("masternode", "CMasternodeMan::DsegUpdate -- asked %s for the list since snapshot %s\n", pnode->addr.ToString(), hashSnapshotSynced.ToString());
+    } else {
+        pnode->PushMessage(NetMsgType::DSEG, CTxIn());
+        LogPrint("masternode", "CMasternodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
+    }
     int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
     mWeAskedForMasternodeList[pnode->addr] = askAgain;
-
-    LogPrint("masternode", "CMasternodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
 }
 
 CMasternode* CMasternodeMan::Find(const CScript &payee)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
+    // pick the same one every time, whatever the order of the list is
+    CMasternode* pmnFound = NULL;
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes)
     {
-        if(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) == payee)
-            return &mn;
+        if(GetScriptForDestination(mnpair.second.pubKeyCollateralAddress.GetID()) != payee)
+            continue;
+        if(!pmnFound || mnpair.first < pmnFound->vin.prevout)
+            pmnFound = &mnpair.second;
     }
-    return NULL;
+    return pmnFound;
 }
 
 CMasternode* CMasternodeMan::Find(const CTxIn &vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    return mapMasternodes.Find(vin.prevout);
 }
 
 CMasternode* CMasternodeMan::Find(const CPubKey &pubKeyMasternode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.pubKeyMasternode == pubKeyMasternode)
-            return &mn;
-    }
-    return NULL;
+    return mapMasternodes.Find(pubKeyMasternode);
 }
 
 bool CMasternodeMan::Get(const CPubKey& pubKeyMasternode, CMasternode& masternode)
 {
-    // Theses mutexes are recursive so double locking by the same thread is safe.
-    LOCK(cs);
-    CMasternode* pMN = Find(pubKeyMasternode);
+    masternode_list_view_t pView = GetListView();
+    const CMasternode* pMN = pView->Find(pubKeyMasternode);
     if(!pMN)  {
         return false;
     }
@@ -495,9 +784,8 @@ bool CMasternodeMan::Get(const CPubKey& pubKeyMasternode, CMasternode& masternod
 
 bool CMasternodeMan::Get(const CTxIn& vin, CMasternode& masternode)
 {
-    // Theses mutexes are recursive so double locking by the same thread is safe.
-    LOCK(cs);
-    CMasternode* pMN = Find(vin);
+    masternode_list_view_t pView = GetListView();
+    const CMasternode* pMN = pView->Find(vin.prevout);
     if(!pMN)  {
         return false;
     }
@@ -508,8 +796,8 @@ bool CMasternodeMan::Get(const CTxIn& vin, CMasternode& masternode)
 masternode_info_t CMasternodeMan::GetMasternodeInfo(const CTxIn& vin)
 {
     masternode_info_t info;
-    LOCK(cs);
-    CMasternode* pMN = Find(vin);
+    masternode_list_view_t pView = GetListView();
+    const CMasternode* pMN = pView->Find(vin.prevout);
     if(!pMN)  {
         return info;
     }
@@ -520,8 +808,8 @@ masternode_info_t CMasternodeMan::GetMasternodeInfo(const CTxIn& vin)
 masternode_info_t CMasternodeMan::GetMasternodeInfo(const CPubKey& pubKeyMasternode)
 {
     masternode_info_t info;
-    LOCK(cs);
-    CMasternode* pMN = Find(pubKeyMasternode);
+    masternode_list_view_t pView = GetListView();
+    const CMasternode* pMN = pView->Find(pubKeyMasternode);
     if(!pMN)  {
         return info;
     }
@@ -530,10 +818,14 @@ masternode_info_t CMasternodeMan::GetMasternodeInfo(const CPubKey& pubKeyMastern
 }
 
 bool CMasternodeMan::Has(const CTxIn& vin)
+{
+    return GetListView()->Find(vin.prevout) != NULL;
+}
+
+bool CMasternodeMan::HasLive(const CTxIn& vin)
 {
     LOCK(cs);
-    CMasternode* pMN = Find(vin);
-    return (pMN != NULL);
+    return mapMasternodes.Find(vin.prevout) != NULL;
 }
 
 //
@@ -561,23 +853,23 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     */
 
     int nMnCount = CountEnabled();
-    BOOST_FOREACH(CMasternode &mn, vMasternodes)
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes)
     {
-        if(!mn.IsValidForPayment()) continue;
+        if(!mnpair.second.IsValidForPayment()) continue;
 
         // //check protocol version
-        if(mn.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
+        if(mnpair.second.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
 
         //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if(mnpayments.IsScheduled(mn, nBlockHeight)) continue;
+        if(mnpayments.IsScheduled(mnpair.second, nBlockHeight)) continue;
 
         //it's too new, wait for a cycle
-        if(fFilterSigTime && mn.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
+        if(fFilterSigTime && mnpair.second.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
 
         //make sure it has at least as many confirmations as there are masternodes
-        if(mn.GetCollateralAge() < nMnCount) continue;
+        if(mnpair.second.GetCollateralAge() < nMnCount) continue;
 
-        vecMasternodeLastPaid.push_back(std::make_pair(mn.GetLastPaidBlock(), &mn));
+        vecMasternodeLastPaid.push_back(std::make_pair(mnpair.second.GetLastPaidBlock(), &mnpair.second));
     }
 
     nCount = (int)vecMasternodeLastPaid.size();
@@ -600,8 +892,9 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     int nTenthNetwork = nMnCount/10;
     int nCountTenth = 0;
     arith_uint256 nHighest = 0;
+    CMasternodeScorer scorer(blockHash);
     BOOST_FOREACH (PAIRTYPE(int, CMasternode*)& s, vecMasternodeLastPaid) {
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
+        arith_uint256 nScore = scorer.GetScore(s.second->vin.prevout);
         if(nScore > nHighest) {
             nHighest = nScore;
             pBestMasternode = s.second;
@@ -626,8 +919,8 @@ CMasternode* CMasternodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToE
 
     // fill a vector of pointers
     std::vector<CMasternode*> vpMasternodesShuffled;
-    BOOST_FOREACH(CMasternode &mn, vMasternodes) {
-        vpMasternodesShuffled.push_back(&mn);
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes) {
+        vpMasternodesShuffled.push_back(&mnpair.second);
     }
 
     InsecureRand insecureRand;
@@ -655,68 +948,93 @@ CMasternode* CMasternodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToE
     return NULL;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+const CMasternodeMan::rank_table_t& CMasternodeMan::GetRankTable(int nBlockHeight, const uint256& blockHash, int nMinProtocol, int nFilter)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
+    AssertLockHeld(cs);
 
-    //make sure we know about this block
-    uint256 blockHash = uint256();
-    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
+    int64_t nListVersionNow;
+    {
+        LOCK(cs_listversion);
+        nListVersionNow = nListVersion;
+    }
+    if(nListVersionNow != nRankTablesListVersion) {
+        mapRankTables.clear();
+        nRankTablesListVersion = nListVersionNow;
+    }
 
-    LOCK(cs);
+    rank_key_t key = std::make_pair(nBlockHeight, std::make_pair(nMinProtocol, nFilter));
+    std::map<rank_key_t, rank_table_t>::iterator it = mapRankTables.find(key);
+    // the hash changes if the block at this height was reorganized away
+    if(it != mapRankTables.end() && it->second.blockHash == blockHash) {
+        return it->second;
+    }
 
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive) {
-            if(!mn.IsEnabled()) continue;
-        }
-        else {
-            if(!mn.IsValidForPayment()) continue;
-        }
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
+    CMasternodeScorer scorer(blockHash);
 
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes) {
+        if(mnpair.second.nProtocolVersion < nMinProtocol) continue;
+        if(nFilter == RANK_ENABLED && !mnpair.second.IsEnabled()) continue;
+        if(nFilter == RANK_VALID_FOR_PAYMENT && !mnpair.second.IsEnabled() && !mnpair.second.IsWatchdogExpired()) continue;
+
+        int64_t nScore = scorer.GetScore(mnpair.first).GetCompact(false);
+
+        vecMasternodeScores.push_back(std::make_pair(nScore, &mnpair.second));
     }
 
     sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
 
+    // tables for the lowest heights are the least likely to be asked for again
+    if(it == mapRankTables.end() && mapRankTables.size() >= MAX_RANK_TABLES) {
+        mapRankTables.erase(mapRankTables.begin());
+    }
+
+    rank_table_t& table = mapRankTables[key];
+    table.blockHash = blockHash;
+    table.vecRanked.clear();
+    table.mapRanks.clear();
     int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& scorePair, vecMasternodeScores) {
+    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores) {
         nRank++;
-        if(scorePair.second->vin.prevout == vin.prevout) return nRank;
+        table.vecRanked.push_back(s.second);
+        table.mapRanks[s.second->vin.prevout] = nRank;
     }
 
-    return -1;
+    return table;
 }
 
-std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int nBlockHeight, int nMinProtocol)
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
-    std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
-
     //make sure we know about this block
     uint256 blockHash = uint256();
-    if(!GetBlockHash(blockHash, nBlockHeight)) return vecMasternodeRanks;
+    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
+
+    // with SPORK_14_REQUIRE_SENTINEL_FLAG on, only enabled masternodes are valid for payment
+    int nFilter = (fOnlyActive || sporkManager.IsSporkActive(SPORK_14_REQUIRE_SENTINEL_FLAG)) ? RANK_ENABLED : RANK_VALID_FOR_PAYMENT;
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    const rank_table_t& table = GetRankTable(nBlockHeight, blockHash, nMinProtocol, nFilter);
+    std::map<COutPoint, int>::const_iterator it = table.mapRanks.find(vin.prevout);
 
-        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
+    return it == table.mapRanks.end() ? -1 : it->second;
+}
 
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int nBlockHeight, int nMinProtocol)
+{
+    std::vector<std::pair<int, CMasternode> > vecMasternodeRanks;
 
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
+    //make sure we know about this block
+    uint256 blockHash = uint256();
+    if(!GetBlockHash(blockHash, nBlockHeight)) return vecMasternodeRanks;
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
+    LOCK(cs);
 
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores) {
-        nRank++;
-        vecMasternodeRanks.push_back(std::make_pair(nRank, *s.second));
+    const rank_table_t& table = GetRankTable(nBlockHeight, blockHash, nMinProtocol, RANK_ENABLED);
+
+    vecMasternodeRanks.reserve(table.vecRanked.size());
+    for(size_t i = 0; i < table.vecRanked.size(); i++) {
+        vecMasternodeRanks.push_back(std::make_pair(i + 1, *table.vecRanked[i]));
     }
 
     return vecMasternodeRanks;
@@ -724,8 +1042,6 @@ std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
-
     LOCK(cs);
 
     uint256 blockHash;
@@ -734,28 +1050,13 @@ CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int nBlockHeight, in
         return NULL;
     }
 
-    // Fill scores
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-
-        if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive && !mn.IsEnabled()) continue;
-
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+    const rank_table_t& table = GetRankTable(nBlockHeight, blockHash, nMinProtocol, fOnlyActive ? RANK_ENABLED : RANK_ANY);
 
-        vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
-
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CMasternode*)& s, vecMasternodeScores) {
-        rank++;
-        if(rank == nRank) {
-            return s.second;
-        }
+    if(nRank < 1 || nRank > (int)table.vecRanked.size()) {
+        return NULL;
     }
 
-    return NULL;
+    return table.vecRanked[nRank - 1];
 }
 
 void CMasternodeMan::ProcessMasternodeConnections()
@@ -808,64 +1109,27 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
     if (strCommand == NetMsgType::MNANNOUNCE) { //Masternode Broadcast
 
-        CMasternodeBroadcast mnb;
-        vRecv >> mnb;
+        pending_message_t message;
+        message.fPing = false;
+        vRecv >> message.mnb;
 
-        pfrom->setAskFor.erase(mnb.GetHash());
+        pfrom->setAskFor.erase(message.mnb.GetHash());
 
-        LogPrint("masternode", "MNANNOUNCE -- Masternode announce, masternode=%s\n", mnb.vin.prevout.ToStringShort());
+        LogPrint("masternode", "MNANNOUNCE -- Masternode announce, masternode=%s\n", message.mnb.vin.prevout.ToStringShort());
 
-        int nDos = 0;
-
-        if (CheckMnbAndUpdateMasternodeList(pfrom, mnb, nDos)) {
-            // use announced Masternode as a peer
-            addrman.Add(CAddress(mnb.addr), pfrom->addr, 2*60*60);
-        } else if(nDos > 0) {
-            Misbehaving(pfrom->GetId(), nDos);
-        }
+        pendingMessages.Queue(*this, pfrom, message);
 
-        if(fMasternodesAdded) {
-            NotifyMasternodeUpdates();
-        }
     } else if (strCommand == NetMsgType::MNPING) { //Masternode Ping
 
-        CMasternodePing mnp;
-        vRecv >> mnp;
-
-        uint256 nHash = mnp.GetHash();
-
-        pfrom->setAskFor.erase(nHash);
-
-        LogPrint("masternode", "MNPING -- Masternode ping, masternode=%s\n", mnp.vin.prevout.ToStringShort());
-
-        // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
-        LOCK2(cs_main, cs);
-
-        if(mapSeenMasternodePing.count(nHash)) return; //seen
-        mapSeenMasternodePing.insert(std::make_pair(nHash, mnp));
-
-        LogPrint("masternode", "MNPING -- Masternode ping, masternode=%s new\n", mnp.vin.prevout.ToStringShort());
-
-        // see if we have this Masternode
-        CMasternode* pmn = mnodeman.Find(mnp.vin);
-
-        // too late, new MNANNOUNCE is required
-        if(pmn && pmn->IsNewStartRequired()) return;
+        pending_message_t message;
+        message.fPing = true;
+        vRecv >> message.mnp;
 
-        int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos)) return;
+        pfrom->setAskFor.erase(message.mnp.GetHash());
 
-        if(nDos > 0) {
-            // if anything significant failed, mark that node
-            Misbehaving(pfrom->GetId(), nDos);
-        } else if(pmn != NULL) {
-            // nothing significant failed, mn is a known one too
-            return;
-        }
+        LogPrint("masternode", "MNPING -- Masternode ping, masternode=%s\n", message.mnp.vin.prevout.ToStringShort());
 
-        // something significant is broken or mn is unknown,
-        // we might have to ask for a masternode entry once
-        AskForMN(pfrom, mnp.vin);
+        pendingMessages.Queue(*this, pfrom, message);
 
     } else if (strCommand == NetMsgType::DSEG) { //Get Masternode list or specific entry
         // Ignore such requests until we are fully synced.
@@ -873,6 +1137,9 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         // but this is a heavy one so it's better to finish sync first.
         if (!masternodeSync.IsSynced()) return;
 
+        // older peers can't verify broadcasts and pings signed over digests
+        if (pfrom->nVersion < darkSendSigner.GetMinSignaturePeerVersion()) return;
+
         CTxIn vin;
         vRecv >> vin;
 
@@ -901,23 +1168,24 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         int nInvCount = 0;
 
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-            if (vin != CTxIn() && vin != mn.vin) continue; // asked for specific vin but we are not there yet
-            if (mn.addr.IsRFC1918() || mn.addr.IsLocal()) continue; // do not send local network masternode
-            if (mn.IsUpdateRequired()) continue; // do not send outdated masternodes
+        BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes) {
+            if (vin != CTxIn() && vin != mnpair.second.vin) continue; // asked for specific vin but we are not there yet
+            if (mnpair.second.addr.IsRFC1918() || mnpair.second.addr.IsLocal()) continue; // do not send local network masternode
+            if (mnpair.second.IsUpdateRequired()) continue; // do not send outdated masternodes
 
-            LogPrint("masternode", "DSEG -- Sending Masternode entry: masternode=%s  addr=%s\n", mn.vin.prevout.ToStringShort(), mn.addr.ToString());
-            CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
+            LogPrint("masternode", "DSEG -- Sending Masternode entry: masternode=%s  addr=%s\n", mnpair.second.vin.prevout.ToStringShort(), mnpair.second.addr.ToString());
+            CMasternodeBroadcast mnb = CMasternodeBroadcast(mnpair.second);
             uint256 hash = mnb.GetHash();
             pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
-            pfrom->PushInventory(CInv(MSG_MASTERNODE_PING, mn.lastPing.GetHash()));
+            pfrom->PushInventory(CInv(MSG_MASTERNODE_PING, mnpair.second.lastPing.GetHash()));
             nInvCount++;
 
             if (!mapSeenMasternodeBroadcast.count(hash)) {
                 mapSeenMasternodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), mnb)));
+                FlagBroadcastAsDirty(hash);
             }
 
-            if (vin == mn.vin) {
+            if (vin == mnpair.second.vin) {
                 LogPrintf("DSEG -- Sent 1 Masternode inv to peer %d\n", pfrom->id);
                 return;
             }
@@ -931,6 +1199,52 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         // smth weird happen - someone asked us for vin we have no idea about?
         LogPrint("masternode", "DSEG -- No invs sent to peer %d\n", pfrom->id);
 
+    } else if (strCommand == NetMsgType::GETMNLISTDIFF) { //Get what changed in the Masternode list since a snapshot
+        // Same as DSEG, ignore until we are fully synced
+        if (!masternodeSync.IsSynced()) return;
+
+        uint256 hashSnapshotBase;
+        vRecv >> hashSnapshotBase;
+
+        LogPrint("masternode", "GETMNLISTDIFF -- Masternode list since snapshot %s, peer=%d\n", hashSnapshotBase.ToString(), pfrom->id);
+
+        CMasternodeListDiff diff;
+        {
+            LOCK(cs);
+
+            if(!GetListDiff(hashSnapshotBase, diff)) {
+                // the peer has to ask for the whole list with DSEG, which is where it gets limited
+                diff = CMasternodeListDiff();
+                pfrom->PushMessage(NetMsgType::MNLISTDIFF, diff);
+                LogPrintf("GETMNLISTDIFF -- Unknown snapshot %s, peer=%d\n", hashSnapshotBase.ToString(), pfrom->id);
+                return;
+            }
+
+            bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
+
+            if(!isLocal && Params().NetworkIDString() == CBaseChainParams::MAIN) {
+                std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
+                if (i != mAskedUsForMasternodeList.end() && GetTime() < i->second) {
+                    Misbehaving(pfrom->GetId(), 34);
+                    LogPrintf("GETMNLISTDIFF -- peer already asked me for the list, peer=%d\n", pfrom->id);
+                    return;
+                }
+                mAskedUsForMasternodeList[pfrom->addr] = GetTime() + DSEG_UPDATE_SECONDS;
+            }
+        }
+
+        pfrom->PushMessage(NetMsgType::MNLISTDIFF, diff);
+        pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_LIST, (int)diff.vecMnb.size());
+        LogPrintf("GETMNLISTDIFF -- Sent %d removed, %d changed and %d pinged Masternodes to peer %d\n",
+                  (int)diff.vecRemoved.size(), (int)diff.vecMnb.size(), (int)diff.vecMnp.size(), pfrom->id);
+
+    } else if (strCommand == NetMsgType::MNLISTDIFF) { //What changed in the Masternode list since our snapshot
+
+        CMasternodeListDiff diff;
+        vRecv >> diff;
+
+        ProcessListDiff(pfrom, diff);
+
     } else if (strCommand == NetMsgType::MNVERIFY) { // Masternode Verify
 
         // Need LOCK2 here to ensure consistent locking order because the all functions below call GetBlockHash which locks cs_main
@@ -952,6 +1266,113 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
     }
 }
 
+void CMasternodeMan::ProcessPendingMessages()
+{
+    size_t nCount = pendingMessages.Process(*this);
+    if(nCount == 0) return;
+
+    LogPrint("masternode", "CMasternodeMan::ProcessPendingMessages -- processed %d messages\n", (int)nCount);
+
+    bool fMasternodesAdded;
+    {
+        LOCK(cs);
+        fMasternodesAdded = !vecMasternodesAdded.empty();
+    }
+    if(fMasternodesAdded) {
+        NotifyMasternodeUpdates();
+    }
+}
+
+void CMasternodeMan::AddPendingSignatures(const std::vector<pending_message_t>& vecMessages, CMasternodeSignatureBatch& batch)
+{
+    LOCK(cs);
+    // masternode keys as they will be when each ping is processed, as far as we can tell
+    std::map<COutPoint, CPubKey> mapPubKeys;
+    BOOST_FOREACH(const pending_message_t& message, vecMessages) {
+        if(message.fPing) {
+            const CMasternodePing& mnp = message.mnp;
+            if(mapSeenMasternodePing.count(mnp.GetHash())) continue;
+            std::map<COutPoint, CPubKey>::iterator it = mapPubKeys.find(mnp.vin.prevout);
+            if(it != mapPubKeys.end()) {
+                batch.Add(it->second, mnp.vchSig, darkSendSigner.GetSignedHash(mnp));
+            } else {
+                CMasternode* pmn = Find(mnp.vin);
+                if(pmn) {
+                    batch.Add(pmn->pubKeyMasternode, mnp.vchSig, darkSendSigner.GetSignedHash(mnp));
+                }
+            }
+        } else {
+            const CMasternodeBroadcast& mnb = message.mnb;
+            if(mapSeenMasternodeBroadcast.count(mnb.GetHash())) continue;
+            batch.Add(mnb.pubKeyCollateralAddress, mnb.vchSig, darkSendSigner.GetSignedHash(mnb));
+            if(mnb.lastPing != CMasternodePing()) {
+                batch.Add(mnb.pubKeyMasternode, mnb.lastPing.vchSig, darkSendSigner.GetSignedHash(mnb.lastPing));
+            }
+            mapPubKeys[mnb.vin.prevout] = mnb.pubKeyMasternode;
+        }
+    }
+}
+
+void CMasternodeMan::ProcessPendingMessage(CNode* pfrom, pending_message_t& message)
+{
+    if(message.fPing) {
+        ProcessPing(pfrom, message.mnp);
+    } else {
+        ProcessAnnounce(pfrom, message.mnb);
+    }
+}
+
+bool CMasternodeMan::IsSignatureVerified(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash)
+{
+    return pendingMessages.IsVerified(pubKey, vchSig, hash);
+}
+
+void CMasternodeMan::ProcessAnnounce(CNode* pfrom, CMasternodeBroadcast& mnb)
+{
+    int nDos = 0;
+
+    if (CheckMnbAndUpdateMasternodeList(pfrom, mnb, nDos)) {
+        // use announced Masternode as a peer
+        addrman.Add(CAddress(mnb.addr), pfrom->addr, 2*60*60);
+    } else if(nDos > 0) {
+        Misbehaving(pfrom->GetId(), nDos);
+    }
+}
+
+void CMasternodeMan::ProcessPing(CNode* pfrom, CMasternodePing& mnp)
+{
+    uint256 nHash = mnp.GetHash();
+
+    // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
+    LOCK2(cs_main, cs);
+
+    if(mapSeenMasternodePing.count(nHash)) return; //seen
+    AddSeenPing(mnp);
+
+    LogPrint("masternode", "MNPING -- Masternode ping, masternode=%s new\n", mnp.vin.prevout.ToStringShort());
+
+    // see if we have this Masternode
+    CMasternode* pmn = Find(mnp.vin);
+
+    // too late, new MNANNOUNCE is required
+    if(pmn && pmn->IsNewStartRequired()) return;
+
+    int nDos = 0;
+    if(mnp.CheckAndUpdate(pmn, false, nDos)) return;
+
+    if(nDos > 0) {
+        // if anything significant failed, mark that node
+        Misbehaving(pfrom->GetId(), nDos);
+    } else if(pmn != NULL) {
+        // nothing significant failed, mn is a known one too
+        return;
+    }
+
+    // something significant is broken or mn is unknown,
+    // we might have to ask for a masternode entry once
+    AskForMN(pfrom, mnp.vin);
+}
+
 // Verification of masternodes via unique direct requests.
 
 void CMasternodeMan::DoFullVerificationStep()
@@ -996,8 +1417,8 @@ void CMasternodeMan::DoFullVerificationStep()
     if(nOffset >= (int)vecMasternodeRanks.size()) return;
 
     std::vector<CMasternode*> vSortedByAddr;
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        vSortedByAddr.push_back(&mn);
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes) {
+        vSortedByAddr.push_back(&mnpair.second);
     }
 
     sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
@@ -1036,7 +1457,7 @@ void CMasternodeMan::DoFullVerificationStep()
 
 void CMasternodeMan::CheckSameAddr()
 {
-    if(!masternodeSync.IsSynced() || vMasternodes.empty()) return;
+    if(!masternodeSync.IsSynced() || mapMasternodes.empty()) return;
 
     std::vector<CMasternode*> vBan;
     std::vector<CMasternode*> vSortedByAddr;
@@ -1047,8 +1468,8 @@ void CMasternodeMan::CheckSameAddr()
         CMasternode* pprevMasternode = NULL;
         CMasternode* pverifiedMasternode = NULL;
 
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-            vSortedByAddr.push_back(&mn);
+        BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes) {
+            vSortedByAddr.push_back(&mnpair.second);
         }
 
         sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
@@ -1084,6 +1505,7 @@ void CMasternodeMan::CheckSameAddr()
     BOOST_FOREACH(CMasternode* pmn, vBan) {
         LogPrintf("CMasternodeMan::CheckSameAddr -- increasing PoSe ban score for masternode %s\n", pmn->vin.prevout.ToStringShort());
         pmn->IncreasePoSeBanScore();
+        FlagMasternodeAsDirty(pmn->vin.prevout);
     }
 }
 
@@ -1197,47 +1619,44 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
 
         CMasternode* prealMasternode = NULL;
         std::vector<CMasternode*> vpMasternodesToBan;
-        std::vector<CMasternode>::iterator it = vMasternodes.begin();
         std::string strMessage1 = strprintf("%s%d%s", pnode->addr.ToString(false), mnv.nonce, blockHash.ToString());
-        while(it != vMasternodes.end()) {
-            if((CAddress)it->addr == pnode->addr) {
-                if(darkSendSigner.VerifyMessage(it->pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
-                    // found it!
-                    prealMasternode = &(*it);
-                    if(!it->IsPoSeVerified()) {
-                        it->DecreasePoSeBanScore();
-                    }
-                    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
-
-                    // we can only broadcast it if we are an activated masternode
-                    if(activeMasternode.vin == CTxIn()) continue;
-                    // update ...
-                    mnv.addr = it->addr;
-                    mnv.vin1 = it->vin;
-                    mnv.vin2 = activeMasternode.vin;
-                    std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
-                                                        mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
-                    // ... and sign it
-                    if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeMasternode.keyMasternode)) {
-                        LogPrintf("MasternodeMan::ProcessVerifyReply -- SignMessage() failed\n");
-                        return;
-                    }
+        BOOST_FOREACH(CMasternode* pmn, mapMasternodes.FindByAddr(pnode->addr)) {
+            if(darkSendSigner.VerifyMessage(pmn->pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
+                // found it!
+                prealMasternode = pmn;
+                if(!pmn->IsPoSeVerified()) {
+                    pmn->DecreasePoSeBanScore();
+                    FlagMasternodeAsDirty(pmn->vin.prevout);
+                }
+                netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
+
+                // we can only broadcast it if we are an activated masternode
+                if(activeMasternode.vin == CTxIn()) continue;
+                // update ...
+                mnv.addr = pmn->addr;
+                mnv.vin1 = pmn->vin;
+                mnv.vin2 = activeMasternode.vin;
+                std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
+                                                    mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
+                // ... and sign it
+                if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeMasternode.keyMasternode)) {
+                    LogPrintf("MasternodeMan::ProcessVerifyReply -- SignMessage() failed\n");
+                    return;
+                }
 
-                    std::string strError;
+                std::string strError;
 
-                    if(!darkSendSigner.VerifyMessage(activeMasternode.pubKeyMasternode, mnv.vchSig2, strMessage2, strError)) {
-                        LogPrintf("MasternodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
-                        return;
-                    }
+                if(!darkSendSigner.VerifyMessage(activeMasternode.pubKeyMasternode, mnv.vchSig2, strMessage2, strError)) {
+                    LogPrintf("MasternodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
+                    return;
+                }
 
-                    mWeAskedForVerification[pnode->addr] = mnv;
-                    mnv.Relay();
+                mWeAskedForVerification[pnode->addr] = mnv;
+                mnv.Relay();
 
-                } else {
-                    vpMasternodesToBan.push_back(&(*it));
-                }
+            } else {
+                vpMasternodesToBan.push_back(pmn);
             }
-            ++it;
         }
         // no real masternode found?...
         if(!prealMasternode) {
@@ -1252,6 +1671,7 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
         // increase ban score for everyone else
         BOOST_FOREACH(CMasternode* pmn, vpMasternodesToBan) {
             pmn->IncreasePoSeBanScore();
+            FlagMasternodeAsDirty(pmn->vin.prevout);
             LogPrint("masternode", "CMasternodeMan::ProcessVerifyBroadcast -- increased PoSe ban score for %s addr %s, new score %d\n",
                      prealMasternode->vin.prevout.ToStringShort(), pnode->addr.ToString(), pmn->nPoSeBanScore);
         }
@@ -1351,12 +1771,13 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
 
         // increase ban score for everyone else with the same addr
         int nCount = 0;
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-            if(mn.addr != mnv.addr || mn.vin.prevout == mnv.vin1.prevout) continue;
-            mn.IncreasePoSeBanScore();
+        BOOST_FOREACH(CMasternode* pmn, mapMasternodes.FindByAddr(mnv.addr)) {
+            if(pmn->vin.prevout == mnv.vin1.prevout) continue;
+            pmn->IncreasePoSeBanScore();
+            FlagMasternodeAsDirty(pmn->vin.prevout);
             nCount++;
             LogPrint("masternode", "CMasternodeMan::ProcessVerifyBroadcast -- increased PoSe ban score for %s addr %s, new score %d\n",
-                     mn.vin.prevout.ToStringShort(), mn.addr.ToString(), mn.nPoSeBanScore);
+                     pmn->vin.prevout.ToStringShort(), pmn->addr.ToString(), pmn->nPoSeBanScore);
         }
         LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- PoSe score incresed for %d fake masternodes, addr %s\n",
                   nCount, pnode->addr.ToString());
@@ -1367,7 +1788,7 @@ std::string CMasternodeMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "Masternodes: " << (int)vMasternodes.size() <<
+    info << "Masternodes: " << (int)mapMasternodes.size() <<
          ", peers who asked us for Masternode list: " << (int)mAskedUsForMasternodeList.size() <<
          ", peers we asked for Masternode list: " << (int)mWeAskedForMasternodeList.size() <<
          ", entries in Masternode list we asked for: " << (int)mWeAskedForMasternodeListEntry.size() <<
@@ -1380,8 +1801,9 @@ std::string CMasternodeMan::ToString() const
 void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
 {
     LOCK(cs);
-    mapSeenMasternodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
+    AddSeenPing(mnb.lastPing);
     mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), std::make_pair(GetTime(), mnb)));
+    FlagBroadcastAsDirty(mnb.GetHash());
 
     LogPrintf("CMasternodeMan::UpdateMasternodeList -- masternode=%s  addr=%s\n", mnb.vin.prevout.ToStringShort(), mnb.addr.ToString());
 
@@ -1396,6 +1818,7 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         if(pmn->UpdateFromNewBroadcast(mnb)) {
             masternodeSync.AddedMasternodeList();
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
+            FlagBroadcastAsDirty(mnbOld.GetHash());
         }
     }
 }
@@ -1415,6 +1838,7 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
         if(GetTime() - mapSeenMasternodeBroadcast[hash].first > MASTERNODE_NEW_START_REQUIRED_SECONDS - MASTERNODE_MIN_MNP_SECONDS * 2) {
             LogPrint("masternode", "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- masternode=%s seen update\n", mnb.vin.prevout.ToStringShort());
             mapSeenMasternodeBroadcast[hash].first = GetTime();
+            FlagBroadcastAsDirty(hash);
             masternodeSync.AddedMasternodeList();
         }
         // did we ask this node for it?
@@ -1441,6 +1865,7 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
         return true;
     }
     mapSeenMasternodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), mnb)));
+    FlagBroadcastAsDirty(hash);
 
     LogPrint("masternode", "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- masternode=%s new\n", mnb.vin.prevout.ToStringShort());
 
@@ -1459,6 +1884,7 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
         }
         if(hash != mnbOld.GetHash()) {
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
+            FlagBroadcastAsDirty(mnbOld.GetHash());
         }
     } else {
         if(mnb.CheckOutpoint(nDos)) {
@@ -1491,23 +1917,41 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
 
 void CMasternodeMan::UpdateLastPaid()
 {
-    LOCK(cs);
-
     if(fLiteMode) return;
-    if(!pCurrentBlockIndex) return;
 
     static bool IsFirstRun = true;
-    // Do full scan on first run or if we are not a masternode
-    // (MNs should update this info on every block, so limited scan should be enough for them)
-    int nMaxBlocksToScanBack = (IsFirstRun || !fMasterNode) ? mnpayments.GetStorageLimit() : LAST_PAID_SCAN_BLOCKS;
+    const CBlockIndex* pindex;
+    int nMaxBlocksToScanBack;
+    {
+        LOCK(cs);
+        if(!pCurrentBlockIndex) return;
+        pindex = pCurrentBlockIndex;
+        // Do full scan on first run or if we are not a masternode
+        // (MNs should update this info on every block, so limited scan should be enough for them)
+        nMaxBlocksToScanBack = (IsFirstRun || !fMasterNode) ? mnpayments.GetStorageLimit() : LAST_PAID_SCAN_BLOCKS;
+    }
 
     // LogPrint("mnpayments", "CMasternodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
-    //                         pCurrentBlockIndex->nHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
+    //                         pindex->nHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        mn.UpdateLastPaid(pCurrentBlockIndex, nMaxBlocksToScanBack);
+    // the scan reads blocks from disk, so it runs on copies and the list is only locked to store what was found
+    std::vector<CMasternode> vecMasternodes = GetListView()->vecMasternodes;
+    BOOST_FOREACH(CMasternode& mn, vecMasternodes) {
+        mn.UpdateLastPaid(pindex, nMaxBlocksToScanBack);
     }
 
+    LOCK(cs);
+    BOOST_FOREACH(const CMasternode& mn, vecMasternodes) {
+        CMasternode* pmn = mapMasternodes.Find(mn.vin.prevout);
+        if(pmn && pmn->nBlockLastPaid < mn.nBlockLastPaid) {
+            pmn->nBlockLastPaid = mn.nBlockLastPaid;
+            pmn->nTimeLastPaid = mn.nTimeLastPaid;
+            FlagMasternodeAsDirty(pmn->vin.prevout);
+        }
+    }
+    // readers ask for this when they want the payment times, let them see them
+    UpdateListView();
+
     // every time is like the first time if winners list is not synced
     IsFirstRun = !masternodeSync.IsWinnersListSynced();
 }
@@ -1524,14 +1968,14 @@ void CMasternodeMan::CheckAndRebuildMasternodeIndex()
         return;
     }
 
-    if(indexMasternodes.GetSize() <= int(vMasternodes.size())) {
+    if(indexMasternodes.GetSize() <= int(mapMasternodes.size())) {
         return;
     }
 
     indexMasternodesOld = indexMasternodes;
     indexMasternodes.Clear();
-    for(size_t i = 0; i < vMasternodes.size(); ++i) {
-        indexMasternodes.AddMasternodeVIN(vMasternodes[i].vin);
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes) {
+        indexMasternodes.AddMasternodeVIN(mnpair.second.vin);
     }
 
     fIndexRebuilt = true;
@@ -1546,6 +1990,7 @@ void CMasternodeMan::UpdateWatchdogVoteTime(const CTxIn& vin)
         return;
     }
     pMN->UpdateWatchdogVoteTime();
+    FlagMasternodeAsDirty(vin.prevout);
     nLastWatchdogVoteTime = GetTime();
 }
 
@@ -1564,14 +2009,17 @@ bool CMasternodeMan::AddGovernanceVote(const CTxIn& vin, uint256 nGovernanceObje
         return false;
     }
     pMN->AddGovernanceVote(nGovernanceObjectHash);
+    FlagMasternodeAsDirty(vin.prevout);
     return true;
 }
 
 void CMasternodeMan::RemoveGovernanceObject(uint256 nGovernanceObjectHash)
 {
     LOCK(cs);
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        mn.RemoveGovernanceObject(nGovernanceObjectHash);
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes) {
+        if(!mnpair.second.mapGovernanceObjectsVotedOn.count(nGovernanceObjectHash)) continue;
+        mnpair.second.RemoveGovernanceObject(nGovernanceObjectHash);
+        FlagMasternodeAsDirty(mnpair.first);
     }
 }
 
@@ -1633,12 +2081,14 @@ void CMasternodeMan::SetMasternodeLastPing(const CTxIn& vin, const CMasternodePi
         return;
     }
     pMN->lastPing = mnp;
-    mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+    FlagMasternodeAsDirty(vin.prevout);
+    AddSeenPing(mnp);
 
     CMasternodeBroadcast mnb(*pMN);
     uint256 hash = mnb.GetHash();
     if(mapSeenMasternodeBroadcast.count(hash)) {
         mapSeenMasternodeBroadcast[hash].second.lastPing = mnp;
+        FlagBroadcastAsDirty(hash);
     }
 }
 
@@ -1653,28 +2103,312 @@ void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
         // normal wallet does not need to update this every block, doing update on rpc call should be enough
         UpdateLastPaid();
     }
+
+    // the list is not worth a snapshot before it is synced
+    if(masternodeSync.IsMasternodeListSynced()) {
+        UpdateListSnapshot(pindex->nHeight);
+    }
+}
+
+void CMasternodeMan::UpdateListSnapshot(int nHeight)
+{
+    LOCK(cs);
+
+    BOOST_FOREACH(PAIRTYPE(const COutPoint, CMasternode)& mnpair, mapMasternodes) {
+        uint256 hashMnb = CMasternodeBroadcast(mnpair.second).GetHash();
+        uint256 hashPing = mnpair.second.lastPing.GetHash();
+        std::map<COutPoint, snapshot_entry_t>::iterator it = mapSnapshotEntries.find(mnpair.first);
+        if(it == mapSnapshotEntries.end()) {
+            snapshot_entry_t entry;
+            entry.hashMnb = hashMnb;
+            entry.hashPing = hashPing;
+            entry.nHeightMnbChanged = nHeight;
+            entry.nHeightPingChanged = nHeight;
+            entry.nHeightSeen = nHeight;
+            mapSnapshotEntries.insert(std::make_pair(mnpair.first, entry));
+            mapSnapshotRemoved.erase(mnpair.first);
+            continue;
+        }
+        snapshot_entry_t& entry = it->second;
+        if(entry.hashMnb != hashMnb) {
+            entry.hashMnb = hashMnb;
+            entry.nHeightMnbChanged = nHeight;
+        }
+        if(entry.hashPing != hashPing) {
+            entry.hashPing = hashPing;
+            entry.nHeightPingChanged = nHeight;
+        }
+        entry.nHeightSeen = nHeight;
+    }
+
+    // the list is hashed by outpoint order, which mapSnapshotEntries is kept in
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << MNLIST_SNAPSHOT_VERSION;
+    std::map<COutPoint, snapshot_entry_t>::iterator it = mapSnapshotEntries.begin();
+    while(it != mapSnapshotEntries.end()) {
+        if(it->second.nHeightSeen != nHeight) {
+            mapSnapshotRemoved[it->first] = nHeight;
+            mapSnapshotEntries.erase(it++);
+            continue;
+        }
+        ss << it->first << it->second.hashMnb;
+        ++it;
+    }
+    hashSnapshotCurrent = ss.GetHash();
+    // a list that did not change keeps the height it first had, so that diffs include every ping since
+    mapSnapshotHeights.insert(std::make_pair(hashSnapshotCurrent, nHeight));
+
+    int nHeightOldest = nHeight;
+    std::map<uint256, int>::iterator itHeight = mapSnapshotHeights.begin();
+    while(itHeight != mapSnapshotHeights.end()) {
+        if(itHeight->second < nHeight - MNLIST_SNAPSHOT_DEPTH && itHeight->first != hashSnapshotCurrent) {
+            mapSnapshotHeights.erase(itHeight++);
+            continue;
+        }
+        nHeightOldest = std::min(nHeightOldest, itHeight->second);
+        ++itHeight;
+    }
+
+    std::map<COutPoint, int>::iterator itRemoved = mapSnapshotRemoved.begin();
+    while(itRemoved != mapSnapshotRemoved.end()) {
+        if(itRemoved->second <= nHeightOldest) {
+            mapSnapshotRemoved.erase(itRemoved++);
+        } else {
+            ++itRemoved;
+        }
+    }
+
+    LogPrint("masternode", "CMasternodeMan::UpdateListSnapshot -- nHeight=%d, snapshot=%s, %d snapshots kept\n",
+             nHeight, hashSnapshotCurrent.ToString(), (int)mapSnapshotHeights.size());
+}
+
+uint256 CMasternodeMan::GetListSnapshotHash()
+{
+    LOCK(cs);
+    return hashSnapshotCurrent;
+}
+
+uint256 CMasternodeMan::GetSyncedListSnapshotHash()
+{
+    LOCK(cs);
+    return hashSnapshotSynced;
+}
+
+bool CMasternodeMan::GetListDiff(const uint256& hashSnapshotBase, CMasternodeListDiff& diffRet)
+{
+    LOCK(cs);
+
+    if(hashSnapshotCurrent.IsNull()) return false;
+
+    // a null base is an empty list: every masternode is in the diff, none removed
+    int nHeightBase = -1;
+    if(!hashSnapshotBase.IsNull()) {
+        std::map<uint256, int>::iterator itHeight = mapSnapshotHeights.find(hashSnapshotBase);
+        if(itHeight == mapSnapshotHeights.end()) return false;
+        nHeightBase = itHeight->second;
+    }
+
+    diffRet = CMasternodeListDiff();
+    diffRet.hashSnapshotBase = hashSnapshotBase;
+    diffRet.hashSnapshot = hashSnapshotCurrent;
+
+    for(std::map<COutPoint, int>::iterator it = mapSnapshotRemoved.begin(); it != mapSnapshotRemoved.end() && nHeightBase >= 0; ++it) {
+        if(it->second > nHeightBase) {
+            diffRet.vecRemoved.push_back(it->first);
+        }
+    }
+    if(diffRet.GetEntryCount() > MNLIST_DIFF_MAX_ENTRIES) return false;
+
+    for(std::map<COutPoint, snapshot_entry_t>::iterator it = mapSnapshotEntries.begin(); it != mapSnapshotEntries.end(); ++it) {
+        const snapshot_entry_t& entry = it->second;
+        if(entry.nHeightMnbChanged <= nHeightBase && entry.nHeightPingChanged <= nHeightBase) continue;
+
+        // send what we have now, which may be newer than the snapshot
+        CMasternode* pmn = mapMasternodes.Find(it->first);
+        if(!pmn) continue;
+        if (pmn->addr.IsRFC1918() || pmn->addr.IsLocal()) continue; // do not send local network masternode
+        if (pmn->IsUpdateRequired()) continue; // do not send outdated masternodes
+
+        if(entry.nHeightMnbChanged > nHeightBase) {
+            diffRet.vecMnb.push_back(CMasternodeBroadcast(*pmn));
+        } else {
+            diffRet.vecMnp.push_back(pmn->lastPing);
+        }
+
+        if(diffRet.GetEntryCount() > MNLIST_DIFF_MAX_ENTRIES) return false;
+    }
+
+    return true;
+}
+
+void CMasternodeMan::ProcessListDiff(CNode* pfrom, const CMasternodeListDiff& diff)
+{
+    {
+        LOCK(cs);
+        // only take the one diff we asked this peer for, since the snapshot we asked with
+        std::map<CNetAddr, uint256>::iterator it = mWeAskedForMasternodeListDiff.find(pfrom->addr);
+        if(it == mWeAskedForMasternodeListDiff.end() || (!diff.hashSnapshot.IsNull() && diff.hashSnapshotBase != it->second)) {
+            LogPrint("masternode", "MNLISTDIFF -- Unrequested diff from peer %d\n", pfrom->id);
+            return;
+        }
+        mWeAskedForMasternodeListDiff.erase(it);
+        if(diff.GetEntryCount() > MNLIST_DIFF_MAX_ENTRIES) {
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+    }
+
+    if(diff.hashSnapshot.IsNull()) {
+        // our snapshot was unknown, fall back to the whole list
+        LogPrintf("MNLISTDIFF -- Peer %d does not know our snapshot, asking for the whole list\n", pfrom->id);
+        pfrom->PushMessage(NetMsgType::DSEG, CTxIn());
+        return;
+    }
+
+    LogPrintf("MNLISTDIFF -- Got %d removed, %d changed and %d pinged Masternodes from peer %d\n",
+              (int)diff.vecRemoved.size(), (int)diff.vecMnb.size(), (int)diff.vecMnp.size(), pfrom->id);
+
+    // A peer can't take masternodes off our list, but it can have us check them now
+    BOOST_FOREACH(const COutPoint& outpoint, diff.vecRemoved) {
+        CheckMasternode(CTxIn(outpoint), true);
+    }
+
+    BOOST_FOREACH(const CMasternodeBroadcast& mnb, diff.vecMnb) {
+        pending_message_t message;
+        message.fPing = false;
+        message.mnb = mnb;
+        pendingMessages.Queue(*this, pfrom, message);
+    }
+
+    BOOST_FOREACH(const CMasternodePing& mnp, diff.vecMnp) {
+        pending_message_t message;
+        message.fPing = true;
+        message.mnp = mnp;
+        pendingMessages.Queue(*this, pfrom, message);
+    }
+
+    // check them now rather than on the next tick, to know whether our list is at the peer's snapshot
+    ProcessPendingMessages();
+
+    LOCK(cs);
+    BOOST_FOREACH(const CMasternodeBroadcast& mnb, diff.vecMnb) {
+        CMasternode* pmn = Find(mnb.vin);
+        if(!pmn || pmn->sigTime < mnb.sigTime) {
+            LogPrintf("MNLISTDIFF -- Masternode %s from peer %d was not accepted, keeping snapshot %s\n",
+                      mnb.vin.prevout.ToStringShort(), pfrom->id, hashSnapshotSynced.ToString());
+            return;
+        }
+    }
+    hashSnapshotSynced = diff.hashSnapshot;
+}
+
+void CMasternodeMan::NotifyMasternodeStateChanged()
+{
+    LOCK(cs_listversion);
+    nListVersion++;
+}
+
+void CMasternodeMan::FlagMasternodeAsDirty(const COutPoint& outpoint)
+{
+    LOCK(cs_dirty);
+    setDirtyMasternodes.insert(outpoint);
+}
+
+void CMasternodeMan::FlagBroadcastAsDirty(const uint256& hash)
+{
+    LOCK(cs_dirty);
+    setDirtyBroadcasts.insert(hash);
+}
+
+void CMasternodeMan::FlagAllAsDirty()
+{
+    AssertLockHeld(cs);
+    LOCK(cs_dirty);
+    for(CMasternodeRegistry::const_iterator it = mapMasternodes.begin(); it != mapMasternodes.end(); ++it) {
+        setDirtyMasternodes.insert(it->first);
+    }
+    std::map<uint256, std::pair<int64_t, CMasternodeBroadcast> >::const_iterator itMnb = mapSeenMasternodeBroadcast.begin();
+    for(; itMnb != mapSeenMasternodeBroadcast.end(); ++itMnb) {
+        setDirtyBroadcasts.insert(itMnb->first);
+    }
+    std::map<uint256, CMasternodePing>::const_iterator itMnp = mapSeenMasternodePing.begin();
+    for(; itMnp != mapSeenMasternodePing.end(); ++itMnp) {
+        setDirtyPings.insert(itMnp->first);
+    }
+}
+
+masternode_list_view_t CMasternodeMan::GetListView()
+{
+    masternode_list_view_t pView;
+    {
+        LOCK(cs_listview);
+        pView = pListView;
+    }
+    if(pView) {
+        int64_t nListVersionNow;
+        {
+            LOCK(cs_listversion);
+            nListVersionNow = nListVersion;
+        }
+        if(pView->nListVersion == nListVersionNow && GetTime() - pView->nTimeCreated < MASTERNODE_CHECK_SECONDS) {
+            return pView;
+        }
+        // the list is being changed, readers see the changes once they are done
+        TRY_LOCK(cs, lockList);
+        if(!lockList) return pView;
+        return UpdateListView();
+    }
+    LOCK(cs);
+    return UpdateListView();
+}
+
+masternode_list_view_t CMasternodeMan::UpdateListView()
+{
+    AssertLockHeld(cs);
+
+    boost::shared_ptr<CMasternodeListView> pView(new CMasternodeListView());
+    {
+        LOCK(cs_listversion);
+        pView->nListVersion = nListVersion;
+    }
+    pView->nTimeCreated = GetTime();
+    pView->vecMasternodes = mapMasternodes.GetAll();
+    for(size_t i = 0; i < pView->vecMasternodes.size(); i++) {
+        // lowest outpoint comes first and stays
+        pView->mapByPubKey.insert(std::make_pair(pView->vecMasternodes[i].pubKeyMasternode, i));
+    }
+
+    LOCK(cs_listview);
+    pListView = pView;
+    return pListView;
+}
+
+void CMasternodeMan::ReindexMasternode(CMasternode* pmn, const CPubKey& pubKeyMasternodeOld, const CService& addrOld)
+{
+    LOCK(cs);
+    mapMasternodes.Reindex(pmn, pubKeyMasternodeOld, addrOld);
 }
 
 void CMasternodeMan::NotifyMasternodeUpdates()
 {
     // Avoid double locking
-    bool fMasternodesAddedLocal = false;
+    std::vector<COutPoint> vecMasternodesAddedLocal;
     bool fMasternodesRemovedLocal = false;
     {
         LOCK(cs);
-        fMasternodesAddedLocal = fMasternodesAdded;
+        vecMasternodesAddedLocal.swap(vecMasternodesAdded);
         fMasternodesRemovedLocal = fMasternodesRemoved;
     }
 
-    if(fMasternodesAddedLocal) {
-        governance.CheckMasternodeOrphanObjects();
-        governance.CheckMasternodeOrphanVotes();
+    // only the orphans waiting for these masternodes are looked at
+    if(!vecMasternodesAddedLocal.empty()) {
+        governance.CheckMasternodeOrphanObjects(vecMasternodesAddedLocal);
+        governance.CheckMasternodeOrphanVotes(vecMasternodesAddedLocal);
     }
     if(fMasternodesRemovedLocal) {
         governance.UpdateCachesAndClean();
     }
 
     LOCK(cs);
-    fMasternodesAdded = false;
     fMasternodesRemoved = false;
 }
@@ -6,15 +6,158 @@
 #ifndef MASTERNODEMAN_H
 #define MASTERNODEMAN_H
 
+#include "expiryqueue.h"
 #include "masternode.h"
 #include "sync.h"
 
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
 using namespace std;
 
 class CMasternodeMan;
 
 extern CMasternodeMan mnodeman;
 
+/** Run a masternode signature check thread */
+void ThreadMasternodeSignatureCheck();
+
+/** A masternode message signature to verify on the signature check threads */
+class CMasternodeSignatureCheck
+{
+private:
+    CPubKey pubKey;
+    std::vector<unsigned char> vchSig;
+    uint256 hash;
+    // where the result goes, one byte per check so that threads don't share it
+    char* pfValid;
+
+public:
+    CMasternodeSignatureCheck() : pfValid(NULL) {}
+    CMasternodeSignatureCheck(const CPubKey& pubKeyIn, const std::vector<unsigned char>& vchSigIn, const uint256& hashIn, char* pfValidIn) :
+        pubKey(pubKeyIn), vchSig(vchSigIn), hash(hashIn), pfValid(pfValidIn) {}
+
+    /// Always succeeds: the result is stored, not returned, as every check is wanted separately
+    bool operator()();
+
+    void swap(CMasternodeSignatureCheck& check) {
+        std::swap(pubKey, check.pubKey);
+        vchSig.swap(check.vchSig);
+        std::swap(hash, check.hash);
+        std::swap(pfValid, check.pfValid);
+    }
+};
+
+/**
+ * Signatures of masternode messages verified all at once, spread over the
+ * signature check threads, before the messages themselves are processed one
+ * by one. Processing a message then finds its signature verified already.
+ */
+class CMasternodeSignatureBatch
+{
+private:
+    struct signature_t
+    {
+        CPubKey pubKey;
+        std::vector<unsigned char> vchSig;
+        uint256 hash;
+    };
+
+    CCriticalSection cs;
+
+    std::vector<signature_t> vecQueued;
+
+    std::set<uint256> setVerified;
+
+    static uint256 GetSignatureHash(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash);
+
+public:
+    /// Queue a signature to be verified
+    void Add(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash);
+
+    /// Verify all queued signatures and remember the valid ones
+    void Verify();
+
+    /// Whether this signature was found valid by Verify(); it is forgotten after that
+    bool IsVerified(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash);
+
+    void Clear();
+};
+
+/**
+ * Masternode messages from peers, queued and then processed in batches: the
+ * signatures of a whole batch are verified together by a
+ * CMasternodeSignatureBatch first, then its messages are processed one by one.
+ * A batch is processed once nBatchSize messages are waiting, the rest by the
+ * next call to Process(). The owner provides
+ *
+ *   void AddPendingSignatures(const std::vector<Message>& vecMessages, CMasternodeSignatureBatch& batch);
+ *   void ProcessPendingMessage(CNode* pfrom, Message& message);
+ */
+template <typename Owner, typename Message, size_t nBatchSize>
+class CPendingMessageQueue
+{
+private:
+    // protects vecNodes and vecMessages
+    CCriticalSection cs_pending;
+    std::vector<CNode*> vecNodes;
+    std::vector<Message> vecMessages;
+
+    // held while a batch is processed, so batches go one after another
+    CCriticalSection cs_batch;
+    CMasternodeSignatureBatch signatureBatch;
+
+public:
+    /// Queue a message from this peer, processing the batch if it is full
+    void Queue(Owner& owner, CNode* pfrom, const Message& message)
+    {
+        bool fBatchFull;
+        {
+            LOCK(cs_pending);
+            vecNodes.push_back(pfrom->AddRef());
+            vecMessages.push_back(message);
+            fBatchFull = vecMessages.size() >= nBatchSize;
+        }
+        if(fBatchFull) {
+            Process(owner);
+        }
+    }
+
+    /// Process the queued messages, returns how many there were
+    size_t Process(Owner& owner)
+    {
+        LOCK(cs_batch);
+
+        std::vector<CNode*> vecNodesBatch;
+        std::vector<Message> vecMessagesBatch;
+        {
+            LOCK(cs_pending);
+            vecNodesBatch.swap(vecNodes);
+            vecMessagesBatch.swap(vecMessages);
+        }
+        if(vecMessagesBatch.empty()) return 0;
+
+        owner.AddPendingSignatures(vecMessagesBatch, signatureBatch);
+        // the expensive part, done without holding the owner's locks
+        signatureBatch.Verify();
+
+        for(size_t i = 0; i < vecMessagesBatch.size(); ++i) {
+            owner.ProcessPendingMessage(vecNodesBatch[i], vecMessagesBatch[i]);
+            vecNodesBatch[i]->Release();
+        }
+
+        // forget signatures of messages that turned out not to need them
+        signatureBatch.Clear();
+        return vecMessagesBatch.size();
+    }
+
+    /// Whether the batch being processed verified this signature of the hash already
+    bool IsVerified(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash)
+    {
+        return signatureBatch.IsVerified(pubKey, vchSig, hash);
+    }
+};
+
 /**
  * Provides a forward and reverse index between MN vin's and integers.
  *
@@ -79,6 +222,183 @@ private:
 
 };
 
+/** Salted hashes of the keys masternodes are looked up by */
+class CMasternodeRegistryHasher
+{
+private:
+    uint256 salt;
+
+public:
+    CMasternodeRegistryHasher();
+
+    size_t operator()(const COutPoint& outpoint) const;
+    size_t operator()(const CPubKey& pubKey) const;
+    size_t operator()(const CService& addr) const;
+};
+
+/**
+ * The masternode list: masternodes by collateral outpoint, with indexes by
+ * masternode key and by address.
+ *
+ * Masternodes are allocated individually and never move, so a CMasternode*
+ * stays valid until that masternode itself is removed. When the key or the
+ * address of a listed masternode changes, Reindex() must be called for it.
+ */
+class CMasternodeRegistry
+{
+public: // Types
+    typedef boost::unordered_map<COutPoint, CMasternode, CMasternodeRegistryHasher> map_t;
+
+    typedef map_t::iterator iterator;
+
+    typedef map_t::const_iterator const_iterator;
+
+private:
+    typedef boost::unordered_multimap<CPubKey, CMasternode*, CMasternodeRegistryHasher> pubkey_index_t;
+
+    typedef boost::unordered_multimap<CService, CMasternode*, CMasternodeRegistryHasher> addr_index_t;
+
+    map_t                mapMasternodes;
+
+    pubkey_index_t       mapByPubKey;
+
+    addr_index_t         mapByAddr;
+
+    void AddToIndexes(CMasternode* pmn);
+
+    void RemoveFromIndexes(CMasternode* pmn, const CPubKey& pubKeyMasternode, const CService& addr);
+
+public:
+    iterator begin() { return mapMasternodes.begin(); }
+    const_iterator begin() const { return mapMasternodes.begin(); }
+    iterator end() { return mapMasternodes.end(); }
+    const_iterator end() const { return mapMasternodes.end(); }
+
+    size_t size() const {
+        return mapMasternodes.size();
+    }
+
+    bool empty() const {
+        return mapMasternodes.empty();
+    }
+
+    /// Add a masternode unless one with the same collateral is listed already; returns the listed one or NULL
+    CMasternode* Add(const CMasternode& mn);
+
+    /// Remove a masternode, returning the position of the next one
+    iterator Erase(iterator it);
+
+    void Clear();
+
+    CMasternode* Find(const COutPoint& outpoint);
+
+    /// The masternode using this key (the one with the lowest outpoint if several do)
+    CMasternode* Find(const CPubKey& pubKeyMasternode);
+
+    /// All masternodes announced at this address
+    std::vector<CMasternode*> FindByAddr(const CService& addr);
+
+    /// Update the indexes after the key or address of a listed masternode changed from the given ones
+    void Reindex(CMasternode* pmn, const CPubKey& pubKeyMasternodeOld, const CService& addrOld);
+
+    /// Copies of all masternodes, ordered by collateral outpoint
+    std::vector<CMasternode> GetAll() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    /// Stored as a plain vector of masternodes, as before there were indexes
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        std::vector<CMasternode> vMasternodes;
+        if(!ser_action.ForRead()) {
+            vMasternodes = GetAll();
+        }
+        READWRITE(vMasternodes);
+        if(ser_action.ForRead()) {
+            Clear();
+            for(size_t i = 0; i < vMasternodes.size(); i++) {
+                Add(vMasternodes[i]);
+            }
+        }
+    }
+};
+
+/**
+ * The masternodes added, changed or removed since a snapshot of the list,
+ * sent in reply to getmnlistd so that a peer that had the list before does
+ * not have to fetch all of it again.
+ */
+class CMasternodeListDiff
+{
+public:
+    /// The snapshot the diff starts from; null for the whole list, on a first sync
+    uint256 hashSnapshotBase;
+    /// The snapshot the peer's list is at now; null if the peer did not know the base snapshot and the whole list has to be asked for with dseg
+    uint256 hashSnapshot;
+    /// Masternodes gone from the list
+    std::vector<COutPoint> vecRemoved;
+    /// Masternodes added or announced again, with their last ping
+    std::vector<CMasternodeBroadcast> vecMnb;
+    /// Last pings of the other masternodes that pinged
+    std::vector<CMasternodePing> vecMnp;
+
+    CMasternodeListDiff() :
+        hashSnapshotBase(),
+        hashSnapshot(),
+        vecRemoved(),
+        vecMnb(),
+        vecMnp()
+        {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(hashSnapshotBase);
+        READWRITE(hashSnapshot);
+        READWRITE(vecRemoved);
+        READWRITE(vecMnb);
+        READWRITE(vecMnp);
+    }
+
+    size_t GetEntryCount() const {
+        return vecRemoved.size() + vecMnb.size() + vecMnp.size();
+    }
+};
+
+/**
+ * An immutable copy of the masternode list, for readers that should not
+ * wait for CMasternodeMan::cs while the list is checked or updated.
+ * See CMasternodeMan::GetListView().
+ */
+class CMasternodeListView
+{
+public:
+    /// All masternodes, ordered by collateral outpoint
+    std::vector<CMasternode> vecMasternodes;
+    /// Position in vecMasternodes of the masternode using each key (the one with the lowest outpoint if several do)
+    std::map<CPubKey, size_t> mapByPubKey;
+    /// CMasternodeMan::nListVersion the copy was made at
+    int64_t nListVersion;
+    int64_t nTimeCreated;
+
+    CMasternodeListView() :
+        vecMasternodes(),
+        mapByPubKey(),
+        nListVersion(0),
+        nTimeCreated(0)
+        {}
+
+    const CMasternode* Find(const COutPoint& outpoint) const;
+    const CMasternode* Find(const CPubKey& pubKeyMasternode) const;
+
+    int CountMasternodes(int nProtocolVersion) const;
+    int CountEnabled(int nProtocolVersion) const;
+};
+
+typedef boost::shared_ptr<const CMasternodeListView> masternode_list_view_t;
+
 class CMasternodeMan
 {
 public:
@@ -101,6 +421,7 @@ private:
     static const int LAST_PAID_SCAN_BLOCKS      = 100;
 
     static const int MIN_POSE_PROTO_VERSION     = 70699;
+    static const int MIN_MNLISTDIFF_PROTO_VERSION = 70702;
     static const int MAX_POSE_CONNECTIONS       = 10;
     static const int MAX_POSE_RANK              = 10;
     static const int MAX_POSE_BLOCKS            = 38; //BBoBB CFRM
@@ -111,6 +432,52 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 20;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 2880;
 
+    static const size_t MAX_RANK_TABLES             = 16;
+
+    /// Which masternodes a rank table includes
+    enum rank_filter_e {
+        RANK_ENABLED,           // IsEnabled()
+        RANK_VALID_FOR_PAYMENT, // IsValidForPayment() while SPORK_14_REQUIRE_SENTINEL_FLAG is off
+        RANK_ANY
+    };
+
+    /// Masternodes ranked for one block, best first, and the rank of each of them
+    struct rank_table_t
+    {
+        uint256 blockHash;
+        std::vector<CMasternode*> vecRanked;
+        std::map<COutPoint, int> mapRanks;
+    };
+
+    /// (height, (minimum protocol, filter))
+    typedef std::pair<int, std::pair<int, int> > rank_key_t;
+
+    static const size_t PENDING_MESSAGES_BATCH_SIZE = 128;
+
+    static const int MNLIST_SNAPSHOT_VERSION    = 1;
+    /// How far back (in blocks) a list diff may start
+    static const int MNLIST_SNAPSHOT_DEPTH      = 576;
+    /// A diff larger than this is not much cheaper than the whole list
+    static const size_t MNLIST_DIFF_MAX_ENTRIES = 2000;
+
+    /// A masternode as of the last list snapshot, and the snapshots it last changed in
+    struct snapshot_entry_t
+    {
+        uint256 hashMnb;
+        uint256 hashPing;
+        int nHeightMnbChanged;
+        int nHeightPingChanged;
+        int nHeightSeen;
+    };
+
+    /// A mnb or mnp message waiting for its signatures to be verified
+    struct pending_message_t
+    {
+        bool fPing;
+        CMasternodeBroadcast mnb;
+        CMasternodePing mnp;
+    };
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -118,12 +485,14 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
-    // map to hold all MNs
-    std::vector<CMasternode> vMasternodes;
+    // all MNs, by collateral outpoint, key and address
+    CMasternodeRegistry mapMasternodes;
     // who's asked for the Masternode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForMasternodeList;
     // who we asked for the Masternode list and the last time
     std::map<CNetAddr, int64_t> mWeAskedForMasternodeList;
+    // who we asked for a diff of the Masternode list and since which snapshot, until they reply
+    std::map<CNetAddr, uint256> mWeAskedForMasternodeListDiff;
     // which Masternodes we've asked for
     std::map<COutPoint, std::map<CNetAddr, int64_t> > mWeAskedForMasternodeListEntry;
     // who we asked for the masternode verification
@@ -143,8 +512,8 @@ private:
     /// Set when index has been rebuilt, clear when read
     bool fIndexRebuilt;
 
-    /// Set when masternodes are added, cleared when CGovernanceManager is notified
-    bool fMasternodesAdded;
+    /// Outpoints of the masternodes added since CGovernanceManager was last notified
+    std::vector<COutPoint> vecMasternodesAdded;
 
     /// Set when masternodes are removed, cleared when CGovernanceManager is notified
     bool fMasternodesRemoved;
@@ -153,7 +522,60 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    /// Rank tables computed since the masternode list last changed
+    std::map<rank_key_t, rank_table_t> mapRankTables;
+    int64_t nRankTablesListVersion;
+
+    // protects nListVersion, which masternodes also bump without holding cs
+    mutable CCriticalSection cs_listversion;
+    /// Bumped whenever masternodes are added or removed or change their state
+    int64_t nListVersion;
+
+    // protects the dirty sets, which masternodes also update without holding cs
+    CCriticalSection cs_dirty;
+    /// Masternodes, seen broadcasts and seen pings that were added, changed or removed since CMasternodeDB last wrote them
+    std::set<COutPoint> setDirtyMasternodes;
+    std::set<uint256> setDirtyBroadcasts;
+    std::set<uint256> setDirtyPings;
+
+    // the list as of the last snapshot, by collateral outpoint
+    std::map<COutPoint, snapshot_entry_t> mapSnapshotEntries;
+    // masternodes removed since the oldest snapshot kept, and the snapshot they were removed in
+    std::map<COutPoint, int> mapSnapshotRemoved;
+    // height of the first snapshot with each hash, for the last MNLIST_SNAPSHOT_DEPTH blocks
+    std::map<uint256, int> mapSnapshotHeights;
+    uint256 hashSnapshotCurrent;
+    // the snapshot of the peer that last brought our list up to date, to ask for the diff since;
+    // null until a diff was accepted, which makes the first request one for the whole list
+    uint256 hashSnapshotSynced;
+
+    // mapSeenMasternodePing by when the pings expire
+    expiryqueue<uint256> queueSeenPingExpiry;
+
+    // protects pListView
+    CCriticalSection cs_listview;
+    /// The list as of the last time it was read after a change
+    masternode_list_view_t pListView;
+
+    /// Make a new view of the list for readers, cs must be held
+    masternode_list_view_t UpdateListView();
+
+    CPendingMessageQueue<CMasternodeMan, pending_message_t, PENDING_MESSAGES_BATCH_SIZE> pendingMessages;
+
     friend class CMasternodeSync;
+    friend class CMasternodeDB;
+    friend class CPendingMessageQueue<CMasternodeMan, pending_message_t, PENDING_MESSAGES_BATCH_SIZE>;
+
+    void AddPendingSignatures(const std::vector<pending_message_t>& vecMessages, CMasternodeSignatureBatch& batch);
+    void ProcessPendingMessage(CNode* pfrom, pending_message_t& message);
+    void ProcessAnnounce(CNode* pfrom, CMasternodeBroadcast& mnb);
+    void ProcessPing(CNode* pfrom, CMasternodePing& mnp);
+
+    /// Rank table for the block at nBlockHeight (with hash blockHash), built on first use
+    const rank_table_t& GetRankTable(int nBlockHeight, const uint256& blockHash, int nMinProtocol, int nFilter);
+
+    /// Flag every masternode and seen message as dirty, cs must be held
+    void FlagAllAsDirty();
 
 public:
     // Keep track of all broadcasts I've seen
@@ -180,7 +602,7 @@ public:
             READWRITE(strVersion);
         }
 
-        READWRITE(vMasternodes);
+        READWRITE(mapMasternodes);
         READWRITE(mAskedUsForMasternodeList);
         READWRITE(mWeAskedForMasternodeList);
         READWRITE(mWeAskedForMasternodeListEntry);
@@ -191,7 +613,15 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
+        if(ser_action.ForRead()) {
+            RebuildSeenPingExpiry();
+        }
         READWRITE(indexMasternodes);
+        READWRITE(hashSnapshotSynced);
+        if(ser_action.ForRead()) {
+            NotifyMasternodeStateChanged();
+            FlagAllAsDirty();
+        }
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
@@ -215,6 +645,12 @@ public:
     /// Clear Masternode vector
     void Clear();
 
+    /// Remember a ping as seen until it expires, cs must be held
+    void AddSeenPing(const CMasternodePing& mnp);
+    /// Forget a seen ping
+    void EraseSeenPing(const uint256& hash);
+    void RebuildSeenPingExpiry();
+
     /// Count Masternodes filtered by nProtocolVersion.
     /// Masternode nProtocolVersion should match or be above the one specified in param here.
     int CountMasternodes(int nProtocolVersion = -1);
@@ -225,9 +661,10 @@ public:
     /// Count Masternodes by network type - NET_IPV4, NET_IPV6, NET_TOR
     // int CountByIP(int nNetworkType);
 
+    /// Ask the node for the list, or only for what changed since our last snapshot from the network if it can tell
     void DsegUpdate(CNode* pnode);
 
-    /// Find an entry
+    /// Find an entry; where several masternodes match, the one with the lowest outpoint
     CMasternode* Find(const CScript &payee);
     CMasternode* Find(const CTxIn& vin);
     CMasternode* Find(const CPubKey& pubKeyMasternode);
@@ -281,6 +718,9 @@ public:
 
     bool Has(const CTxIn& vin);
 
+    /// Like Has() but checks the list itself rather than the view, for when a stale answer would lose data
+    bool HasLive(const CTxIn& vin);
+
     masternode_info_t GetMasternodeInfo(const CTxIn& vin);
 
     masternode_info_t GetMasternodeInfo(const CPubKey& pubKeyMasternode);
@@ -294,9 +734,17 @@ public:
     CMasternode* FindRandomNotInVec(const std::vector<CTxIn> &vecToExclude, int nProtocolVersion = -1);
 
     std::vector<CMasternode> GetFullMasternodeVector() {
-        return vMasternodes;
+        return GetListView()->vecMasternodes;
     }
 
+    /**
+     * The masternode list as of its last change, or as of before the changes
+     * being made while another thread holds cs, so that readers don't have
+     * to wait for them. Informational fields like the last ping and payment
+     * times can be up to MASTERNODE_CHECK_SECONDS old.
+     */
+    masternode_list_view_t GetListView();
+
     std::vector<std::pair<int, CMasternode> > GetMasternodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
     int GetMasternodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
     CMasternode* GetMasternodeByRank(int nRank, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
@@ -305,6 +753,10 @@ public:
     std::pair<CService, std::set<uint256> > PopScheduledMnbRequestConnection();
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    /// Process the queued mnb and mnp messages, verifying their signatures in parallel first
+    void ProcessPendingMessages();
+    /// Whether the batch being processed verified this signature of the hash already
+    bool IsSignatureVerified(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const uint256& hash);
 
     void DoFullVerificationStep();
     void CheckSameAddr();
@@ -315,7 +767,7 @@ public:
 
     /// Return the number of (unique) Masternodes
     int size() {
-        return vMasternodes.size();
+        return mapMasternodes.size();
     }
 
     std::string ToString() const;
@@ -362,6 +814,38 @@ public:
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
 
+    /// Take a snapshot of the list at this height, noting which masternodes changed since the last one
+    void UpdateListSnapshot(int nHeight);
+    uint256 GetListSnapshotHash();
+    /// The snapshot we will ask peers for the diff since
+    uint256 GetSyncedListSnapshotHash();
+    /**
+     * What changed since the given snapshot, or the whole list for a null one;
+     * false if it is unknown, too old or the diff too large
+     */
+    bool GetListDiff(const uint256& hashSnapshotBase, CMasternodeListDiff& diffRet);
+    /// Apply a diff received in reply to our getmnlistd
+    void ProcessListDiff(CNode* pfrom, const CMasternodeListDiff& diff);
+
+    /**
+     * Called when masternodes are added or removed or change their state,
+     * which invalidates the cached rank tables. May be called with or without
+     * holding the CMasternodeMan::cs mutex.
+     */
+    void NotifyMasternodeStateChanged();
+
+    /**
+     * Called when a masternode or a seen broadcast is added, changed or
+     * removed, so that the masternode database writes or erases its record
+     * next time. May be called with or without holding the CMasternodeMan::cs
+     * mutex.
+     */
+    void FlagMasternodeAsDirty(const COutPoint& outpoint);
+    void FlagBroadcastAsDirty(const uint256& hash);
+
+    /// Called when the key or address of a listed masternode changed from the given ones
+    void ReindexMasternode(CMasternode* pmn, const CPubKey& pubKeyMasternodeOld, const CService& addrOld);
+
     /**
      * Called to notify CGovernanceManager that the masternode index has been updated.
      * Must be called while not holding the CMasternodeMan::cs mutex
@@ -382,12 +382,25 @@ void static MueMiner(const CChainParams& chainparams)
             {
                 unsigned int nHashesDone = 0;
 
+                // Try nonces a batch at a time so the X11 stages can work on several headers together.
+                static const unsigned int nBatch = X11_BATCH_SIZE;
+                CBlockHeader vHeaders[nBatch];
+                uint256 vHashes[nBatch];
                 uint256 hash;
                 while (true)
                 {
-                    hash = pblock->GetHash();
-                    if (UintToArith256(hash) <= hashTarget)
+                    for (unsigned int i = 0; i < nBatch; i++) {
+                        vHeaders[i] = pblock->GetBlockHeader();
+                        vHeaders[i].nNonce = pblock->nNonce + i;
+                    }
+                    HashX11Batch(vHeaders, nBatch, vHashes);
+                    unsigned int nFound = 0;
+                    while (nFound < nBatch && UintToArith256(vHashes[nFound]) > hashTarget)
+                        nFound++;
+                    if (nFound < nBatch)
                     {
+                        pblock->nNonce += nFound;
+                        hash = vHashes[nFound];
                         SetThreadPriority(THREAD_PRIORITY_NORMAL);
                         LogPrintf("MonetaryUnitMiner:\n  proof-of-work found\n  hash: %s\n  target: %s\n", hash.GetHex(), hashTarget.GetHex());
                         ProcessBlockFound(pblock, chainparams);
@@ -399,9 +412,9 @@ void static MueMiner(const CChainParams& chainparams)
 
                         break;
                     }
-                    pblock->nNonce += 1;
-                    nHashesDone += 1;
-                    if ((pblock->nNonce & 0xFF) == 0)
+                    pblock->nNonce += nBatch;
+                    nHashesDone += nBatch;
+                    if ((pblock->nNonce & 0xFF) < nBatch)
                         break;
                 }
 
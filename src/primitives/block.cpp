@@ -9,11 +9,42 @@
 #include "tinyformat.h"
 #include "utilstrencodings.h"
 #include "crypto/common.h"
+#include "crypto/x11.h"
 
 uint256 CBlockHeader::GetHash() const {
     return HashX11(BEGIN(nVersion), END(nNonce));
 }
 
+void HashX11Batch(const CBlockHeader* headers, size_t n, uint256* out)
+{
+    unsigned char hashes[X11_BATCH_SIZE * X11_OUTPUT_SIZE];
+    while (n > 0) {
+        size_t nChunk = n < X11_BATCH_SIZE ? n : X11_BATCH_SIZE;
+        // Same bytes as GetHash(): the header fields are laid out back to back.
+        X11Batch((const unsigned char*)BEGIN(headers->nVersion), END(headers->nNonce) - BEGIN(headers->nVersion),
+                 sizeof(CBlockHeader), nChunk, hashes);
+        for (size_t i = 0; i < nChunk; i++)
+            memcpy(out[i].begin(), hashes + i * X11_OUTPUT_SIZE, out[i].size());
+        headers += nChunk;
+        out += nChunk;
+        n -= nChunk;
+    }
+}
+
+uint256 CBlock::GetHash() const
+{
+    // A block read from disk is hashed for its PoW check, compared against the
+    // index, checked again by CheckBlock, looked up in mapBlockIndex and so on.
+    // Comparing 80 bytes is nothing next to X11, and means any change to the
+    // header (e.g. the miner bumping nNonce) is picked up without having to
+    // invalidate anything.
+    if (hashCached.IsNull() || memcmp(BEGIN(nVersion), BEGIN(headerHashed.nVersion), END(nNonce) - BEGIN(nVersion)) != 0) {
+        headerHashed = GetBlockHeader();
+        hashCached = CBlockHeader::GetHash();
+    }
+    return hashCached;
+}
+
 std::string CBlock::ToString() const {
     std::stringstream s;
     s << strprintf(
@@ -9,6 +9,7 @@
 #include "darksend.h"
 #include "governance.h"
 #include "governance-vote.h"
+#include "governance-votedb.h"
 #include "governance-classes.h"
 #include "init.h"
 #include "main.h"
@@ -704,23 +705,29 @@ UniValue gobject(const UniValue& params, bool fHelp)
 
         // FIND OBJECT USER IS LOOKING FOR
 
-        LOCK(governance.cs);
+        {
+            LOCK(governance.cs);
 
-        CGovernanceObject* pGovObj = governance.FindGovernanceObject(hash);
+            CGovernanceObject* pGovObj = governance.FindGovernanceObject(hash);
 
-        if(pGovObj == NULL) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown governance-hash");
+            if(pGovObj == NULL) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown governance-hash");
+            }
         }
 
         // REPORT RESULTS TO USER
 
         UniValue bResult(UniValue::VOBJ);
 
-        // GET MATCHING VOTES BY HASH, THEN SHOW USERS VOTE INFORMATION
+        // READ THE VOTES FROM THE VOTE DATABASE ONE AT A TIME, THEN SHOW USERS VOTE INFORMATION
 
-        std::vector<CGovernanceVote> vecVotes = governance.GetMatchingVotes(hash);
-        BOOST_FOREACH(CGovernanceVote vote, vecVotes) {
-            bResult.push_back(Pair(vote.GetHash().ToString(),  vote.ToString()));
+        if(pgovernancevotedb) {
+            for(CGovernanceVoteCursor cursor(*pgovernancevotedb, hash); cursor.Valid(); cursor.Next()) {
+                CGovernanceVote vote;
+                if(cursor.GetVote(vote)) {
+                    bResult.push_back(Pair(vote.GetHash().ToString(),  vote.ToString()));
+                }
+            }
         }
 
         return bResult;
@@ -5,93 +5,158 @@
 
 #include "sigcache.h"
 
-#include "memusage.h"
+#include "crypto/common.h"
 #include "pubkey.h"
 #include "random.h"
-#include "uint256.h"
 #include "util.h"
 
-#include <boost/thread.hpp>
-#include <boost/unordered_set.hpp>
+#include <string.h>
 
-namespace {
-
-/**
- * We're hashing a nonce into the entries themselves, so we don't need extra
- * blinding in the set hash computation.
- */
-class CSignatureCacheHasher
+CSignatureCache::CSignatureCache(size_t nMaxBytes)
 {
-public:
-    size_t operator()(const uint256& key) const {
-        return key.GetCheapHash();
+    GetRandBytes(nonce.begin(), 32);
+
+    nBuckets = nMaxBytes / (SHARDS * WAYS * (sizeof(uint256) + 1));
+    for (unsigned int i = 0; i < SHARDS; i++) {
+        Shard& shard = shards[i];
+        shard.pentries = nBuckets ? new uint256[nBuckets * WAYS] : NULL;
+        shard.pgens = nBuckets ? new unsigned char[nBuckets * WAYS] : NULL;
+        if (nBuckets)
+            memset(shard.pgens, 0, nBuckets * WAYS);
+        shard.nGeneration = 1;
+        shard.nWrittenThisGeneration = 0;
+        shard.nEntries = 0;
+        shard.nHits = 0;
+        shard.nMisses = 0;
     }
-};
-
-/**
- * Valid signature cache, to avoid doing expensive ECDSA signature checking
- * twice for every transaction (once when accepted into memory pool, and
- * again when accepted into the block chain)
- */
-class CSignatureCache
+}
+
+CSignatureCache::~CSignatureCache()
 {
-private:
-    //! Entries are SHA256(nonce || signature hash || public key || signature):
-    uint256 nonce;
-    typedef boost::unordered_set<uint256, CSignatureCacheHasher> map_type;
-    map_type setValid;
-    boost::shared_mutex cs_sigcache;
-
-
-public:
-    CSignatureCache()
-    {
-        GetRandBytes(nonce.begin(), 32);
+    for (unsigned int i = 0; i < SHARDS; i++) {
+        delete[] shards[i].pentries;
+        delete[] shards[i].pgens;
     }
+}
 
-    void
-    ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
-    {
-        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(&pubkey[0], pubkey.size()).Write(&vchSig[0], vchSig.size()).Finalize(entry.begin());
+void CSignatureCache::ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const
+{
+    CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(&pubkey[0], pubkey.size()).Write(&vchSig[0], vchSig.size()).Finalize(entry.begin());
+}
+
+CSignatureCache::Shard& CSignatureCache::ShardFor(const uint256& entry, size_t& nSlot)
+{
+    // Entries are salted hashes, so any of their bits are as good as random.
+    uint64_t nBits = ReadLE64(entry.begin());
+    nSlot = (nBuckets ? (nBits / SHARDS) % nBuckets : 0) * WAYS;
+    return shards[nBits % SHARDS];
+}
+
+int CSignatureCache::Find(const Shard& shard, size_t nSlot, const uint256& entry) const
+{
+    for (unsigned int i = 0; i < WAYS; i++) {
+        if (shard.pgens[nSlot + i] != 0 && shard.pentries[nSlot + i] == entry)
+            return i;
     }
+    return -1;
+}
 
-    bool
-    Get(const uint256& entry)
-    {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.count(entry);
+bool CSignatureCache::Get(const uint256& entry)
+{
+    size_t nSlot;
+    Shard& shard = ShardFor(entry, nSlot);
+    boost::mutex::scoped_lock lock(shard.cs);
+    if (nBuckets && Find(shard, nSlot, entry) >= 0) {
+        shard.nHits++;
+        return true;
     }
+    shard.nMisses++;
+    return false;
+}
 
-    void Erase(const uint256& entry)
-    {
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.erase(entry);
+void CSignatureCache::Erase(const uint256& entry)
+{
+    size_t nSlot;
+    Shard& shard = ShardFor(entry, nSlot);
+    boost::mutex::scoped_lock lock(shard.cs);
+    if (!nBuckets)
+        return;
+    int nWay = Find(shard, nSlot, entry);
+    if (nWay >= 0) {
+        shard.pgens[nSlot + nWay] = 0;
+        shard.nEntries--;
     }
+}
 
-    void Set(const uint256& entry)
-    {
-        size_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
-        if (nMaxCacheSize <= 0) return;
-
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        while (memusage::DynamicUsage(setValid) > nMaxCacheSize)
-        {
-            map_type::size_type s = GetRand(setValid.bucket_count());
-            map_type::local_iterator it = setValid.begin(s);
-            if (it != setValid.end(s)) {
-                setValid.erase(*it);
+void CSignatureCache::Set(const uint256& entry)
+{
+    if (!nBuckets)
+        return;
+
+    size_t nSlot;
+    Shard& shard = ShardFor(entry, nSlot);
+    boost::mutex::scoped_lock lock(shard.cs);
+    int nWay = Find(shard, nSlot, entry);
+    if (nWay < 0) {
+        // Take an empty slot if there is one, otherwise evict the entry
+        // written longest ago.
+        unsigned char nOldest = 0;
+        for (unsigned int i = 0; i < WAYS; i++) {
+            unsigned char gen = shard.pgens[nSlot + i];
+            if (gen == 0) {
+                nWay = i;
+                shard.nEntries++;
+                break;
+            }
+            unsigned char nAge = shard.nGeneration - gen;
+            if (nWay < 0 || nAge > nOldest) {
+                nWay = i;
+                nOldest = nAge;
             }
         }
+        shard.pentries[nSlot + nWay] = entry;
+    }
+    shard.pgens[nSlot + nWay] = shard.nGeneration;
 
-        setValid.insert(entry);
+    if (++shard.nWrittenThisGeneration >= nBuckets * WAYS / 4) {
+        shard.nWrittenThisGeneration = 0;
+        // Generation 0 marks empty slots
+        if (++shard.nGeneration == 0)
+            shard.nGeneration = 1;
     }
-};
+}
+
+void CSignatureCache::GetStats(CSignatureCacheStats& stats)
+{
+    stats = CSignatureCacheStats();
+    stats.nCapacity = (uint64_t)nBuckets * WAYS * SHARDS;
+    for (unsigned int i = 0; i < SHARDS; i++) {
+        boost::mutex::scoped_lock lock(shards[i].cs);
+        stats.nEntries += shards[i].nEntries;
+        stats.nHits += shards[i].nHits;
+        stats.nMisses += shards[i].nMisses;
+    }
+}
 
+namespace {
+
+CSignatureCache& GetSignatureCache()
+{
+    // The remaining quarter of -maxsigcachesize goes to the script execution cache
+    static CSignatureCache signatureCache(GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20) / 4 * 3);
+    return signatureCache;
+}
+
+}
+
+void GetSignatureCacheStats(CSignatureCacheStats& stats)
+{
+    GetSignatureCache().GetStats(stats);
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    static CSignatureCache signatureCache;
+    CSignatureCache& signatureCache = GetSignatureCache();
 
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
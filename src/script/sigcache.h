@@ -7,15 +7,89 @@
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
 #include "script/interpreter.h"
+#include "uint256.h"
 
 #include <vector>
 
-// DoS prevention: limit cache size to less than 40MB (over 500000
-// entries on 64-bit systems).
+#include <boost/thread/mutex.hpp>
+
+// DoS prevention: limit the signature and script execution caches to less
+// than 40MB together (over 900000 signatures and 300000 transactions).
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 40;
 
 class CPubKey;
 
+/** Counters reported by getsigcacheinfo */
+struct CSignatureCacheStats
+{
+    uint64_t nEntries;
+    uint64_t nCapacity;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    CSignatureCacheStats() : nEntries(0), nCapacity(0), nHits(0), nMisses(0) {}
+};
+
+/**
+ * Valid signature cache, to avoid doing expensive ECDSA signature checking
+ * twice for every transaction (once when accepted into memory pool, and
+ * again when accepted into the block chain).
+ *
+ * The cache is a fixed-size table allocated up front. It is split into
+ * SHARDS independently locked shards (selected by the entry itself), so
+ * script check threads only contend when they touch the same shard. Each
+ * shard is an array of WAYS-entry buckets; when a bucket is full the entry
+ * from the oldest generation is overwritten. A shard's generation advances
+ * every time a quarter of its slots have been written.
+ */
+class CSignatureCache
+{
+public:
+    static const unsigned int SHARDS = 64;
+    static const unsigned int WAYS = 4;
+
+    //! Size the table to use at most nMaxBytes of entry storage (0 disables the cache)
+    explicit CSignatureCache(size_t nMaxBytes);
+    ~CSignatureCache();
+
+    //! Entries are SHA256(nonce || signature hash || public key || signature)
+    void ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const;
+
+    bool Get(const uint256& entry);
+    void Erase(const uint256& entry);
+    void Set(const uint256& entry);
+
+    void GetStats(CSignatureCacheStats& stats);
+
+private:
+    struct Shard
+    {
+        boost::mutex cs;
+        //! nBuckets * WAYS entries
+        uint256* pentries;
+        //! Generation each entry was written in, 0 for an empty slot
+        unsigned char* pgens;
+        unsigned char nGeneration;
+        size_t nWrittenThisGeneration;
+        size_t nEntries;
+        uint64_t nHits;
+        uint64_t nMisses;
+    };
+
+    uint256 nonce;
+    size_t nBuckets;
+    Shard shards[SHARDS];
+
+    Shard& ShardFor(const uint256& entry, size_t& nSlot);
+    int Find(const Shard& shard, size_t nSlot, const uint256& entry) const;
+
+    CSignatureCache(const CSignatureCache&);
+    CSignatureCache& operator=(const CSignatureCache&);
+};
+
+/** Report the counters of the global signature cache */
+void GetSignatureCacheStats(CSignatureCacheStats& stats);
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
@@ -134,6 +134,9 @@ bool CSporkManager::IsSporkActive(int nSporkID)
         case SPORK_5_INSTANTSEND_MAX_VALUE:
             r = SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT;
             break;
+        case SPORK_6_NEW_SIGS:
+            r = SPORK_6_NEW_SIGS_DEFAULT;
+            break;
         case SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT:
             r = SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
             break;
@@ -175,6 +178,8 @@ int64_t CSporkManager::GetSporkValue(int nSporkID)
         return SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT;
     case SPORK_5_INSTANTSEND_MAX_VALUE:
         return SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT;
+    case SPORK_6_NEW_SIGS:
+        return SPORK_6_NEW_SIGS_DEFAULT;
     case SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT:
         return SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
     case SPORK_9_SUPERBLOCKS_ENABLED:
@@ -199,6 +204,7 @@ int CSporkManager::GetSporkIDByName(std::string strName)
     if (strName == "SPORK_2_INSTANTSEND_ENABLED")               return SPORK_2_INSTANTSEND_ENABLED;
     if (strName == "SPORK_3_INSTANTSEND_BLOCK_FILTERING")       return SPORK_3_INSTANTSEND_BLOCK_FILTERING;
     if (strName == "SPORK_5_INSTANTSEND_MAX_VALUE")             return SPORK_5_INSTANTSEND_MAX_VALUE;
+    if (strName == "SPORK_6_NEW_SIGS")                          return SPORK_6_NEW_SIGS;
     if (strName == "SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT")    return SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT;
     if (strName == "SPORK_9_SUPERBLOCKS_ENABLED")               return SPORK_9_SUPERBLOCKS_ENABLED;
     if (strName == "SPORK_10_MASTERNODE_PAY_UPDATED_NODES")     return SPORK_10_MASTERNODE_PAY_UPDATED_NODES;
@@ -219,6 +225,8 @@ std::string CSporkManager::GetSporkNameByID(int nSporkID)
         return "SPORK_3_INSTANTSEND_BLOCK_FILTERING";
     case SPORK_5_INSTANTSEND_MAX_VALUE:
         return "SPORK_5_INSTANTSEND_MAX_VALUE";
+    case SPORK_6_NEW_SIGS:
+        return "SPORK_6_NEW_SIGS";
     case SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT:
         return "SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT";
     case SPORK_9_SUPERBLOCKS_ENABLED:
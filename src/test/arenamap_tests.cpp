@@ -0,0 +1,105 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arenamap.h"
+#include "random.h"
+#include "test/test_mue.h"
+#include "tinyformat.h"
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(arenamap_tests, BasicTestingSetup)
+
+namespace {
+
+// A poor hash, so that probe sequences collide often
+class CSmallHasher
+{
+public:
+    size_t operator()(int key) const { return key % 7; }
+};
+
+typedef arenamap<int, std::string, CSmallHasher> TestMap;
+
+}
+
+BOOST_AUTO_TEST_CASE(arenamap_basic)
+{
+    TestMap m;
+    BOOST_CHECK(m.empty());
+    BOOST_CHECK(m.begin() == m.end());
+
+    BOOST_CHECK(m.insert(std::make_pair(1, std::string("one"))).second);
+    BOOST_CHECK(!m.insert(std::make_pair(1, std::string("uno"))).second);
+    m[2] = "two";
+    BOOST_CHECK_EQUAL(m.size(), 2);
+    BOOST_CHECK_EQUAL(m.find(1)->second, "one");
+    BOOST_CHECK_EQUAL(m[2], "two");
+    BOOST_CHECK(m.find(3) == m.end());
+    BOOST_CHECK_EQUAL(m.count(2), 1);
+
+    BOOST_CHECK_EQUAL(m.erase(1), 1);
+    BOOST_CHECK_EQUAL(m.erase(1), 0);
+    BOOST_CHECK(m.find(1) == m.end());
+    BOOST_CHECK_EQUAL(m.size(), 1);
+
+    m.clear();
+    BOOST_CHECK(m.empty());
+    BOOST_CHECK(m.find(2) == m.end());
+    BOOST_CHECK_EQUAL(m.DynamicMemoryUsage(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(arenamap_stable_entries)
+{
+    // Entries must not move while the table grows around them.
+    TestMap m;
+    std::string* p = &m[0];
+    *p = "zero";
+    TestMap::iterator it = m.find(0);
+    for (int i = 1; i < 10000; i++)
+        m[i] = "x";
+    BOOST_CHECK(p == &m[0]);
+    BOOST_CHECK_EQUAL(*p, "zero");
+
+    // Erasing through an iterator obtained before the table was rebuilt
+    m.erase(it);
+    BOOST_CHECK(m.find(0) == m.end());
+    BOOST_CHECK_EQUAL(m.size(), 9999);
+}
+
+BOOST_AUTO_TEST_CASE(arenamap_random_against_map)
+{
+    TestMap m;
+    std::map<int, std::string> ref;
+    for (int i = 0; i < 100000; i++) {
+        int key = insecure_rand() % 2000;
+        switch (insecure_rand() % 4) {
+        case 0:
+        case 1:
+            m[key] = ref[key] = strprintf("%d", i);
+            break;
+        case 2:
+            BOOST_CHECK_EQUAL(m.erase(key), ref.erase(key));
+            break;
+        case 3:
+            BOOST_CHECK_EQUAL(m.count(key), ref.count(key));
+            break;
+        }
+    }
+    BOOST_CHECK_EQUAL(m.size(), ref.size());
+
+    // Walk the map, erasing as we go like BatchWrite does
+    size_t nSeen = 0;
+    for (TestMap::iterator it = m.begin(); it != m.end(); ) {
+        BOOST_CHECK_EQUAL(it->second, ref[it->first]);
+        nSeen++;
+        m.erase(it++);
+    }
+    BOOST_CHECK_EQUAL(nSeen, ref.size());
+    BOOST_CHECK(m.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
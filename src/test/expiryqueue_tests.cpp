@@ -0,0 +1,51 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "expiryqueue.h"
+
+#include "test/test_mue.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(expiryqueue_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(expiryqueue_test)
+{
+    expiryqueue<int> queue;
+    int k;
+
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK(!queue.pop_expired(100, k));
+
+    queue.push(3, 30);
+    queue.push(1, 10);
+    queue.push(2, 20);
+    // pushed again at a later expiry, both come out
+    queue.push(1, 40);
+    BOOST_CHECK_EQUAL(queue.size(), 4U);
+
+    // nothing expires before its time
+    BOOST_CHECK(!queue.pop_expired(10, k));
+
+    // keys come out in the order they expire
+    BOOST_CHECK(queue.pop_expired(25, k));
+    BOOST_CHECK_EQUAL(k, 1);
+    BOOST_CHECK(queue.pop_expired(25, k));
+    BOOST_CHECK_EQUAL(k, 2);
+    BOOST_CHECK(!queue.pop_expired(25, k));
+    BOOST_CHECK_EQUAL(queue.size(), 2U);
+
+    BOOST_CHECK(queue.pop_expired(100, k));
+    BOOST_CHECK_EQUAL(k, 3);
+    BOOST_CHECK(queue.pop_expired(100, k));
+    BOOST_CHECK_EQUAL(k, 1);
+    BOOST_CHECK(queue.empty());
+
+    queue.push(5, 50);
+    queue.clear();
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK(!queue.pop_expired(100, k));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
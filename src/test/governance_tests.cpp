@@ -0,0 +1,521 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "darksend.h"
+#include "governance.h"
+#include "governance-object.h"
+#include "governance-vote.h"
+#include "governance-votedb.h"
+#include "key.h"
+#include "masternode-sync.h"
+#include "masternodeman.h"
+#include "net.h"
+#include "protocol.h"
+#include "random.h"
+#include "utilstrencodings.h"
+
+#include "test/test_mue.h"
+
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_tests, TestingSetup)
+
+// Masternodes that are not kept have no collateral, so the next
+// CheckAndRemove finds them spent and drops them.
+static CTxIn AddMasternode(const CPubKey& pubKeyMasternode, bool fKeep = true)
+{
+    CTxIn vin(COutPoint(GetRandHash(), 0));
+    CMasternode mn(CService("1.2.3.4", 10000), vin, CPubKey(), pubKeyMasternode, PROTOCOL_VERSION);
+    mn.nActiveState = CMasternode::MASTERNODE_ENABLED;
+    mn.fUnitTest = fKeep;
+    BOOST_CHECK(mnodeman.Add(mn));
+    return vin;
+}
+
+static CGovernanceObject CreateObject(const CTxIn& vin, CKey& key, const std::string& strData)
+{
+    CGovernanceObject govobj(uint256(), 1, GetAdjustedTime(), uint256(), HexStr(strData.begin(), strData.end()));
+    govobj.SetMasternodeInfo(vin);
+    CPubKey pubKey = key.GetPubKey();
+    BOOST_CHECK(govobj.Sign(key, pubKey));
+    return govobj;
+}
+
+// Only one watchdog is current at a time, a new one is accepted only if its hash is higher
+static CGovernanceObject CreateWatchdog(const CTxIn& vin, CKey& key)
+{
+    return CreateObject(vin, key, "[[\"watchdog\",{\"type\":3}]]");
+}
+
+// Not a valid superblock, but kept as an object like any other
+static CGovernanceObject CreateTrigger(const CTxIn& vin, CKey& key)
+{
+    return CreateObject(vin, key, "[[\"trigger\",{\"type\":2}]]");
+}
+
+static CGovernanceVote CreateVote(const CTxIn& vin, CKey& key, const uint256& nParentHash, vote_signal_enum_t eSignal, vote_outcome_enum_t eOutcome)
+{
+    CGovernanceVote vote(vin, nParentHash, eSignal, eOutcome);
+    CPubKey pubKey = key.GetPubKey();
+    BOOST_CHECK(vote.Sign(key, pubKey));
+    return vote;
+}
+
+static bool Vote(const CTxIn& vin, CKey& key, const uint256& nParentHash, vote_signal_enum_t eSignal, vote_outcome_enum_t eOutcome)
+{
+    CGovernanceException exception;
+    return governance.ProcessVoteAndRelay(CreateVote(vin, key, nParentHash, eSignal, eOutcome), exception);
+}
+
+static void DropMasternodes()
+{
+    masternodeSync.Reset();
+    while (!masternodeSync.IsMasternodeListSynced())
+        masternodeSync.SwitchToNextAsset();
+    mnodeman.CheckAndRemove();
+    masternodeSync.Reset();
+}
+
+static void SyncFully()
+{
+    masternodeSync.Reset();
+    while (!masternodeSync.IsSynced())
+        masternodeSync.SwitchToNextAsset();
+    governance.UpdatedBlockTip(chainActive.Tip());
+}
+
+// The payload of the last message sent to the peer, which has to be strCommand
+static CDataStream LastMessage(CNode& node, const std::string& strCommand)
+{
+    BOOST_REQUIRE(!node.vSendMsg.empty());
+    CDataStream ss(node.vSendMsg.back().begin(), node.vSendMsg.back().end(), SER_NETWORK, PROTOCOL_VERSION);
+    CMessageHeader hdr(Params().MessageStart());
+    ss >> hdr;
+    BOOST_CHECK_EQUAL(hdr.GetCommand(), strCommand);
+    return ss;
+}
+
+// The nVotesSince of the last govsync request for the object sent to the peer, 0 for all the votes
+static int64_t LastSyncVotesSince(CNode& node, const uint256& nHash)
+{
+    CDataStream ss = LastMessage(node, NetMsgType::MNGOVERNANCESYNC);
+    uint256 nProp;
+    CBloomFilter filter;
+    ss >> nProp >> filter;
+    BOOST_CHECK(nProp == nHash);
+    int64_t nVotesSince = 0;
+    if (!ss.empty())
+        ss >> nVotesSince;
+    return nVotesSince;
+}
+
+// The outcome a masternode's current vote on this signal has, if any
+static vote_outcome_enum_t GetVoteOutcome(const uint256& nHash, const CTxIn& vin, vote_signal_enum_t eSignal)
+{
+    std::vector<CGovernanceVote> vecVotes = governance.GetCurrentVotes(nHash, vin);
+    for (size_t i = 0; i < vecVotes.size(); i++)
+        if (vecVotes[i].GetSignal() == eSignal)
+            return vecVotes[i].GetOutcome();
+    return VOTE_OUTCOME_NONE;
+}
+
+// The running tally has to match the current votes counted anew
+static void CheckTally(const uint256& nHash)
+{
+    CGovernanceObject* pgovobj = governance.FindGovernanceObject(nHash);
+    BOOST_REQUIRE(pgovobj != NULL);
+    std::map<std::pair<int, int>, int> mapCounts;
+    std::vector<CGovernanceVote> vecVotes = governance.GetCurrentVotes(nHash, CTxIn());
+    for (size_t i = 0; i < vecVotes.size(); i++)
+        mapCounts[std::make_pair(int(vecVotes[i].GetSignal()), int(vecVotes[i].GetOutcome()))]++;
+    for (int nSignal = VOTE_SIGNAL_FUNDING; nSignal <= VOTE_SIGNAL_ENDORSED; nSignal++)
+        for (int nOutcome = VOTE_OUTCOME_YES; nOutcome <= VOTE_OUTCOME_ABSTAIN; nOutcome++)
+            BOOST_CHECK_EQUAL(pgovobj->CountMatchingVotes(vote_signal_enum_t(nSignal), vote_outcome_enum_t(nOutcome)),
+                              mapCounts[std::make_pair(nSignal, nOutcome)]);
+}
+
+BOOST_AUTO_TEST_CASE(governance_vote_tally)
+{
+    mnodeman.Clear();
+    governance.Clear();
+    std::vector<CKey> vecKeys(6);
+    std::vector<CTxIn> vecVins;
+    for (size_t i = 0; i < vecKeys.size(); i++) {
+        vecKeys[i].MakeNewKey(true);
+        vecVins.push_back(AddMasternode(vecKeys[i].GetPubKey(), i != 4));
+    }
+    CGovernanceObject govobj = CreateWatchdog(vecVins[0], vecKeys[0]);
+    uint256 nHash = govobj.GetHash();
+    bool fAddToSeen;
+    BOOST_REQUIRE(governance.AddGovernanceObject(govobj, fAddToSeen));
+    CGovernanceObject* pgovobj = governance.FindGovernanceObject(nHash);
+    BOOST_REQUIRE(pgovobj != NULL);
+
+    // Added
+    for (size_t i = 0; i < vecVins.size(); i++)
+        BOOST_CHECK(Vote(vecVins[i], vecKeys[i], nHash, VOTE_SIGNAL_FUNDING, i < 4 ? VOTE_OUTCOME_YES : VOTE_OUTCOME_NO));
+    BOOST_CHECK(Vote(vecVins[1], vecKeys[1], nHash, VOTE_SIGNAL_VALID, VOTE_OUTCOME_ABSTAIN));
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 4);
+    BOOST_CHECK_EQUAL(pgovobj->GetNoCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(pgovobj->GetAbstainCount(VOTE_SIGNAL_VALID), 1);
+    CheckTally(nHash);
+
+    // A vote that is not signed by the masternode is not counted
+    CGovernanceVote voteBad = CreateVote(vecVins[2], vecKeys[3], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO);
+    CGovernanceException exception;
+    BOOST_CHECK(!governance.ProcessVoteAndRelay(voteBad, exception));
+    BOOST_CHECK_EQUAL(GetVoteOutcome(nHash, vecVins[2], VOTE_SIGNAL_FUNDING), VOTE_OUTCOME_YES);
+    CheckTally(nHash);
+
+    // Replaced
+    BOOST_CHECK(Vote(vecVins[0], vecKeys[0], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO));
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 3);
+    BOOST_CHECK_EQUAL(pgovobj->GetNoCount(VOTE_SIGNAL_FUNDING), 3);
+    CheckTally(nHash);
+
+    // Taken back
+    BOOST_CHECK(Vote(vecVins[1], vecKeys[1], nHash, VOTE_SIGNAL_VALID, VOTE_OUTCOME_NONE));
+    BOOST_CHECK_EQUAL(pgovobj->GetAbstainCount(VOTE_SIGNAL_VALID), 0);
+    CheckTally(nHash);
+
+    // The masternode is dropped
+    DropMasternodes();
+    BOOST_CHECK(!mnodeman.Has(vecVins[4]));
+    BOOST_CHECK_EQUAL(mnodeman.size(), (int)vecVins.size() - 1);
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 3);
+    BOOST_CHECK_EQUAL(pgovobj->GetNoCount(VOTE_SIGNAL_FUNDING), 2);
+    CheckTally(nHash);
+
+    // The others keep voting as before
+    BOOST_CHECK(Vote(vecVins[5], vecKeys[5], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 4);
+    BOOST_CHECK_EQUAL(pgovobj->GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    CheckTally(nHash);
+
+    governance.Clear();
+    mnodeman.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(governance_vote_tally_index_rebuild)
+{
+    mnodeman.Clear();
+    governance.Clear();
+    // One more masternode than CMasternodeMan::MAX_EXPECTED_INDEX_SIZE, so
+    // dropping one makes the masternode index, which votes are kept by, be rebuilt
+    for (int i = 0; i < 30000 - 3; i++)
+        AddMasternode(CPubKey());
+    std::vector<CKey> vecKeys(4);
+    std::vector<CTxIn> vecVins;
+    for (size_t i = 0; i < vecKeys.size(); i++) {
+        vecKeys[i].MakeNewKey(true);
+        vecVins.push_back(AddMasternode(vecKeys[i].GetPubKey(), i != 0));
+    }
+    CGovernanceObject govobj = CreateWatchdog(vecVins[1], vecKeys[1]);
+    uint256 nHash = govobj.GetHash();
+    bool fAddToSeen;
+    BOOST_REQUIRE(governance.AddGovernanceObject(govobj, fAddToSeen));
+    CGovernanceObject* pgovobj = governance.FindGovernanceObject(nHash);
+    BOOST_REQUIRE(pgovobj != NULL);
+
+    for (size_t i = 0; i < vecVins.size(); i++)
+        BOOST_CHECK(Vote(vecVins[i], vecKeys[i], nHash, VOTE_SIGNAL_FUNDING, i % 2 ? VOTE_OUTCOME_YES : VOTE_OUTCOME_NO));
+    CheckTally(nHash);
+    CTxIn vinLast;
+    bool fIndexRebuilt;
+    BOOST_CHECK(mnodeman.Get(30000, vinLast, fIndexRebuilt));
+    BOOST_CHECK(vinLast == vecVins[3]);
+
+    DropMasternodes();
+    BOOST_CHECK(!mnodeman.Has(vecVins[0]));
+    // The index was rebuilt without the dropped masternode
+    BOOST_CHECK(!mnodeman.Get(30000, vinLast, fIndexRebuilt));
+    BOOST_CHECK(!fIndexRebuilt);
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(pgovobj->GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    for (size_t i = 1; i < vecVins.size(); i++)
+        BOOST_CHECK_EQUAL(GetVoteOutcome(nHash, vecVins[i], VOTE_SIGNAL_FUNDING), i % 2 ? VOTE_OUTCOME_YES : VOTE_OUTCOME_NO);
+    CheckTally(nHash);
+
+    BOOST_CHECK(Vote(vecVins[2], vecKeys[2], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 3);
+    BOOST_CHECK_EQUAL(pgovobj->GetNoCount(VOTE_SIGNAL_FUNDING), 0);
+    CheckTally(nHash);
+
+    governance.Clear();
+    mnodeman.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(governance_batch_signatures)
+{
+    mnodeman.Clear();
+    governance.Clear();
+    std::vector<CKey> vecKeys(2);
+    std::vector<CTxIn> vecVins;
+    for (size_t i = 0; i < vecKeys.size(); i++) {
+        vecKeys[i].MakeNewKey(true);
+        vecVins.push_back(AddMasternode(vecKeys[i].GetPubKey()));
+    }
+    CNode node(INVALID_SOCKET, CAddress(CService("5.6.7.8", 10000)), "", true);
+    node.nVersion = PROTOCOL_VERSION;
+
+    // Each signed by the masternode it names, and by the other one's key
+    CGovernanceObject govobj = CreateWatchdog(vecVins[0], vecKeys[0]);
+    CGovernanceObject govobjBad = CreateWatchdog(vecVins[1], vecKeys[0]);
+    uint256 nHash = govobj.GetHash();
+    CGovernanceVote vote = CreateVote(vecVins[1], vecKeys[1], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    CGovernanceVote voteBad = CreateVote(vecVins[0], vecKeys[1], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO);
+
+    int nRefCount = node.GetRefCount();
+    governance.QueueObject(&node, govobjBad);
+    governance.QueueObject(&node, govobj);
+    governance.QueueVote(&node, vote);
+    governance.QueueVote(&node, voteBad);
+    BOOST_CHECK(governance.FindGovernanceObject(nHash) == NULL);
+    BOOST_CHECK_EQUAL(node.GetRefCount(), nRefCount + 4);
+
+    governance.ProcessPendingMessages();
+    CGovernanceObject* pgovobj = governance.FindGovernanceObject(nHash);
+    BOOST_REQUIRE(pgovobj != NULL);
+    BOOST_CHECK(governance.FindGovernanceObject(govobjBad.GetHash()) == NULL);
+    BOOST_CHECK_EQUAL(GetVoteOutcome(nHash, vecVins[1], VOTE_SIGNAL_FUNDING), VOTE_OUTCOME_YES);
+    BOOST_CHECK_EQUAL(GetVoteOutcome(nHash, vecVins[0], VOTE_SIGNAL_FUNDING), VOTE_OUTCOME_NONE);
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(pgovobj->GetNoCount(VOTE_SIGNAL_FUNDING), 0);
+
+    // Signatures verified by a batch are forgotten once it is processed
+    uint256 hashVote = CDarkSendSigner::GetMessageHash(vote.GetSignatureMessage());
+    BOOST_CHECK(!governance.IsSignatureVerified(vecKeys[1].GetPubKey(), vote.GetSignature(), hashVote));
+    BOOST_CHECK_EQUAL(node.GetRefCount(), nRefCount);
+
+    governance.Clear();
+    mnodeman.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(governance_masternode_orphans)
+{
+    mnodeman.Clear();
+    governance.Clear();
+    std::vector<CKey> vecKeys(3);
+    for (size_t i = 0; i < vecKeys.size(); i++)
+        vecKeys[i].MakeNewKey(true);
+    CTxIn vinKnown = AddMasternode(vecKeys[0].GetPubKey());
+    CNode node(INVALID_SOCKET, CAddress(CService("5.6.7.8", 10000)), "", true);
+    node.nVersion = PROTOCOL_VERSION;
+
+    CGovernanceObject govobj = CreateWatchdog(vinKnown, vecKeys[0]);
+    uint256 nHash = govobj.GetHash();
+    bool fAddToSeen;
+    BOOST_REQUIRE(governance.AddGovernanceObject(govobj, fAddToSeen));
+    CGovernanceObject* pgovobj = governance.FindGovernanceObject(nHash);
+    BOOST_REQUIRE(pgovobj != NULL);
+
+    // Made by and voted on by masternodes we don't know yet
+    CMasternode mnObject(CService("1.2.3.5", 10000), CTxIn(COutPoint(GetRandHash(), 0)), CPubKey(), vecKeys[1].GetPubKey(), PROTOCOL_VERSION);
+    CMasternode mnVote(CService("1.2.3.6", 10000), CTxIn(COutPoint(GetRandHash(), 0)), CPubKey(), vecKeys[2].GetPubKey(), PROTOCOL_VERSION);
+    mnObject.nActiveState = mnVote.nActiveState = CMasternode::MASTERNODE_ENABLED;
+    mnObject.fUnitTest = mnVote.fUnitTest = true;
+    CGovernanceObject govobjOrphan = CreateTrigger(mnObject.vin, vecKeys[1]);
+    uint256 nHashOrphan = govobjOrphan.GetHash();
+    governance.QueueObject(&node, govobjOrphan);
+    governance.ProcessPendingMessages();
+    BOOST_CHECK(Vote(vinKnown, vecKeys[0], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO));
+    BOOST_CHECK(!Vote(mnVote.vin, vecKeys[2], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK(governance.FindGovernanceObject(nHashOrphan) == NULL);
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanObjectIndexSize(), 1);
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanVoteIndexSize(), 1);
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 0);
+
+    // Processed once their masternodes show up
+    BOOST_CHECK(mnodeman.Add(mnObject));
+    BOOST_CHECK(mnodeman.Add(mnVote));
+    mnodeman.NotifyMasternodeUpdates();
+    BOOST_CHECK(governance.FindGovernanceObject(nHashOrphan) != NULL);
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanObjectIndexSize(), 0);
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanVoteIndexSize(), 0);
+    BOOST_CHECK_EQUAL(GetVoteOutcome(nHash, mnVote.vin, VOTE_SIGNAL_FUNDING), VOTE_OUTCOME_YES);
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(pgovobj->GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    CheckTally(nHash);
+
+    // Removed by Clear()
+    mnodeman.Clear();
+    governance.Clear();
+    vinKnown = AddMasternode(vecKeys[0].GetPubKey());
+    govobj = CreateWatchdog(vinKnown, vecKeys[0]);
+    nHash = govobj.GetHash();
+    BOOST_REQUIRE(governance.AddGovernanceObject(govobj, fAddToSeen));
+    governance.QueueObject(&node, govobjOrphan);
+    governance.ProcessPendingMessages();
+    BOOST_CHECK(!Vote(mnVote.vin, vecKeys[2], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanObjectIndexSize(), 1);
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanVoteIndexSize(), 1);
+    governance.Clear();
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanObjectIndexSize(), 0);
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanVoteIndexSize(), 0);
+
+    // Removed once they expire
+    govobj = CreateWatchdog(vinKnown, vecKeys[0]);
+    nHash = govobj.GetHash();
+    BOOST_REQUIRE(governance.AddGovernanceObject(govobj, fAddToSeen));
+    govobjOrphan = CreateTrigger(mnObject.vin, vecKeys[1]);
+    governance.QueueObject(&node, govobjOrphan);
+    governance.ProcessPendingMessages();
+    BOOST_CHECK(!Vote(mnVote.vin, vecKeys[2], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanObjectIndexSize(), 1);
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanVoteIndexSize(), 1);
+    SyncFully();
+    SetMockTime(GetTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME + 1);
+    governance.DoMaintenance();
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanObjectIndexSize(), 0);
+    BOOST_CHECK_EQUAL(governance.GetMasternodeOrphanVoteIndexSize(), 0);
+    SetMockTime(0);
+    masternodeSync.Reset();
+
+    governance.Clear();
+    mnodeman.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(governance_sync_chunks)
+{
+    mnodeman.Clear();
+    governance.Clear();
+    pgovernancevotedb = new CGovernanceVoteDB(1 << 20, true);
+    // One more voter than fit in a chunk
+    std::vector<CKey> vecKeys(501);
+    std::vector<CTxIn> vecVins;
+    for (size_t i = 0; i < vecKeys.size(); i++) {
+        vecKeys[i].MakeNewKey(true);
+        vecVins.push_back(AddMasternode(vecKeys[i].GetPubKey()));
+    }
+    std::vector<uint256> vecHashes;
+    for (size_t i = 0; i < 5; i++) {
+        CGovernanceObject govobj = CreateTrigger(vecVins[i], vecKeys[i]);
+        bool fAddToSeen;
+        BOOST_REQUIRE(governance.AddGovernanceObject(govobj, fAddToSeen));
+        vecHashes.push_back(govobj.GetHash());
+    }
+    for (size_t i = 0; i < vecVins.size(); i++)
+        BOOST_CHECK(Vote(vecVins[i], vecKeys[i], vecHashes[0], VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    CNode node(INVALID_SOCKET, CAddress(CService("5.6.7.8", 10000)), "", true);
+    node.nVersion = PROTOCOL_VERSION;
+    // As for a peer that sends no filter, a default one matches everything
+    CBloomFilter filter;
+    filter.clear();
+
+    // All the objects
+    governance.Sync(&node, uint256(), filter);
+    governance.SendSyncChunk(&node);
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), vecHashes.size());
+
+    // The votes of one, a chunk at a time, asking again while it is answered does nothing
+    node.vInventoryToSend.clear();
+    governance.Sync(&node, vecHashes[0], filter);
+    governance.Sync(&node, vecHashes[0], filter);
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), 1U);
+    governance.SendSyncChunk(&node);
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), 1U + 500);
+    governance.SendSyncChunk(&node);
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), 1U + vecVins.size());
+    governance.SendSyncChunk(&node);
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), 1U + vecVins.size());
+
+    // Only a few requests can wait at a time, the others are answered with nothing right away
+    node.vInventoryToSend.clear();
+    for (size_t i = 0; i < vecHashes.size(); i++)
+        governance.Sync(&node, vecHashes[i], filter);
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), vecHashes.size() - 1);
+    BOOST_CHECK(node.vInventoryToSend.back().hash == vecHashes[vecHashes.size() - 2]);
+    CDataStream ssStatus = LastMessage(node, NetMsgType::SYNCSTATUSCOUNT);
+    int nItemID, nCount;
+    uint256 nProp;
+    ssStatus >> nItemID >> nCount >> nProp;
+    BOOST_CHECK_EQUAL(nItemID, MASTERNODE_SYNC_GOVOBJ_VOTE);
+    BOOST_CHECK_EQUAL(nCount, 0);
+    BOOST_CHECK(nProp == vecHashes.back());
+
+    // Dropped when the peer disconnects
+    governance.RemoveSyncRequests(node.id);
+    governance.SendSyncChunk(&node);
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), vecHashes.size() - 1);
+    governance.Sync(&node, vecHashes.back(), filter);
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), vecHashes.size());
+
+    governance.Clear();
+    mnodeman.Clear();
+    delete pgovernancevotedb;
+    pgovernancevotedb = NULL;
+}
+
+BOOST_AUTO_TEST_CASE(governance_votes_complete_time)
+{
+    mnodeman.Clear();
+    governance.Clear();
+    std::vector<CKey> vecKeys(2);
+    std::vector<CTxIn> vecVins;
+    for (size_t i = 0; i < vecKeys.size(); i++) {
+        vecKeys[i].MakeNewKey(true);
+        vecVins.push_back(AddMasternode(vecKeys[i].GetPubKey()));
+    }
+    CGovernanceObject govobj = CreateWatchdog(vecVins[0], vecKeys[0]);
+    uint256 nHash = govobj.GetHash();
+    bool fAddToSeen;
+    BOOST_REQUIRE(governance.AddGovernanceObject(govobj, fAddToSeen));
+    CGovernanceObject* pgovobj = governance.FindGovernanceObject(nHash);
+    BOOST_REQUIRE(pgovobj != NULL);
+    std::vector<CNode*> vecNodes;
+    for (int i = 0; i < 3; i++) {
+        vecNodes.push_back(new CNode(INVALID_SOCKET, CAddress(CService("5.6.7.8", 10000 + i)), "", true));
+        vecNodes.back()->nVersion = PROTOCOL_VERSION;
+    }
+    int64_t nNow = GetTime();
+    SetMockTime(nNow);
+
+    // Having the newest vote says nothing about the older ones
+    BOOST_CHECK(Vote(vecVins[0], vecKeys[0], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    SyncFully();
+    governance.DoMaintenance();
+    BOOST_CHECK_EQUAL(governance.GetVotesCompleteTime(nHash), 0);
+    governance.RequestGovernanceObjectVotes(vecNodes[0]);
+    BOOST_CHECK_EQUAL(LastSyncVotesSince(*vecNodes[0], nHash), 0);
+
+    // An older vote coming in later is taken as any other
+    SetMockTime(nNow - 1000);
+    CGovernanceVote voteOld = CreateVote(vecVins[1], vecKeys[1], nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    SetMockTime(nNow);
+    CGovernanceException exception;
+    BOOST_CHECK(governance.ProcessVoteAndRelay(voteOld, exception));
+    BOOST_CHECK_EQUAL(pgovobj->GetYesCount(VOTE_SIGNAL_FUNDING), 2);
+
+    // A peer that doesn't have the object can't have sent us its votes
+    governance.SyncStatusCount(vecNodes[0], MASTERNODE_SYNC_GOVOBJ, 0, nHash);
+    governance.SyncStatusCount(vecNodes[0], MASTERNODE_SYNC_GOVOBJ_VOTE, 0, nHash);
+    BOOST_CHECK_EQUAL(governance.GetVotesCompleteTime(nHash), 0);
+
+    // Once a peer answered a request for all of them, only the votes since are asked for
+    SetMockTime(nNow + 100);
+    governance.RequestGovernanceObjectVotes(vecNodes[1]);
+    BOOST_CHECK_EQUAL(LastSyncVotesSince(*vecNodes[1], nHash), 0);
+    SetMockTime(nNow + 200);
+    governance.SyncStatusCount(vecNodes[2], MASTERNODE_SYNC_GOVOBJ, 1, nHash);
+    governance.SyncStatusCount(vecNodes[2], MASTERNODE_SYNC_GOVOBJ_VOTE, 5, nHash);
+    BOOST_CHECK_EQUAL(governance.GetVotesCompleteTime(nHash), 0);
+    governance.SyncStatusCount(vecNodes[1], MASTERNODE_SYNC_GOVOBJ, 1, nHash);
+    governance.SyncStatusCount(vecNodes[1], MASTERNODE_SYNC_GOVOBJ_VOTE, 5, nHash);
+    BOOST_CHECK_EQUAL(governance.GetVotesCompleteTime(nHash), nNow + 100);
+    governance.RequestGovernanceObjectVotes(vecNodes[2]);
+    BOOST_CHECK_EQUAL(LastSyncVotesSince(*vecNodes[2], nHash), nNow + 100 - GOVERNANCE_VOTES_SINCE_MARGIN);
+
+    SetMockTime(0);
+    masternodeSync.Reset();
+    governance.Clear();
+    mnodeman.Clear();
+    for (size_t i = 0; i < vecNodes.size(); i++)
+        delete vecNodes[i];
+}
+
+BOOST_AUTO_TEST_SUITE_END()
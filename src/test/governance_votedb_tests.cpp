@@ -0,0 +1,95 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-votedb.h"
+
+#include "arith_uint256.h"
+#include "test/test_mue.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_votedb_tests, BasicTestingSetup)
+
+static CGovernanceVote GetTestVote(const uint256& nParentHash, int nMasternode)
+{
+    CTxIn vin(COutPoint(ArithToUint256(arith_uint256(nMasternode)), 0));
+    return CGovernanceVote(vin, nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+}
+
+BOOST_AUTO_TEST_CASE(governance_votedb_test)
+{
+    pgovernancevotedb = new CGovernanceVoteDB(1 << 20, true);
+
+    uint256 nHash1 = ArithToUint256(arith_uint256(1));
+    uint256 nHash2 = ArithToUint256(arith_uint256(2));
+
+    CGovernanceObjectVoteFile file1;
+    CGovernanceObjectVoteFile file2;
+    std::vector<CGovernanceVote> vecVotes1;
+    for(int i = 0; i < 5; i++) {
+        vecVotes1.push_back(GetTestVote(nHash1, i));
+        file1.AddVote(vecVotes1.back());
+    }
+    file2.AddVote(GetTestVote(nHash2, 0));
+    file2.AddVote(GetTestVote(nHash2, 3));
+
+    BOOST_CHECK_EQUAL(file1.GetVoteCount(), 5);
+    BOOST_CHECK_EQUAL(file1.GetVotes().size(), 5U);
+    BOOST_CHECK_EQUAL(file2.GetVotes().size(), 2U);
+
+    // an older vote of the same masternode, kept along with the newer one
+    const CGovernanceVote& vote = vecVotes1[3];
+    CGovernanceVote voteOld(vote.GetVinMasternode(), nHash1, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO);
+    file1.AddVote(voteOld);
+    BOOST_CHECK_EQUAL(file1.GetVoteCount(), 6);
+
+    // votes are only found in the file of their own object
+    CGovernanceVote voteRead;
+    BOOST_CHECK(file1.HasVote(vote.GetHash()));
+    BOOST_CHECK(!file2.HasVote(vote.GetHash()));
+    BOOST_CHECK(file1.GetVote(vote.GetHash(), voteRead));
+    BOOST_CHECK(voteRead.GetHash() == vote.GetHash());
+
+    // the cursor walks one object's votes only
+    int nCount = 0;
+    for(CGovernanceVoteCursor cursor(*pgovernancevotedb, nHash2); cursor.Valid(); cursor.Next()) {
+        BOOST_CHECK(cursor.GetVote(voteRead));
+        BOOST_CHECK(voteRead.GetParentHash() == nHash2);
+        BOOST_CHECK(voteRead.GetHash() == cursor.GetVoteHash());
+        nCount++;
+    }
+    BOOST_CHECK_EQUAL(nCount, 2);
+
+    // all the votes of the masternode go, on this object only
+    file1.RemoveVotesFromMasternode(vote.GetVinMasternode());
+    BOOST_CHECK_EQUAL(file1.GetVoteCount(), 4);
+    BOOST_CHECK(!file1.HasVote(vote.GetHash()));
+    BOOST_CHECK(!file1.HasVote(voteOld.GetHash()));
+    BOOST_CHECK_EQUAL(file1.GetVoteHashes().size(), 4U);
+    BOOST_CHECK_EQUAL(file2.GetVotes().size(), 2U);
+    file1.RemoveVotesFromMasternode(vote.GetVinMasternode());
+    BOOST_CHECK_EQUAL(file1.GetVoteCount(), 4);
+
+    // only the count goes with the object, the votes stay in the database
+    CGovernanceObjectVoteFile fileLoaded;
+    fileLoaded.Recount(nHash1);
+    BOOST_CHECK_EQUAL(fileLoaded.GetVoteCount(), 4);
+
+    std::set<uint256> setKeep;
+    setKeep.insert(nHash1);
+    BOOST_CHECK_EQUAL(pgovernancevotedb->PruneObjects(setKeep), 2);
+    file2.Recount(nHash2);
+    BOOST_CHECK_EQUAL(file2.GetVoteCount(), 0);
+    BOOST_CHECK(file2.GetVotes().empty());
+
+    file1.RemoveAllVotes();
+    BOOST_CHECK_EQUAL(file1.GetVoteCount(), 0);
+    fileLoaded.Recount(nHash1);
+    BOOST_CHECK_EQUAL(fileLoaded.GetVoteCount(), 0);
+
+    delete pgovernancevotedb;
+    pgovernancevotedb = NULL;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
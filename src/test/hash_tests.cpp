@@ -3,7 +3,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "streams.h"
+#include "tinyformat.h"
 #include "utilstrencodings.h"
+#include "version.h"
 #include "test/test_mue.h"
 
 #include <vector>
@@ -47,4 +52,75 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(x11_backend_matches_generic)
+{
+    // Whatever backend X11AutoDetect() picked must agree bit for bit with the
+    // portable sph_* chain, for header-sized and arbitrary-sized inputs.
+    std::vector<unsigned char> vch(300);
+    for (size_t len = 0; len <= vch.size(); len += (len < 100 ? 1 : 37)) {
+        GetRandBytes(&vch[0], vch.size());
+        unsigned char expected[X11_OUTPUT_SIZE], actual[X11_OUTPUT_SIZE];
+        X11Generic(&vch[0], len, expected);
+        X11(&vch[0], len, actual);
+        BOOST_CHECK_MESSAGE(memcmp(expected, actual, X11_OUTPUT_SIZE) == 0, strprintf("backend %s, length %u", X11BackendName(), len));
+    }
+    BOOST_CHECK(HashX11(vch.begin(), vch.begin() + 80) == HashX11(&vch[0], &vch[0] + 80));
+}
+
+BOOST_AUTO_TEST_CASE(x11_batch_matches_gethash)
+{
+    // Odd counts so that partial groups at the end of a batch are covered too.
+    std::vector<CBlockHeader> headers(3 * X11_BATCH_SIZE + 5);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = insecure_rand();
+        headers[i].hashPrevBlock = GetRandHash();
+        headers[i].hashMerkleRoot = GetRandHash();
+        headers[i].nTime = insecure_rand();
+        headers[i].nBits = insecure_rand();
+        headers[i].nNonce = insecure_rand();
+    }
+    for (size_t n = 0; n <= headers.size(); n += (n < 2 * X11_BATCH_SIZE ? 1 : 7)) {
+        std::vector<uint256> hashes(n + 1);
+        hashes[n] = uint256S("1234");
+        HashX11Batch(&headers[0], n, &hashes[0]);
+        for (size_t i = 0; i < n; i++)
+            BOOST_CHECK_MESSAGE(hashes[i] == headers[i].GetHash(), strprintf("header %u of %u", i, n));
+        // Nothing past the last header is written.
+        BOOST_CHECK(hashes[n] == uint256S("1234"));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(cblock_hash_follows_header)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = GetRandHash();
+    block.hashMerkleRoot = GetRandHash();
+    block.nTime = 1500000000;
+    block.nBits = 0x1b0404cb;
+    block.nNonce = 1;
+    uint256 hash = block.GetHash();
+    BOOST_CHECK(hash == block.GetBlockHeader().GetHash());
+    BOOST_CHECK(block.GetHash() == hash);
+
+    // Every header field change must be seen by the remembered hash.
+    block.nNonce++;
+    BOOST_CHECK(block.GetHash() != hash);
+    BOOST_CHECK(block.GetHash() == block.GetBlockHeader().GetHash());
+    block.hashMerkleRoot = GetRandHash();
+    BOOST_CHECK(block.GetHash() == block.GetBlockHeader().GetHash());
+    block.nTime++;
+    BOOST_CHECK(block.GetHash() == block.GetBlockHeader().GetHash());
+
+    // Copies keep a valid cache, and so does deserialization into a used block.
+    CBlock copy(block);
+    BOOST_CHECK(copy.GetHash() == block.GetHash());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CBlock other;
+    other.nNonce = 7;
+    ss << other;
+    ss >> copy;
+    BOOST_CHECK(copy.GetHash() == other.GetBlockHeader().GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,610 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "darksend.h"
+#include "hash.h"
+#include "key.h"
+#include "flat-database.h"
+#include "main.h"
+#include "masternode-db.h"
+#include "masternode-payments.h"
+#include "masternodeman.h"
+#include "net.h"
+#include "netfulfilledman.h"
+#include "random.h"
+#include "script/standard.h"
+
+#include "test/test_mue.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternodeman_tests, TestingSetup)
+
+static CTxIn AddMasternode(int nState)
+{
+    CTxIn vin(COutPoint(GetRandHash(), insecure_rand() % 4));
+    CMasternode mn(CService("1.2.3.4", 10000), vin, CPubKey(), CPubKey(), PROTOCOL_VERSION);
+    mn.nActiveState = nState;
+    BOOST_CHECK(mnodeman.Add(mn));
+    return vin;
+}
+
+// Ranks as computed before they were cached: all enabled masternodes by
+// descending score, ties broken by descending vin.
+static std::vector<CTxIn> ExpectedRanking(const std::vector<CTxIn>& vecVins, int nBlockHeight)
+{
+    uint256 blockHash = chainActive[nBlockHeight]->GetBlockHash();
+    std::vector<std::pair<int64_t, CTxIn> > vecScores;
+    for (size_t i = 0; i < vecVins.size(); i++) {
+        CMasternode mn;
+        BOOST_CHECK(mnodeman.Get(vecVins[i], mn));
+        if (!mn.IsEnabled())
+            continue;
+        vecScores.push_back(std::make_pair(mn.CalculateScore(blockHash).GetCompact(false), vecVins[i]));
+    }
+    std::sort(vecScores.rbegin(), vecScores.rend());
+    std::vector<CTxIn> vecRanked;
+    for (size_t i = 0; i < vecScores.size(); i++)
+        vecRanked.push_back(vecScores[i].second);
+    return vecRanked;
+}
+
+static void CheckRanks(const std::vector<CTxIn>& vecVins, int nBlockHeight)
+{
+    std::vector<CTxIn> vecRanked = ExpectedRanking(vecVins, nBlockHeight);
+    for (size_t i = 0; i < vecVins.size(); i++) {
+        std::vector<CTxIn>::iterator it = std::find(vecRanked.begin(), vecRanked.end(), vecVins[i]);
+        int nExpected = it == vecRanked.end() ? -1 : (it - vecRanked.begin()) + 1;
+        BOOST_CHECK_EQUAL(mnodeman.GetMasternodeRank(vecVins[i], nBlockHeight), nExpected);
+    }
+    std::vector<std::pair<int, CMasternode> > vecRanks = mnodeman.GetMasternodeRanks(nBlockHeight);
+    BOOST_CHECK_EQUAL(vecRanks.size(), vecRanked.size());
+    for (size_t i = 0; i < vecRanks.size() && i < vecRanked.size(); i++) {
+        BOOST_CHECK_EQUAL(vecRanks[i].first, (int)i + 1);
+        BOOST_CHECK(vecRanks[i].second.vin == vecRanked[i]);
+    }
+    CMasternode* pmn = mnodeman.GetMasternodeByRank(1, nBlockHeight);
+    BOOST_CHECK(pmn != NULL && pmn->vin == vecRanked[0]);
+    BOOST_CHECK(mnodeman.GetMasternodeByRank(vecRanked.size() + 1, nBlockHeight) == NULL);
+    BOOST_CHECK(mnodeman.GetMasternodeByRank(vecVins.size(), nBlockHeight, 0, false) != NULL);
+}
+
+BOOST_AUTO_TEST_CASE(masternode_rank_cache)
+{
+    mnodeman.Clear();
+    std::vector<CTxIn> vecVins;
+    for (int i = 0; i < 50; i++)
+        vecVins.push_back(AddMasternode(i % 5 ? CMasternode::MASTERNODE_ENABLED : CMasternode::MASTERNODE_PRE_ENABLED));
+    int nHeight = chainActive.Height();
+
+    CheckRanks(vecVins, nHeight);
+    // Served from the cache this time
+    CheckRanks(vecVins, nHeight);
+
+    // A new masternode shows up in the ranks right away...
+    vecVins.push_back(AddMasternode(CMasternode::MASTERNODE_ENABLED));
+    BOOST_CHECK(mnodeman.GetMasternodeRank(vecVins.back(), nHeight) > 0);
+    CheckRanks(vecVins, nHeight);
+
+    // ...and so does one that stops being enabled (its collateral is not in the UTXO set).
+    BOOST_CHECK(mnodeman.GetMasternodeRank(vecVins[1], nHeight) > 0);
+    mnodeman.CheckMasternode(vecVins[1], true);
+    BOOST_CHECK_EQUAL(mnodeman.GetMasternodeState(vecVins[1]), CMasternode::MASTERNODE_OUTPOINT_SPENT);
+    BOOST_CHECK_EQUAL(mnodeman.GetMasternodeRank(vecVins[1], nHeight), -1);
+    CheckRanks(vecVins, nHeight);
+
+    // Unknown blocks have no ranks
+    BOOST_CHECK_EQUAL(mnodeman.GetMasternodeRank(vecVins[2], nHeight + 1), -1);
+    BOOST_CHECK(mnodeman.GetMasternodeRanks(nHeight + 1).empty());
+
+    mnodeman.Clear();
+    BOOST_CHECK_EQUAL(mnodeman.GetMasternodeRank(vecVins[2], nHeight), -1);
+}
+
+BOOST_AUTO_TEST_CASE(masternode_scorer)
+{
+    for (int i = 0; i < 100; i++) {
+        uint256 blockHash = GetRandHash();
+        COutPoint outpoint(GetRandHash(), insecure_rand() % 100);
+        // The score as defined before it was computed per block
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << blockHash;
+        arith_uint256 hash2 = UintToArith256(ss.GetHash());
+        CHashWriter ss2(SER_GETHASH, PROTOCOL_VERSION);
+        ss2 << blockHash;
+        ss2 << ArithToUint256(UintToArith256(outpoint.hash) + outpoint.n);
+        arith_uint256 hash3 = UintToArith256(ss2.GetHash());
+        arith_uint256 nExpected = hash3 > hash2 ? hash3 - hash2 : hash2 - hash3;
+
+        CMasternodeScorer scorer(blockHash);
+        BOOST_CHECK(scorer.GetScore(outpoint) == nExpected);
+        // The shared hasher state is not used up by scoring
+        BOOST_CHECK(scorer.GetScore(outpoint) == nExpected);
+        CMasternode mn(CService("1.2.3.4", 10000), CTxIn(outpoint), CPubKey(), CPubKey(), PROTOCOL_VERSION);
+        BOOST_CHECK(mn.CalculateScore(blockHash) == nExpected);
+    }
+}
+
+static CMasternode RegistryMasternode(const CService& addr, const CPubKey& pubKeyMasternode)
+{
+    return CMasternode(addr, CTxIn(COutPoint(GetRandHash(), insecure_rand() % 4)), CPubKey(), pubKeyMasternode, PROTOCOL_VERSION);
+}
+
+static CPubKey RandomPubKey()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    return key.GetPubKey();
+}
+
+BOOST_AUTO_TEST_CASE(masternode_registry)
+{
+    CMasternodeRegistry registry;
+    CService addr1("1.2.3.4", 10000), addr2("5.6.7.8", 10000);
+    CPubKey pubKey1 = RandomPubKey(), pubKey2 = RandomPubKey();
+
+    CMasternode mn1 = RegistryMasternode(addr1, pubKey1);
+    CMasternode* pmn1 = registry.Add(mn1);
+    BOOST_CHECK(pmn1 != NULL);
+    BOOST_CHECK(registry.Add(mn1) == NULL);
+    BOOST_CHECK_EQUAL(registry.size(), 1U);
+
+    // Masternodes sharing an address are all found by it
+    CMasternode* pmn2 = registry.Add(RegistryMasternode(addr1, pubKey2));
+    CMasternode* pmn3 = registry.Add(RegistryMasternode(addr2, pubKey2));
+    BOOST_CHECK(registry.Find(mn1.vin.prevout) == pmn1);
+    BOOST_CHECK(registry.Find(pubKey1) == pmn1);
+    BOOST_CHECK(registry.Find(pubKey2) == (pmn2->vin.prevout < pmn3->vin.prevout ? pmn2 : pmn3));
+    BOOST_CHECK(registry.Find(RandomPubKey()) == NULL);
+    std::vector<CMasternode*> vpFound = registry.FindByAddr(addr1);
+    BOOST_CHECK_EQUAL(vpFound.size(), 2U);
+    BOOST_CHECK(std::count(vpFound.begin(), vpFound.end(), pmn1) == 1);
+    BOOST_CHECK(std::count(vpFound.begin(), vpFound.end(), pmn2) == 1);
+    BOOST_CHECK(registry.FindByAddr(CService("9.9.9.9", 10000)).empty());
+
+    // Pointers stay valid while the registry grows and shrinks around them
+    std::vector<COutPoint> vOutpoints;
+    for (int i = 0; i < 1000; i++) {
+        CMasternode* pmn = registry.Add(RegistryMasternode(CService("10.0.0.1", 10000 + i), RandomPubKey()));
+        BOOST_CHECK(pmn != NULL);
+        vOutpoints.push_back(pmn->vin.prevout);
+    }
+    for (CMasternodeRegistry::iterator it = registry.begin(); it != registry.end(); ) {
+        if (&it->second == pmn1 || &it->second == pmn3) {
+            ++it;
+        } else {
+            it = registry.Erase(it);
+        }
+    }
+    BOOST_CHECK_EQUAL(registry.size(), 2U);
+    BOOST_CHECK(registry.Find(mn1.vin.prevout) == pmn1);
+    BOOST_CHECK(pmn1->vin == mn1.vin);
+    BOOST_CHECK(registry.Find(vOutpoints[0]) == NULL);
+    BOOST_CHECK(registry.Find(pubKey2) == pmn3);
+    BOOST_CHECK_EQUAL(registry.FindByAddr(addr1).size(), 1U);
+    BOOST_CHECK(registry.FindByAddr(CService("10.0.0.1", 10000)).empty());
+
+    // A new key or address takes effect once reindexed
+    pmn1->pubKeyMasternode = pubKey2;
+    pmn1->addr = addr2;
+    registry.Reindex(pmn1, pubKey1, addr1);
+    BOOST_CHECK(registry.Find(pubKey1) == NULL);
+    BOOST_CHECK(registry.FindByAddr(addr1).empty());
+    BOOST_CHECK_EQUAL(registry.FindByAddr(addr2).size(), 2U);
+
+    // Copies of a listed masternode are not reindexed
+    CMasternode mnCopy = *pmn3;
+    registry.Reindex(&mnCopy, pubKey2, addr2);
+    BOOST_CHECK_EQUAL(registry.FindByAddr(addr2).size(), 2U);
+
+    // Stored as a sorted vector and read back with the indexes rebuilt
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << registry;
+    std::vector<CMasternode> vMasternodes;
+    CDataStream(ss) >> vMasternodes;
+    BOOST_CHECK_EQUAL(vMasternodes.size(), 2U);
+    BOOST_CHECK(vMasternodes[0].vin.prevout < vMasternodes[1].vin.prevout);
+    CMasternodeRegistry registry2;
+    ss >> registry2;
+    BOOST_CHECK_EQUAL(registry2.size(), 2U);
+    BOOST_CHECK(registry2.Find(pubKey2) != NULL);
+    BOOST_CHECK_EQUAL(registry2.FindByAddr(addr2).size(), 2U);
+
+    registry.Clear();
+    BOOST_CHECK(registry.empty());
+    BOOST_CHECK(registry.Find(pubKey2) == NULL);
+    BOOST_CHECK(registry.FindByAddr(addr2).empty());
+}
+
+BOOST_AUTO_TEST_CASE(masternode_find_lowest_outpoint)
+{
+    mnodeman.Clear();
+    CPubKey pubKeyCollateral = RandomPubKey(), pubKeyMasternode = RandomPubKey();
+    CScript payee = GetScriptForDestination(pubKeyCollateral.GetID());
+    std::vector<COutPoint> vOutpoints;
+    for (int i = 0; i < 20; i++) {
+        CMasternode mn(CService("1.2.3.4", 10000 + i), CTxIn(COutPoint(GetRandHash(), i % 4)), pubKeyCollateral, pubKeyMasternode, PROTOCOL_VERSION);
+        BOOST_CHECK(mnodeman.Add(mn));
+        vOutpoints.push_back(mn.vin.prevout);
+    }
+    COutPoint outpointLowest = *std::min_element(vOutpoints.begin(), vOutpoints.end());
+
+    // Whatever the order of the list, masternodes sharing a payee or a key resolve to the lowest outpoint
+    BOOST_REQUIRE(mnodeman.Find(payee) != NULL);
+    BOOST_CHECK(mnodeman.Find(payee)->vin.prevout == outpointLowest);
+    BOOST_REQUIRE(mnodeman.Find(pubKeyMasternode) != NULL);
+    BOOST_CHECK(mnodeman.Find(pubKeyMasternode)->vin.prevout == outpointLowest);
+    CMasternode mn;
+    BOOST_CHECK(mnodeman.Get(pubKeyMasternode, mn));
+    BOOST_CHECK(mn.vin.prevout == outpointLowest);
+    BOOST_CHECK(mnodeman.Find(GetScriptForDestination(RandomPubKey().GetID())) == NULL);
+
+    mnodeman.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(masternode_list_diff)
+{
+    mnodeman.Clear();
+    std::vector<CTxIn> vecVins;
+    for (int i = 0; i < 10; i++)
+        vecVins.push_back(AddMasternode(CMasternode::MASTERNODE_ENABLED));
+
+    mnodeman.UpdateListSnapshot(100);
+    uint256 hashSnapshot1 = mnodeman.GetListSnapshotHash();
+    BOOST_CHECK(!hashSnapshot1.IsNull());
+
+    CMasternodeListDiff diff;
+    BOOST_CHECK(mnodeman.GetListDiff(hashSnapshot1, diff));
+    BOOST_CHECK(diff.hashSnapshotBase == hashSnapshot1 && diff.hashSnapshot == hashSnapshot1);
+    BOOST_CHECK_EQUAL(diff.GetEntryCount(), 0U);
+    BOOST_CHECK(!mnodeman.GetListDiff(GetRandHash(), diff));
+
+    // Pings don't change the snapshot hash, but are in the diff
+    mnodeman.Find(vecVins[3])->lastPing.sigTime += 60;
+    mnodeman.UpdateListSnapshot(101);
+    BOOST_CHECK(mnodeman.GetListSnapshotHash() == hashSnapshot1);
+    BOOST_CHECK(mnodeman.GetListDiff(hashSnapshot1, diff));
+    BOOST_CHECK_EQUAL(diff.vecMnb.size(), 0U);
+    BOOST_REQUIRE_EQUAL(diff.vecMnp.size(), 1U);
+    BOOST_CHECK(diff.vecMnp[0].sigTime == mnodeman.Find(vecVins[3])->lastPing.sigTime);
+
+    // A new masternode and a new announcement do
+    vecVins.push_back(AddMasternode(CMasternode::MASTERNODE_ENABLED));
+    mnodeman.Find(vecVins[5])->sigTime += 60;
+    mnodeman.UpdateListSnapshot(102);
+    uint256 hashSnapshot2 = mnodeman.GetListSnapshotHash();
+    BOOST_CHECK(hashSnapshot2 != hashSnapshot1);
+
+    BOOST_CHECK(mnodeman.GetListDiff(hashSnapshot1, diff));
+    BOOST_CHECK(diff.hashSnapshot == hashSnapshot2);
+    BOOST_CHECK_EQUAL(diff.vecRemoved.size(), 0U);
+    BOOST_CHECK_EQUAL(diff.vecMnb.size(), 2U);
+    BOOST_CHECK_EQUAL(diff.vecMnp.size(), 1U);
+    for (size_t i = 0; i < diff.vecMnb.size(); i++)
+        BOOST_CHECK(diff.vecMnb[i].vin == vecVins[5] || diff.vecMnb[i].vin == vecVins.back());
+
+    BOOST_CHECK(mnodeman.GetListDiff(hashSnapshot2, diff));
+    BOOST_CHECK_EQUAL(diff.GetEntryCount(), 0U);
+
+    // Snapshots are forgotten after a while, unless the list is still the same
+    mnodeman.UpdateListSnapshot(1000);
+    BOOST_CHECK(!mnodeman.GetListDiff(hashSnapshot1, diff));
+    BOOST_CHECK(mnodeman.GetListDiff(hashSnapshot2, diff));
+
+    mnodeman.Clear();
+    BOOST_CHECK(mnodeman.GetListSnapshotHash().IsNull());
+}
+
+// The command and payload of the last message queued for a node
+static std::string LastMessage(CNode& node, uint256& hashRet)
+{
+    BOOST_REQUIRE(!node.vSendMsg.empty());
+    CDataStream ss(node.vSendMsg.back().begin(), node.vSendMsg.back().end(), SER_NETWORK, PROTOCOL_VERSION);
+    CMessageHeader hdr(Params().MessageStart());
+    ss >> hdr;
+    hashRet = uint256();
+    if (ss.size() >= hashRet.size())
+        ss >> hashRet;
+    return hdr.GetCommand();
+}
+
+static CMasternodeListDiff ListDiff(const uint256& hashSnapshotBase, const uint256& hashSnapshot)
+{
+    CMasternodeListDiff diff;
+    diff.hashSnapshotBase = hashSnapshotBase;
+    diff.hashSnapshot = hashSnapshot;
+    return diff;
+}
+
+BOOST_AUTO_TEST_CASE(masternode_list_diff_bootstrap)
+{
+    mnodeman.Clear();
+    std::vector<CTxIn> vecVins;
+    for (int i = 0; i < 5; i++)
+        vecVins.push_back(AddMasternode(CMasternode::MASTERNODE_ENABLED));
+    mnodeman.UpdateListSnapshot(100);
+    uint256 hashSnapshot = mnodeman.GetListSnapshotHash();
+
+    // A null base asks for the whole list
+    CMasternodeListDiff diffFull;
+    BOOST_CHECK(mnodeman.GetListDiff(uint256(), diffFull));
+    BOOST_CHECK(diffFull.hashSnapshotBase.IsNull());
+    BOOST_CHECK(diffFull.hashSnapshot == hashSnapshot);
+    BOOST_CHECK_EQUAL(diffFull.vecMnb.size(), vecVins.size());
+    BOOST_CHECK(diffFull.vecRemoved.empty());
+    mnodeman.Clear();
+
+    CMasternodeMan mnodemanNew;
+    CNode node1(INVALID_SOCKET, CAddress(CService("5.6.7.1", 10000)), "", true);
+    CNode node2(INVALID_SOCKET, CAddress(CService("5.6.7.2", 10000)), "", true);
+    CNode node3(INVALID_SOCKET, CAddress(CService("5.6.7.3", 10000)), "", true);
+    CNode node4(INVALID_SOCKET, CAddress(CService("5.6.7.4", 10000)), "", true);
+    node1.nVersion = node2.nVersion = node3.nVersion = node4.nVersion = PROTOCOL_VERSION;
+    uint256 hashBase;
+
+    // A node that never synced asks for the diff since the empty list...
+    BOOST_CHECK(mnodemanNew.GetSyncedListSnapshotHash().IsNull());
+    mnodemanNew.DsegUpdate(&node1);
+    BOOST_CHECK_EQUAL(LastMessage(node1, hashBase), NetMsgType::GETMNLISTDIFF);
+    BOOST_CHECK(hashBase.IsNull());
+
+    // ...but not from peers it did not ask
+    mnodemanNew.ProcessListDiff(&node2, ListDiff(uint256(), hashSnapshot));
+    BOOST_CHECK(mnodemanNew.GetSyncedListSnapshotHash().IsNull());
+
+    // Masternodes that do not pass validation leave the snapshot alone, and the reply is used up
+    mnodemanNew.ProcessListDiff(&node1, diffFull);
+    BOOST_CHECK_EQUAL(mnodemanNew.size(), 0U);
+    BOOST_CHECK(mnodemanNew.GetSyncedListSnapshotHash().IsNull());
+    mnodemanNew.ProcessListDiff(&node1, ListDiff(uint256(), hashSnapshot));
+    BOOST_CHECK(mnodemanNew.GetSyncedListSnapshotHash().IsNull());
+
+    // A reply since another snapshot than the one asked with is not taken either
+    mnodemanNew.DsegUpdate(&node2);
+    mnodemanNew.ProcessListDiff(&node2, ListDiff(GetRandHash(), hashSnapshot));
+    BOOST_CHECK(mnodemanNew.GetSyncedListSnapshotHash().IsNull());
+
+    // An accepted diff since the empty list sets the snapshot to ask the next peer with
+    mnodemanNew.DsegUpdate(&node3);
+    mnodemanNew.ProcessListDiff(&node3, ListDiff(uint256(), hashSnapshot));
+    BOOST_CHECK(mnodemanNew.GetSyncedListSnapshotHash() == hashSnapshot);
+    mnodemanNew.DsegUpdate(&node4);
+    BOOST_CHECK_EQUAL(LastMessage(node4, hashBase), NetMsgType::GETMNLISTDIFF);
+    BOOST_CHECK(hashBase == hashSnapshot);
+
+    // A peer that does not know it has us fall back to dseg
+    mnodemanNew.ProcessListDiff(&node4, ListDiff(uint256(), uint256()));
+    BOOST_CHECK_EQUAL(LastMessage(node4, hashBase), NetMsgType::DSEG);
+    BOOST_CHECK(mnodemanNew.GetSyncedListSnapshotHash() == hashSnapshot);
+}
+
+BOOST_AUTO_TEST_CASE(masternode_list_view)
+{
+    mnodeman.Clear();
+    std::vector<CTxIn> vecVins;
+    for (int i = 0; i < 10; i++)
+        vecVins.push_back(AddMasternode(CMasternode::MASTERNODE_ENABLED));
+
+    masternode_list_view_t pView = mnodeman.GetListView();
+    BOOST_CHECK_EQUAL(pView->vecMasternodes.size(), vecVins.size());
+    // Unchanged list, same view
+    BOOST_CHECK(mnodeman.GetListView() == pView);
+    for (size_t i = 0; i < vecVins.size(); i++) {
+        BOOST_REQUIRE(pView->Find(vecVins[i].prevout) != NULL);
+        BOOST_CHECK(pView->Find(vecVins[i].prevout)->vin == vecVins[i]);
+        BOOST_CHECK(mnodeman.Has(vecVins[i]));
+        BOOST_CHECK(mnodeman.GetMasternodeInfo(vecVins[i]).fInfoValid);
+    }
+    BOOST_CHECK(pView->Find(COutPoint(GetRandHash(), 0)) == NULL);
+    BOOST_CHECK_EQUAL(mnodeman.CountEnabled(PROTOCOL_VERSION), (int)vecVins.size());
+
+    // Changes show up in a new view, the old one stays as it was
+    vecVins.push_back(AddMasternode(CMasternode::MASTERNODE_ENABLED));
+    mnodeman.CheckMasternode(vecVins[0], true);
+    BOOST_CHECK(mnodeman.Has(vecVins.back()));
+    BOOST_CHECK_EQUAL(mnodeman.GetMasternodeInfo(vecVins[0]).nActiveState, CMasternode::MASTERNODE_OUTPOINT_SPENT);
+    BOOST_CHECK_EQUAL(mnodeman.CountEnabled(PROTOCOL_VERSION), (int)vecVins.size() - 1);
+    BOOST_CHECK(pView->Find(vecVins.back().prevout) == NULL);
+    BOOST_CHECK_EQUAL(pView->Find(vecVins[0].prevout)->nActiveState, CMasternode::MASTERNODE_ENABLED);
+
+    mnodeman.Clear();
+    BOOST_CHECK(!mnodeman.Has(vecVins[1]));
+    BOOST_CHECK_EQUAL(pView->vecMasternodes.size(), vecVins.size() - 1);
+}
+
+BOOST_AUTO_TEST_CASE(masternode_db)
+{
+    mnodeman.Clear();
+    std::vector<CTxIn> vecVins;
+    for (int i = 0; i < 20; i++)
+        vecVins.push_back(AddMasternode(CMasternode::MASTERNODE_ENABLED));
+    std::vector<CMasternodePing> vecPings(3);
+    for (size_t i = 0; i < vecPings.size(); i++) {
+        vecPings[i].vin = vecVins[i];
+        vecPings[i].sigTime = 1000;
+        mnodeman.SetMasternodeLastPing(vecVins[i], vecPings[i]);
+    }
+
+    {
+        CMasternodeDB db(1 << 20, false, true);
+        BOOST_CHECK(db.IsEmpty());
+        BOOST_CHECK(db.LoadMasternodes(mnodeman));
+        BOOST_CHECK(db.Write(mnodeman));
+
+        // Changes since are written over the records
+        CMasternodePing mnpLast = vecPings[1];
+        mnpLast.sigTime = 2000;
+        mnodeman.SetMasternodeLastPing(vecVins[1], mnpLast);
+        mnodeman.CheckMasternode(vecVins[2], true);
+        mnodeman.EraseSeenPing(vecPings[0].GetHash());
+        BOOST_CHECK(db.Write(mnodeman, true));
+
+        // Nothing else is written, even if it changed without being flagged
+        mnodeman.Find(vecVins[3])->sigTime += 60;
+        BOOST_CHECK(db.Write(mnodeman, true));
+        mnodeman.Find(vecVins[3])->sigTime -= 60;
+    }
+
+    {
+        CMasternodeMan mnodemanLoaded;
+        CMasternodeDB db(1 << 20);
+        BOOST_CHECK(db.IsCurrentFormat());
+        BOOST_CHECK(db.LoadMasternodes(mnodemanLoaded));
+        BOOST_CHECK_EQUAL(mnodemanLoaded.size(), vecVins.size());
+        for (size_t i = 0; i < vecVins.size(); i++) {
+            BOOST_REQUIRE(mnodemanLoaded.Find(vecVins[i]) != NULL);
+            BOOST_CHECK_EQUAL(mnodemanLoaded.Find(vecVins[i])->sigTime, mnodeman.Find(vecVins[i])->sigTime);
+            BOOST_CHECK_EQUAL(mnodemanLoaded.Find(vecVins[i])->lastPing.sigTime, mnodeman.Find(vecVins[i])->lastPing.sigTime);
+            BOOST_CHECK_EQUAL(mnodemanLoaded.Find(vecVins[i])->nActiveState, mnodeman.Find(vecVins[i])->nActiveState);
+        }
+        BOOST_CHECK_EQUAL(mnodemanLoaded.Find(vecVins[1])->lastPing.sigTime, 2000);
+
+        // Seen messages come later, without replacing those seen meanwhile
+        BOOST_CHECK(mnodemanLoaded.mapSeenMasternodePing.empty());
+        CMasternodePing mnpNew = vecPings[1];
+        mnodemanLoaded.mapSeenMasternodePing.insert(std::make_pair(mnpNew.GetHash(), mnpNew));
+        BOOST_CHECK(db.LoadSeenMessages(mnodemanLoaded));
+        BOOST_CHECK_EQUAL(mnodemanLoaded.mapSeenMasternodePing.size(), 3U);
+        BOOST_CHECK(!mnodemanLoaded.mapSeenMasternodePing.count(vecPings[0].GetHash()));
+
+        // Removing everything removes the records
+        mnodemanLoaded.Clear();
+        BOOST_CHECK(db.Write(mnodemanLoaded, true));
+        mnodemanLoaded.Clear();
+        BOOST_CHECK(db.LoadMasternodes(mnodemanLoaded));
+        BOOST_CHECK_EQUAL(mnodemanLoaded.size(), 0U);
+    }
+
+    mnodeman.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(masternode_flat_db)
+{
+    CAddress addr(CService("1.2.3.4", 10000));
+    CNetFulfilledRequestManager fulfilled;
+    fulfilled.AddFulfilledRequest(addr, "mnsync");
+
+    CFlatDB<CNetFulfilledRequestManager> flatdb("netfulfilled_test.dat", "magicFulfilledCache");
+    boost::filesystem::path path = GetDataDir() / "netfulfilled_test.dat";
+    BOOST_CHECK(flatdb.Dump(fulfilled));
+    BOOST_CHECK(!boost::filesystem::exists(path.string() + ".new"));
+
+    CNetFulfilledRequestManager fulfilledLoaded;
+    BOOST_CHECK(flatdb.Load(fulfilledLoaded));
+    BOOST_CHECK(fulfilledLoaded.HasFulfilledRequest(addr, "mnsync"));
+
+    // Rewriting replaces the file as a whole
+    fulfilled.RemoveFulfilledRequest(addr, "mnsync");
+    BOOST_CHECK(flatdb.Dump(fulfilled));
+    fulfilledLoaded.Clear();
+    BOOST_CHECK(flatdb.Load(fulfilledLoaded));
+    BOOST_CHECK(!fulfilledLoaded.HasFulfilledRequest(addr, "mnsync"));
+
+    // A file under another magic message is left alone
+    CFlatDB<CNetFulfilledRequestManager> flatdbOther("netfulfilled_test.dat", "magicOtherCache");
+    BOOST_CHECK(!flatdbOther.Load(fulfilledLoaded));
+    BOOST_CHECK(!flatdbOther.Dump(fulfilled));
+
+    // So is a corrupted one
+    fulfilled.AddFulfilledRequest(addr, "mnsync");
+    BOOST_CHECK(flatdb.Dump(fulfilled));
+    {
+        FILE* file = fopen(path.string().c_str(), "r+b");
+        BOOST_REQUIRE(file != NULL);
+        fseek(file, -40, SEEK_END);
+        int c = fgetc(file);
+        fseek(file, -40, SEEK_END);
+        fputc(c ^ 0xff, file);
+        fclose(file);
+    }
+    BOOST_CHECK(!flatdb.Load(fulfilledLoaded));
+    BOOST_CHECK(!fulfilledLoaded.HasFulfilledRequest(addr, "mnsync"));
+    BOOST_CHECK(!flatdb.Dump(fulfilled));
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(masternode_signature_batch)
+{
+    CMasternodeSignatureBatch batch;
+    std::vector<CKey> vKeys;
+    std::vector<uint256> vHashes;
+    std::vector<std::vector<unsigned char> > vSigs;
+    for (int i = 0; i < 20; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        uint256 hash = GetRandHash();
+        std::vector<unsigned char> vchSig;
+        BOOST_CHECK(darkSendSigner.SignHash(hash, vchSig, key));
+        vKeys.push_back(key);
+        vHashes.push_back(hash);
+        vSigs.push_back(vchSig);
+    }
+
+    // Every other signature is checked against the wrong key
+    for (size_t i = 0; i < vKeys.size(); i++)
+        batch.Add(vKeys[i % 2 ? i : (i + 2) % vKeys.size()].GetPubKey(), vSigs[i], vHashes[i]);
+    BOOST_CHECK(!batch.IsVerified(vKeys[1].GetPubKey(), vSigs[1], vHashes[1]));
+    batch.Verify();
+    for (size_t i = 0; i < vKeys.size(); i++) {
+        BOOST_CHECK_EQUAL(batch.IsVerified(vKeys[i].GetPubKey(), vSigs[i], vHashes[i]), i % 2 == 1);
+        BOOST_CHECK(!batch.IsVerified(vKeys[(i + 2) % vKeys.size()].GetPubKey(), vSigs[i], vHashes[i]));
+    }
+    // Each verified signature is taken only once
+    BOOST_CHECK(!batch.IsVerified(vKeys[1].GetPubKey(), vSigs[1], vHashes[1]));
+
+    batch.Add(vKeys[3].GetPubKey(), vSigs[3], vHashes[3]);
+    batch.Verify();
+    batch.Clear();
+    BOOST_CHECK(!batch.IsVerified(vKeys[3].GetPubKey(), vSigs[3], vHashes[3]));
+    BOOST_CHECK(!mnodeman.IsSignatureVerified(vKeys[3].GetPubKey(), vSigs[3], vHashes[3]));
+}
+
+BOOST_AUTO_TEST_CASE(masternode_message_signature_forms)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CMasternodePaymentVote vote(CTxIn(COutPoint(GetRandHash(), 1)), 1000, GetScriptForDestination(key.GetPubKey().GetID()));
+    std::string strError;
+
+    // Until SPORK_6_NEW_SIGS, signers keep to the string form
+    BOOST_CHECK(!darkSendSigner.IsNewSigsActive());
+    BOOST_CHECK(darkSendSigner.GetSignedHash(vote) == CDarkSendSigner::GetMessageHash(vote.GetSignatureMessage()));
+    BOOST_CHECK(vote.GetSignatureHash() != CDarkSendSigner::GetMessageHash(vote.GetSignatureMessage()));
+    BOOST_CHECK(darkSendSigner.Sign(vote, vote.vchSig, key));
+    BOOST_CHECK(darkSendSigner.VerifyMessage(key.GetPubKey(), vote.vchSig, vote.GetSignatureMessage(), strError));
+    BOOST_CHECK(darkSendSigner.Verify(vote, key.GetPubKey(), vote.vchSig, strError));
+
+    // Signatures of the digest are accepted as well
+    BOOST_CHECK(darkSendSigner.SignHash(vote.GetSignatureHash(), vote.vchSig, key));
+    BOOST_CHECK(darkSendSigner.Verify(vote, key.GetPubKey(), vote.vchSig, strError));
+    BOOST_CHECK(!darkSendSigner.VerifyMessage(key.GetPubKey(), vote.vchSig, vote.GetSignatureMessage(), strError));
+
+    // Neither form covers a changed vote
+    CMasternodePaymentVote voteChanged = vote;
+    voteChanged.nBlockHeight++;
+    BOOST_CHECK(!darkSendSigner.Verify(voteChanged, key.GetPubKey(), vote.vchSig, strError));
+    BOOST_CHECK(darkSendSigner.Sign(vote, vote.vchSig, key));
+    BOOST_CHECK(!darkSendSigner.Verify(voteChanged, key.GetPubKey(), vote.vchSig, strError));
+
+    // Nor another key
+    CKey keyOther;
+    keyOther.MakeNewKey(true);
+    BOOST_CHECK(!darkSendSigner.Verify(vote, keyOther.GetPubKey(), vote.vchSig, strError));
+
+    // The digest is of the message type followed by the fields, never of the fields alone
+    CHashWriter ssFields(SER_GETHASH, PROTOCOL_VERSION);
+    ssFields << vote.vinMasternode.prevout << vote.nBlockHeight << *(CScriptBase*)(&vote.payee);
+    CHashWriter ssTagged(SER_GETHASH, PROTOCOL_VERSION);
+    ssTagged << std::string(NetMsgType::MASTERNODEPAYMENTVOTE) << vote.vinMasternode.prevout << vote.nBlockHeight << *(CScriptBase*)(&vote.payee);
+    BOOST_CHECK(vote.GetSignatureHash() != ssFields.GetHash());
+    BOOST_CHECK(vote.GetSignatureHash() == ssTagged.GetHash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "script/sigcache.h"
+#include "random.h"
+#include "test/test_mue.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sigcache_tests, BasicTestingSetup)
+
+static std::vector<uint256> RandomEntries(size_t n)
+{
+    std::vector<uint256> entries(n);
+    for (size_t i = 0; i < n; i++)
+        entries[i] = GetRandHash();
+    return entries;
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_set_get_erase)
+{
+    CSignatureCache cache(1 << 20);
+    std::vector<uint256> entries = RandomEntries(1000);
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        BOOST_CHECK(!cache.Get(entries[i]));
+        cache.Set(entries[i]);
+    }
+    for (size_t i = 0; i < entries.size(); i++)
+        BOOST_CHECK(cache.Get(entries[i]));
+
+    // Setting an entry twice does not take a second slot
+    cache.Set(entries[0]);
+    cache.Erase(entries[0]);
+    BOOST_CHECK(!cache.Get(entries[0]));
+
+    CSignatureCacheStats stats;
+    cache.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.nEntries, entries.size() - 1);
+    BOOST_CHECK_EQUAL(stats.nHits, entries.size());
+    BOOST_CHECK_EQUAL(stats.nMisses, entries.size() + 1);
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_fixed_size)
+{
+    CSignatureCache cache(1 << 16);
+    CSignatureCacheStats stats;
+    cache.GetStats(stats);
+    BOOST_CHECK(stats.nCapacity > 0);
+    BOOST_CHECK(stats.nCapacity * (sizeof(uint256) + 1) <= (1 << 16));
+
+    // Overfill the cache: it never grows, and what was inserted last is
+    // (barring an unlucky bucket collision) still there.
+    std::vector<uint256> entries = RandomEntries(stats.nCapacity * 4);
+    for (size_t i = 0; i < entries.size(); i++)
+        cache.Set(entries[i]);
+    cache.GetStats(stats);
+    BOOST_CHECK(stats.nEntries <= stats.nCapacity);
+
+    size_t nRecent = stats.nCapacity / 8, nFound = 0;
+    for (size_t i = entries.size() - nRecent; i < entries.size(); i++)
+        nFound += cache.Get(entries[i]);
+    BOOST_CHECK(nFound >= nRecent * 9 / 10);
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_disabled)
+{
+    CSignatureCache cache(0);
+    uint256 entry = GetRandHash();
+    cache.Set(entry);
+    BOOST_CHECK(!cache.Get(entry));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include "chainparams.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "crypto/x11.h"
 #include "key.h"
 #include "main.h"
 #include "miner.h"
@@ -36,6 +37,7 @@ extern void noui_connect();
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
 {
     ECC_Start();
+    X11AutoDetect();
     SetupEnvironment();
     SetupNetworking();
     fPrintToDebugLog = false; // don't want to write to debug.log file
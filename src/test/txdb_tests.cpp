@@ -0,0 +1,269 @@
+// Copyright (c) 2014-2017 The MonetaryUnit Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "main.h"
+#include "random.h"
+#include "script/script.h"
+#include "txdb.h"
+
+#include "test/test_mue.h"
+
+#include <map>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+class CCoinsViewDBTest : public CCoinsViewDB
+{
+public:
+    CCoinsViewDBTest() : CCoinsViewDB(1 << 20, true) {}
+
+    //! Store coins the way versions before per-output records did
+    void WriteLegacy(const uint256& txid, const CCoins& coins)
+    {
+        BOOST_CHECK(db.Write(std::make_pair('c', txid), coins));
+    }
+
+    bool HaveLegacy(const uint256& txid)
+    {
+        return db.Exists(std::make_pair('c', txid));
+    }
+};
+
+CCoins RandomCoins(unsigned int nOutputs)
+{
+    CCoins coins;
+    coins.nVersion = 1;
+    coins.nHeight = 1 + insecure_rand() % 1000;
+    coins.fCoinBase = insecure_rand() & 1;
+    coins.vout.resize(nOutputs);
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        coins.vout[i].nValue = 1 + insecure_rand() % 100000;
+        coins.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << ToByteVector(GetRandHash()) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return coins;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, TestingSetup)
+
+static void ClearBlockIndex()
+{
+    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        delete item.second;
+    mapBlockIndex.clear();
+}
+
+BOOST_AUTO_TEST_CASE(load_block_index_checks_pow)
+{
+    unsigned int nBits = UintToArith256(Params().GetConsensus().powLimit).GetCompact();
+    std::vector<uint256> hashes(2000);
+    std::vector<CBlockIndex> indexes(hashes.size());
+    std::vector<const CBlockIndex*> vpindex;
+    for (size_t i = 0; i < indexes.size(); i++) {
+        hashes[i] = ArithToUint256(arith_uint256(i + 1));
+        indexes[i].phashBlock = &hashes[i];
+        indexes[i].pprev = i ? &indexes[i - 1] : NULL;
+        indexes[i].nHeight = i;
+        indexes[i].nBits = nBits;
+        vpindex.push_back(&indexes[i]);
+    }
+    // One entry whose hash does not meet its claimed target.
+    hashes[1500] = ArithToUint256(~arith_uint256(0));
+
+    CBlockTreeDB db(1 << 20, true);
+    BOOST_CHECK(db.WriteBatchSync(std::vector<std::pair<int, const CBlockFileInfo*> >(), 0, vpindex));
+
+    // Keep the fixture's own index out of the way while loading into mapBlockIndex.
+    BlockMap mapSaved;
+    mapSaved.swap(mapBlockIndex);
+
+    BOOST_CHECK(!db.LoadBlockIndexGuts());
+    ClearBlockIndex();
+
+    BOOST_CHECK(!db.LoadBlockIndexGuts(1499));
+    ClearBlockIndex();
+
+    // Trusting everything up to and including the bad entry loads the full index.
+    BOOST_CHECK(db.LoadBlockIndexGuts(1500));
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), indexes.size());
+    BlockMap::const_iterator it = mapBlockIndex.find(hashes[1999]);
+    BOOST_CHECK(it != mapBlockIndex.end() && it->second->nHeight == 1999 && *it->second->pprev->phashBlock == hashes[1998]);
+    ClearBlockIndex();
+
+    mapBlockIndex.swap(mapSaved);
+}
+
+BOOST_AUTO_TEST_CASE(coins_per_output)
+{
+    CCoinsViewDB db(1 << 20, true);
+    uint256 txid = GetRandHash();
+    CCoins coins = RandomCoins(200);
+    {
+        CCoinsViewCache cache(&db);
+        *cache.ModifyNewCoins(txid) = coins;
+        cache.SetBestBlock(chainActive.Tip()->GetBlockHash());
+        BOOST_CHECK(cache.Flush());
+    }
+    CCoins read;
+    BOOST_CHECK(db.HaveCoins(txid));
+    BOOST_CHECK(db.GetCoins(txid, read));
+    BOOST_CHECK(read == coins);
+    BOOST_CHECK(!db.HaveCoins(GetRandHash()));
+
+    // Spend outputs through a stack of caches, like ConnectBlock does.
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyCoins(txid)->Spend(7);
+        {
+            CCoinsViewCache child(&cache);
+            child.ModifyCoins(txid)->Spend(3);
+            child.ModifyCoins(txid)->Spend(199);
+            BOOST_CHECK(child.Flush());
+        }
+        BOOST_CHECK(cache.Flush());
+    }
+    coins.Spend(3);
+    coins.Spend(7);
+    coins.Spend(199);
+    BOOST_CHECK(db.GetCoins(txid, read));
+    BOOST_CHECK(read == coins);
+    BOOST_CHECK_EQUAL(read.vout.size(), 199U);
+
+    // Rewriting identical coins changes nothing; clearing them, as a
+    // disconnect does, removes every output.
+    {
+        CCoinsViewCache cache(&db);
+        *cache.ModifyCoins(txid) = coins;
+        cache.ModifyCoins(txid)->Clear();
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(!db.HaveCoins(txid));
+    BOOST_CHECK(!db.GetCoins(txid, read));
+}
+
+BOOST_AUTO_TEST_CASE(coins_per_output_simulation)
+{
+    // Randomly spend and restore outputs through a stack of caches, flushing
+    // now and then, and check that the database always ends up matching.
+    CCoinsViewDB db(1 << 20, true);
+    std::map<uint256, CCoins> result;
+    std::vector<uint256> txids;
+    for (int i = 0; i < 20; i++) {
+        txids.push_back(GetRandHash());
+        result[txids.back()] = RandomCoins(1 + insecure_rand() % 30);
+    }
+    std::map<uint256, CCoins> full = result;
+    {
+        CCoinsViewCache cache(&db);
+        for (std::map<uint256, CCoins>::iterator it = result.begin(); it != result.end(); it++)
+            *cache.ModifyNewCoins(it->first) = it->second;
+        cache.SetBestBlock(chainActive.Tip()->GetBlockHash());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    for (int round = 0; round < 50; round++) {
+        CCoinsViewCache cache(&db);
+        CCoinsViewCache child(&cache);
+        for (int i = 0; i < 40; i++) {
+            const uint256& txid = txids[insecure_rand() % txids.size()];
+            CCoins& expected = result[txid];
+            const CCoins& original = full[txid];
+            unsigned int n = insecure_rand() % original.vout.size();
+            if (insecure_rand() % 8 == 0) {
+                // Change the metadata too, which affects every output.
+                CCoinsModifier modifier = child.ModifyCoins(txid);
+                *modifier = original;
+                modifier->nHeight++;
+                expected = original;
+                expected.nHeight++;
+                full[txid].nHeight++;
+            } else if (expected.IsAvailable(n)) {
+                child.ModifyCoins(txid)->Spend(n);
+                expected.Spend(n);
+            } else {
+                CCoinsModifier modifier = child.ModifyCoins(txid);
+                if (modifier->IsPruned()) {
+                    modifier->nVersion = original.nVersion;
+                    modifier->nHeight = original.nHeight;
+                    modifier->fCoinBase = original.fCoinBase;
+                }
+                if (modifier->vout.size() <= n)
+                    modifier->vout.resize(n + 1);
+                modifier->vout[n] = original.vout[n];
+                if (expected.vout.size() <= n)
+                    expected.vout.resize(n + 1);
+                expected.vout[n] = original.vout[n];
+                expected.nVersion = original.nVersion;
+                expected.nHeight = original.nHeight;
+                expected.fCoinBase = original.fCoinBase;
+            }
+            expected.Cleanup();
+            if (insecure_rand() % 10 == 0)
+                BOOST_CHECK(child.Flush());
+        }
+        BOOST_CHECK(child.Flush());
+        BOOST_CHECK(cache.Flush());
+
+        for (std::map<uint256, CCoins>::iterator it = result.begin(); it != result.end(); it++) {
+            CCoins read;
+            BOOST_CHECK_EQUAL(db.GetCoins(it->first, read), !it->second.IsPruned());
+            BOOST_CHECK(read.IsPruned() ? it->second.IsPruned() : read == it->second);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(coins_upgrade)
+{
+    CCoinsViewDBTest legacy;
+    CCoinsViewDB current(1 << 20, true);
+    CCoinsViewCache cache(&current);
+    std::vector<uint256> txids;
+    for (int i = 0; i < 100; i++) {
+        txids.push_back(GetRandHash());
+        CCoins coins = RandomCoins(2 + insecure_rand() % 10);
+        if (i % 3 == 0)
+            coins.Spend(0);
+        coins.Cleanup();
+        legacy.WriteLegacy(txids.back(), coins);
+        *cache.ModifyNewCoins(txids.back()) = coins;
+    }
+    cache.SetBestBlock(chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(cache.Flush());
+    CCoinsMap empty;
+    BOOST_CHECK(legacy.BatchWrite(empty, chainActive.Tip()->GetBlockHash()));
+
+    BOOST_CHECK(!legacy.HaveCoins(txids[0]));
+    BOOST_CHECK(legacy.Upgrade());
+    for (size_t i = 0; i < txids.size(); i++) {
+        BOOST_CHECK(!legacy.HaveLegacy(txids[i]));
+        CCoins coins, expected;
+        BOOST_CHECK(legacy.GetCoins(txids[i], coins));
+        BOOST_CHECK(current.GetCoins(txids[i], expected));
+        BOOST_CHECK(coins == expected);
+    }
+
+    // Statistics are the same as for a database written in the new format.
+    CCoinsStats statsUpgraded, statsCurrent;
+    BOOST_CHECK(legacy.GetStats(statsUpgraded));
+    BOOST_CHECK(current.GetStats(statsCurrent));
+    BOOST_CHECK_EQUAL(statsUpgraded.nTransactions, txids.size());
+    BOOST_CHECK_EQUAL(statsUpgraded.nTransactions, statsCurrent.nTransactions);
+    BOOST_CHECK_EQUAL(statsUpgraded.nTransactionOutputs, statsCurrent.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(statsUpgraded.nTotalAmount, statsCurrent.nTotalAmount);
+    BOOST_CHECK(statsUpgraded.hashSerialized == statsCurrent.hashSerialized);
+
+    // Upgrading again is a no-op.
+    BOOST_CHECK(legacy.Upgrade());
+    BOOST_CHECK(legacy.HaveCoins(txids[0]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include "key.h"
 #include "main.h"
 #include "miner.h"
+#include "policy/policy.h"
 #include "pubkey.h"
 #include "txmempool.h"
 #include "random.h"
@@ -83,4 +84,98 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(tx_mempool_multi_input_scripts, TestChain100Setup)
+{
+    // Transactions with several inputs have their signatures checked on the
+    // script check threads; a bad signature on any input must still be caught
+    // and reported the same way as on the serial path.
+
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Only the first coinbase is mature; split it so there are several
+    // outputs to spend at once.
+    CMutableTransaction split;
+    split.vin.resize(1);
+    split.vin[0].prevout.hash = coinbaseTxns[0].GetHash();
+    split.vin[0].prevout.n = 0;
+    split.vout.resize(3);
+    for (unsigned int i = 0; i < split.vout.size(); i++)
+    {
+        split.vout[i].nValue = 11*CENT;
+        split.vout[i].scriptPubKey = scriptPubKey;
+    }
+    {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, split, 0, SIGHASH_ALL);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        split.vin[0].scriptSig << vchSig;
+    }
+    std::vector<CMutableTransaction> splitTxns(1, split);
+    CBlock block = CreateAndProcessBlock(splitTxns, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+
+    CMutableTransaction spend;
+    spend.vin.resize(split.vout.size());
+    for (unsigned int i = 0; i < spend.vin.size(); i++)
+    {
+        spend.vin[i].prevout.hash = split.GetHash();
+        spend.vin[i].prevout.n = i;
+    }
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 30*CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+
+    std::vector<std::vector<unsigned char> > vSigs(spend.vin.size());
+    for (unsigned int i = 0; i < spend.vin.size(); i++)
+    {
+        uint256 hash = SignatureHash(scriptPubKey, spend, i, SIGHASH_ALL);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vSigs[i]));
+        vSigs[i].push_back((unsigned char)SIGHASH_ALL);
+    }
+
+    // Corrupt the signature of the last input only.
+    CMutableTransaction badSpend = spend;
+    for (unsigned int i = 0; i < badSpend.vin.size(); i++)
+    {
+        std::vector<unsigned char> vchSig = vSigs[i];
+        if (i == badSpend.vin.size() - 1)
+            vchSig[vchSig.size() / 2] ^= 0x01;
+        badSpend.vin[i].scriptSig = CScript() << vchSig;
+    }
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(!AcceptToMemoryPool(mempool, state, badSpend, false, NULL, true, false));
+        int nDoS = 0;
+        BOOST_CHECK(state.IsInvalid(nDoS));
+        BOOST_CHECK_EQUAL(nDoS, 100);
+        BOOST_CHECK(state.GetRejectReason().find("mandatory-script-verify-flag-failed") == 0);
+    }
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+
+    for (unsigned int i = 0; i < spend.vin.size(); i++)
+        spend.vin[i].scriptSig = CScript() << vSigs[i];
+    BOOST_CHECK(ToMemPool(spend));
+    BOOST_CHECK_EQUAL(mempool.size(), 1);
+
+    // Having passed, the transaction is in the script execution cache for
+    // the flags it was checked with, so no script checks are queued for it.
+    // Looking it up without storing removes it.
+    {
+        LOCK(cs_main);
+        CCoinsViewCache view(pcoinsTip);
+        CValidationState state;
+        std::vector<CScriptCheck> vChecks;
+        BOOST_CHECK(CheckInputs(spend, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, false, &vChecks));
+        BOOST_CHECK(vChecks.empty());
+        BOOST_CHECK(CheckInputs(spend, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, false, &vChecks));
+        BOOST_CHECK_EQUAL(vChecks.size(), spend.vin.size());
+        vChecks.clear();
+        BOOST_CHECK(CheckInputs(spend, state, view, true, SCRIPT_VERIFY_NONE, false, &vChecks));
+        BOOST_CHECK_EQUAL(vChecks.size(), spend.vin.size());
+    }
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,10 +7,15 @@
 
 #include "chain.h"
 #include "chainparams.h"
+#include "checkqueue.h"
+#include "consensus/consensus.h"
 #include "hash.h"
+#include "init.h"
 #include "main.h"
 #include "pow.h"
+#include "ui_interface.h"
 #include "uint256.h"
+#include "util.h"
 
 #include <stdint.h>
 
@@ -18,6 +23,7 @@
 
 using namespace std;
 
+static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
@@ -33,16 +39,115 @@ static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 
 
+namespace {
+
+/**
+ * Key of a single unspent output in the coin database. All outputs of a
+ * transaction share the (DB_COIN, txid) prefix, so they are adjacent.
+ */
+struct CoinEntry
+{
+    char key;
+    uint256 txid;
+    uint32_t n;
+
+    CoinEntry() : key(DB_COIN), n(0) {}
+    CoinEntry(const uint256& txidIn, uint32_t nIn) : key(DB_COIN), txid(txidIn), n(nIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(key);
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+    }
+};
+
+/**
+ * Value of a single unspent output: the metadata of its transaction
+ * (as in CCoins) followed by the compressed output.
+ */
+struct CoinValue
+{
+    int nVersion;
+    int nHeight;
+    bool fCoinBase;
+    CTxOut out;
+
+    CoinValue() : nVersion(0), nHeight(0), fCoinBase(false) {}
+    CoinValue(const CCoins& coins, uint32_t n) : nVersion(coins.nVersion), nHeight(coins.nHeight), fCoinBase(coins.fCoinBase), out(coins.vout[n]) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        unsigned int nCode = nHeight * 2 + (fCoinBase ? 1 : 0);
+        READWRITE(VARINT(this->nVersion));
+        READWRITE(VARINT(nCode));
+        CTxOutCompressor txout(out);
+        READWRITE(txout);
+        if (ser_action.ForRead()) {
+            nHeight = nCode / 2;
+            fCoinBase = nCode & 1;
+        }
+    }
+};
+
+/**
+ * Read the outputs of txid, starting at the cursor, into coins. The cursor
+ * is left at the first key past them. Returns false if there are none.
+ */
+bool ReadCoins(CDBIterator& cursor, const uint256& txid, CCoins& coins, uint64_t* pnSerializedSize = NULL)
+{
+    coins.Clear();
+    bool fFound = false;
+    for (; cursor.Valid(); cursor.Next()) {
+        CoinEntry key;
+        if (!cursor.GetKey(key) || key.key != DB_COIN || key.txid != txid)
+            break;
+        CoinValue value;
+        if (!cursor.GetValue(value) || key.n >= MAX_BLOCK_SIZE)
+            return error("%s: unable to read output %s:%u", __func__, txid.ToString(), key.n);
+        if (key.n >= coins.vout.size())
+            coins.vout.resize(key.n + 1);
+        coins.vout[key.n] = value.out;
+        coins.nVersion = value.nVersion;
+        coins.nHeight = value.nHeight;
+        coins.fCoinBase = value.fCoinBase;
+        if (pnSerializedSize)
+            *pnSerializedSize += cursor.GetValueSize();
+        fFound = true;
+    }
+    return fFound;
+}
+
+/** Queue writes for all unspent outputs of coins */
+void WriteCoins(CDBBatch& batch, const uint256& txid, const CCoins& coins)
+{
+    for (unsigned int i = 0; i < coins.vout.size(); i++) {
+        if (coins.IsAvailable(i))
+            batch.Write(CoinEntry(txid, i), CoinValue(coins, i));
+    }
+}
+
+}
+
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
 {
 }
 
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
+    pcursor->Seek(CoinEntry(txid, 0));
+    return ReadCoins(*pcursor, txid, coins);
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
+    pcursor->Seek(CoinEntry(txid, 0));
+    CoinEntry key;
+    return pcursor->Valid() && pcursor->GetKey(key) && key.key == DB_COIN && key.txid == txid;
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -54,14 +159,42 @@ uint256 CCoinsViewDB::GetBestBlock() const {
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(&db.GetObfuscateKey());
+    boost::scoped_ptr<CDBIterator> pcursor;
     size_t count = 0;
     size_t changed = 0;
+    size_t outputs = 0;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(make_pair(DB_COINS, it->first));
-            else
-                batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
+            const uint256& txid = it->first;
+            const CCoins& coins = it->second.coins;
+            if (it->second.flags & CCoinsCacheEntry::PARTIAL) {
+                // Only touch the outputs that were spent or created.
+                const std::vector<uint32_t>& vDirty = it->second.vDirtyOutputs;
+                for (std::vector<uint32_t>::const_iterator itOut = vDirty.begin(); itOut != vDirty.end(); ++itOut) {
+                    if (coins.IsAvailable(*itOut))
+                        batch.Write(CoinEntry(txid, *itOut), CoinValue(coins, *itOut));
+                    else
+                        batch.Erase(CoinEntry(txid, *itOut));
+                }
+                outputs += vDirty.size();
+            } else {
+                if (!(it->second.flags & CCoinsCacheEntry::FRESH)) {
+                    // Anything may have changed; erase whatever is stored that is not available anymore.
+                    if (!pcursor)
+                        pcursor.reset(db.NewIterator());
+                    for (pcursor->Seek(CoinEntry(txid, 0)); pcursor->Valid(); pcursor->Next()) {
+                        CoinEntry key;
+                        if (!pcursor->GetKey(key) || key.key != DB_COIN || key.txid != txid)
+                            break;
+                        if (!coins.IsAvailable(key.n)) {
+                            batch.Erase(key);
+                            outputs++;
+                        }
+                    }
+                }
+                WriteCoins(batch, txid, coins);
+                outputs += coins.vout.size();
+            }
             changed++;
         }
         count++;
@@ -71,10 +204,58 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed transactions (%u outputs) (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)outputs, (unsigned int)count);
     return db.WriteBatch(batch);
 }
 
+bool CCoinsViewDB::Upgrade() {
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(make_pair(DB_COINS, uint256()));
+    std::pair<char, uint256> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_COINS)
+        return true;
+
+    int64_t nStart = GetTimeMillis();
+    LogPrintf("Upgrading chainstate database to per-output records...\n");
+    uiInterface.ShowProgress(_("Upgrading chainstate database..."), 0);
+    size_t count = 0;
+    int nReported = 0;
+    while (pcursor->Valid()) {
+        // Convert in batches that each erase the old records they replace,
+        // so an interrupted upgrade picks up where it left off.
+        CDBBatch batch(&db.GetObfuscateKey());
+        size_t nBatch = 0;
+        for (; pcursor->Valid() && nBatch < COINS_UPGRADE_BATCH_SIZE; pcursor->Next()) {
+            boost::this_thread::interruption_point();
+            if (!pcursor->GetKey(key) || key.first != DB_COINS)
+                break;
+            CCoins coins;
+            if (!pcursor->GetValue(coins))
+                return error("%s: unable to read coins %s", __func__, key.second.ToString());
+            WriteCoins(batch, key.second, coins);
+            batch.Erase(key);
+            nBatch++;
+        }
+        if (nBatch == 0)
+            break;
+        if (!db.WriteBatch(batch))
+            return error("%s: failed to write upgraded coins", __func__);
+        count += nBatch;
+        // Keys are ordered by txid, so its leading bytes tell how far along we are.
+        int nProgress = ((key.second.begin()[0] << 8) | key.second.begin()[1]) * 100 / 65536;
+        if (nProgress > nReported) {
+            nReported = nProgress;
+            uiInterface.ShowProgress(_("Upgrading chainstate database..."), nProgress);
+        }
+        if (ShutdownRequested())
+            break;
+    }
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("Upgraded %u transactions in the chainstate database%s (%dms)\n", (unsigned int)count,
+              ShutdownRequested() ? " before shutdown was requested" : "", GetTimeMillis() - nStart);
+    return true;
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
 }
 
@@ -103,7 +284,7 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
-    pcursor->Seek(DB_COINS);
+    pcursor->Seek(DB_COIN);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = GetBestBlock();
@@ -111,29 +292,27 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
     CAmount nTotalAmount = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
+        CoinEntry key;
+        if (!pcursor->GetKey(key) || key.key != DB_COIN)
+            break;
+        // Gather the outputs of one transaction at a time, and hash them the
+        // same way as when a transaction was stored as a single record.
         CCoins coins;
-        if (pcursor->GetKey(key) && key.first == DB_COINS) {
-            if (pcursor->GetValue(coins)) {
-                stats.nTransactions++;
-                for (unsigned int i=0; i<coins.vout.size(); i++) {
-                    const CTxOut &out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i+1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
-                }
-                stats.nSerializedSize += 32 + pcursor->GetValueSize();
-                ss << VARINT(0);
-            } else {
-                return error("CCoinsViewDB::GetStats() : unable to read value");
+        uint64_t nSize = 0;
+        if (!ReadCoins(*pcursor, key.txid, coins, &nSize))
+            return error("CCoinsViewDB::GetStats() : unable to read value");
+        stats.nTransactions++;
+        for (unsigned int i=0; i<coins.vout.size(); i++) {
+            const CTxOut &out = coins.vout[i];
+            if (!out.IsNull()) {
+                stats.nTransactionOutputs++;
+                ss << VARINT(i+1);
+                ss << out;
+                nTotalAmount += out.nValue;
             }
-        } else {
-            break;
         }
-        pcursor->Next();
+        stats.nSerializedSize += 32 + nSize;
+        ss << VARINT(0);
     }
     {
         LOCK(cs_main);
@@ -307,10 +486,64 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts()
+namespace {
+
+/** Proof-of-work check of one stored block index entry */
+class CBlockIndexPowCheck
+{
+private:
+    uint256 hash;
+    unsigned int nBits;
+
+public:
+    CBlockIndexPowCheck() : nBits(0) {}
+    CBlockIndexPowCheck(const uint256& hashIn, unsigned int nBitsIn) : hash(hashIn), nBits(nBitsIn) {}
+
+    bool operator()()
+    {
+        return CheckProofOfWork(hash, nBits, Params().GetConsensus());
+    }
+
+    void swap(CBlockIndexPowCheck& check)
+    {
+        std::swap(hash, check.hash);
+        std::swap(nBits, check.nBits);
+    }
+};
+
+/** A check queue with its own worker threads, which are stopped and joined on destruction */
+class CPowCheckPool
+{
+public:
+    CCheckQueue<CBlockIndexPowCheck> queue;
+    boost::thread_group threads;
+
+    CPowCheckPool(int nThreads) : queue(128)
+    {
+        for (int i = 0; i < nThreads; i++)
+            threads.create_thread(boost::bind(&CCheckQueue<CBlockIndexPowCheck>::Thread, &queue));
+    }
+
+    ~CPowCheckPool()
+    {
+        queue.Quit();
+        threads.join_all();
+    }
+};
+
+} // namespace
+
+bool CBlockTreeDB::LoadBlockIndexGuts(int nTrustedHeight)
 {
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
+    // This thread decodes the entries and links them into mapBlockIndex, while
+    // as many threads as are used for script verification check their PoW.
+    CPowCheckPool pool(nScriptCheckThreads > 1 ? nScriptCheckThreads - 1 : 0);
+    CCheckQueueControl<CBlockIndexPowCheck> control(&pool.queue);
+    std::vector<CBlockIndexPowCheck> vChecks;
+    vChecks.reserve(1000);
+
     pcursor->Seek(make_pair(DB_BLOCK_INDEX, uint256()));
 
     // Load mapBlockIndex
@@ -335,8 +568,13 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
 
-                if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, Params().GetConsensus()))
-                    return error("LoadBlockIndex(): CheckProofOfWork failed: %s", pindexNew->ToString());
+                if (pindexNew->nHeight > nTrustedHeight) {
+                    vChecks.push_back(CBlockIndexPowCheck(pindexNew->GetBlockHash(), pindexNew->nBits));
+                    if (vChecks.size() == vChecks.capacity()) {
+                        control.Add(vChecks);
+                        vChecks.clear();
+                    }
+                }
 
                 pcursor->Next();
             } else {
@@ -347,5 +585,16 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
         }
     }
 
+    control.Add(vChecks);
+    if (!control.Wait()) {
+        // Rare enough that finding the offending entry again is fine.
+        BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex) {
+            const CBlockIndex* pindex = item.second;
+            if (pindex->nHeight > nTrustedHeight && !CheckProofOfWork(pindex->GetBlockHash(), pindex->nBits, Params().GetConsensus()))
+                return error("LoadBlockIndex(): CheckProofOfWork failed: %s", pindex->ToString());
+        }
+        return error("LoadBlockIndex(): CheckProofOfWork failed");
+    }
+
     return true;
 }
@@ -34,8 +34,15 @@ static const int64_t nDefaultDbCache = 100;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! Transactions converted per batch when upgrading the coin database
+static const size_t COINS_UPGRADE_BATCH_SIZE = 10000;
 
-/** CCoinsView backed by the coin database (chainstate/) */
+/**
+ * CCoinsView backed by the coin database (chainstate/).
+ *
+ * Every unspent output is stored as its own record, keyed by outpoint, so
+ * spending one output of a transaction only rewrites that output.
+ */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
@@ -48,6 +55,9 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     bool GetStats(CCoinsStats &stats) const;
+
+    //! Convert a database with one record per transaction to per-output records
+    bool Upgrade();
 };
 
 /** Access to the block database (blocks/index/) */
@@ -80,7 +90,13 @@ public:
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts();
+    /**
+     * Load all block index entries into mapBlockIndex. Their proof of work is
+     * checked while the entries are being read, by a temporary pool of as many
+     * threads as -par asks for, which is gone once loading is done; entries at
+     * or below nTrustedHeight are not checked.
+     */
+    bool LoadBlockIndexGuts(int nTrustedHeight = -1);
 };
 
 #endif // BITCOIN_TXDB_H
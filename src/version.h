@@ -11,7 +11,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 70701;
+static const int PROTOCOL_VERSION = 70702;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -42,4 +42,7 @@ static const int NO_BLOOM_VERSION = 70201;
 //! "sendheaders" command and announcing blocks with headers starts with this version
 static const int SENDHEADERS_VERSION = 70201;
 
+//! masternode messages signed over binary digests (see SPORK_6_NEW_SIGS) are accepted starting with this version
+static const int MESSAGE_DIGEST_VERSION = 70702;
+
 #endif // BITCOIN_VERSION_H